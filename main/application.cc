@@ -237,15 +237,7 @@ void Application::ShowActivationCode(const std::string& code, const std::string&
     }
     
     // Unlock emotion after QR code is displayed (15 seconds should be enough)
-    xTaskCreate([](void* arg) {
-        vTaskDelay(pdMS_TO_TICKS(15000));  // Keep winking for 15 seconds
-        Application* app = static_cast<Application*>(arg);
-        app->Schedule([app]() {
-            app->emotion_locked_ = false;
-            ESP_LOGI("Application", "🔓 Emotion UNLOCKED after QR code display");
-        });
-        vTaskDelete(NULL);
-    }, "qr_emotion_unlock", 2048, this, 1, NULL);
+    UnlockEmotionAfter(15000, "QR code display");
 }
 
 void Application::Alert(const char* status, const char* message, const char* emotion, const std::string_view& sound) {
@@ -289,6 +281,7 @@ void Application::ToggleChatState() {
 
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
+            WaitForPrewarm();
             if (!protocol_->IsAudioChannelOpened()) {
                 SetDeviceState(kDeviceStateConnecting);
                 if (!protocol_->OpenAudioChannel()) {
@@ -326,6 +319,7 @@ void Application::StartListening() {
     
     if (device_state_ == kDeviceStateIdle) {
         Schedule([this]() {
+            WaitForPrewarm();
             if (!protocol_->IsAudioChannelOpened()) {
                 SetDeviceState(kDeviceStateConnecting);
                 if (!protocol_->OpenAudioChannel()) {
@@ -382,17 +376,27 @@ void Application::Start() {
     auto codec = board.GetAudioCodec();
     audio_service_.Initialize(codec);
     audio_service_.Start();
+    // Cues that interrupt interaction (wake, errors, popups) should start without parsing or decoding
+    audio_service_.PreloadSounds({Lang::Sounds::OGG_POPUP, Lang::Sounds::OGG_SUCCESS,
+        Lang::Sounds::OGG_EXCLAMATION, Lang::Sounds::OGG_VIBRATION, Lang::Sounds::OGG_LOW_BATTERY});
 
     AudioServiceCallbacks callbacks;
     callbacks.on_send_queue_available = [this]() {
         xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
     };
     callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+        // Stamped here, the main loop may be busy for a while before it handles the event
+        wake_time_us_ = esp_timer_get_time();
         xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
     };
     callbacks.on_vad_change = [this](bool speaking) {
         xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
     };
+#if CONFIG_AUDIO_CHANNEL_IDLE_TTL > 0
+    callbacks.on_wake_word_speech = [this]() {
+        xEventGroupSetBits(event_group_, MAIN_EVENT_SPEECH_START);
+    };
+#endif
     audio_service_.SetCallbacks(callbacks);
 
     // Start the main event loop task with priority 3
@@ -412,6 +416,8 @@ void Application::Start() {
 
     // Check for new assets version
     CheckAssetsVersion();
+    // The voice command table may come from the assets partition
+    voice_commands_.Load();
 
     // Check for new firmware version or get the MQTT broker address
     Ota ota;
@@ -439,10 +445,16 @@ void Application::Start() {
     });
 
     protocol_->OnNetworkError([this](const std::string& message) {
+        if (prewarming_) {
+            // Nobody asked for this channel yet, the wake word will retry and report the error
+            ESP_LOGW(TAG, "Failed to open the audio channel early: %s", message.c_str());
+            return;
+        }
         last_error_message_ = message;
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
+        LatencyTrace::GetInstance().Begin(packet->trace);
         if (device_state_ == kDeviceStateSpeaking) {
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
         }
@@ -456,26 +468,25 @@ void Application::Start() {
     });
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
+        protocol_->LogMetrics();
         Schedule([this]() {
             auto display = Board::GetInstance().GetDisplay();
             // Don't clear chat message on audio channel close to preserve conversation history
             // display->SetChatMessage("system", "");
             SetDeviceState(kDeviceStateIdle);
-        });
+        }, kSchedulePriorityHigh);
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
+    // The frequent tts / stt / llm messages, whether they came through the fast parser or cJSON
+    auto handle_server_message = [this, display](const ServerMessage& server_message) {
+        if (server_message.type == "tts") {
+            if (server_message.state == "start") {
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
                         SetDeviceState(kDeviceStateSpeaking);
                     }
-                });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
+                }, kSchedulePriorityHigh);
+            } else if (server_message.state == "stop") {
                 Schedule([this]() {
                     if (device_state_ == kDeviceStateSpeaking) {
                         // Clear chat message when TTS stops
@@ -488,13 +499,12 @@ void Application::Start() {
                             SetDeviceState(kDeviceStateListening);
                         }
                     }
-                });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
+                }, kSchedulePriorityHigh);
+            } else if (server_message.state == "sentence_start") {
+                if (server_message.text != nullptr) {
+                    ESP_LOGI(TAG, "<< %s", server_message.text);
                     
-                    std::string assistant_msg = text->valuestring;
+                    std::string assistant_msg = server_message.text;
                     
                     // Display message immediately (Gemini check happens at TTS stop)
                     Schedule([this, display, message = assistant_msg]() {
@@ -502,10 +512,9 @@ void Application::Start() {
                     });
                 }
             }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                std::string message = text->valuestring;
+        } else if (server_message.type == "stt") {
+            if (server_message.text != nullptr) {
+                std::string message = server_message.text;
                 
                 // Skip only truly empty messages
                 if (message.empty()) {
@@ -528,71 +537,32 @@ void Application::Start() {
                 
                 ESP_LOGI(TAG, ">> %s", message.c_str());
                 
-                // Voice command: special action sequence
-                // Phrase example (Vietnamese): "súng nè", "bắn", "bang bang", "bùm"
-                // Behavior: walk back 1 step (speed 15), sit down, then lie down slowly; show shocked emoji
-                // Also accept unaccented form: "sung ne", "ban", "bang bang", "bum"
-                std::string phrase = message;
-                auto to_lower = [](std::string s) {
-                    for (auto &ch : s) ch = (char)tolower((unsigned char)ch);
-                    return s;
-                };
-                auto contains = [](const std::string &hay, const char* needle) {
-                    return hay.find(needle) != std::string::npos;
-                };
-                std::string lower = to_lower(phrase);
+                // Voice commands, see VoiceCommands for the phrase table
+                // Shoot: walk back 1 step (speed 15), sit down, then lie down slowly; show shocked emoji
+                uint32_t commands = voice_commands_.Match(message);
+                ESP_LOGI(TAG, "🎤 STT voice command check: '%s' -> 0x%05lx", message.c_str(), commands);
                 
-                ESP_LOGI(TAG, "🎤 STT voice command check: original='%s' lower='%s'", phrase.c_str(), lower.c_str());
-
-                bool shoot_seq =
-                    // Shooting keywords (accented and unaccented)
-                    contains(lower, "súng nè") ||
-                    contains(lower, "sung ne") ||
-                    contains(lower, "bắn") ||
-                    contains(lower, "ban") ||
-                    contains(lower, "bang bang") ||
-                    contains(lower, "bùm") ||
-                    contains(lower, "bum");
-                    
+                bool shoot_seq = VoiceCommands::Has(commands, kVoiceCommandShoot);
                 ESP_LOGI(TAG, "🎯 Shoot sequence match: %s", shoot_seq ? "YES ✅" : "NO ❌");
                 
                 // Check for instant action keywords
-                bool walk_forward = contains(lower, "đi tới") || contains(lower, "di toi") || 
-                                   contains(lower, "tiến lên") || contains(lower, "tien len");
-                bool walk_back = contains(lower, "lùi lại") || contains(lower, "lui lai") || 
-                                contains(lower, "đi lùi") || contains(lower, "di lui");
-                bool turn_left = contains(lower, "quẹo trái") || contains(lower, "queo trai") || 
-                                contains(lower, "rẽ trái") || contains(lower, "re trai");
-                bool turn_right = contains(lower, "quẹo phải") || contains(lower, "queo phai") || 
-                                 contains(lower, "rẽ phải") || contains(lower, "re phai");
-                bool sit_down = contains(lower, "ngồi xuống") || contains(lower, "ngoi xuong") || 
-                               contains(lower, "ngồi") || contains(lower, "ngoi");
-                bool dance = contains(lower, "nhảy") || contains(lower, "nhay") || 
-                            contains(lower, "múa") || contains(lower, "mua");
-                bool bow = contains(lower, "cúi chào") || contains(lower, "cui chao") || 
-                          contains(lower, "chào") || contains(lower, "chao");
-                bool show_ip = contains(lower, "192168") || contains(lower, "một chín hai") || 
-                              contains(lower, "mot chin hai") || contains(lower, "ip address");
-                bool open_panel = contains(lower, "mở bảng điều khiển") || contains(lower, "mo bang dieu khien") ||
-                                 contains(lower, "bảng điều khiển") || contains(lower, "bang dieu khien") ||
-                                 contains(lower, "mở trang điều khiển") || contains(lower, "mo trang dieu khien") ||
-                                 contains(lower, "mở web") || contains(lower, "mo web");
-                bool show_qr = contains(lower, "mở qr") || contains(lower, "mo qr") || 
-                              contains(lower, "mở mã qr") || contains(lower, "mo ma qr") ||
-                              contains(lower, "hiển thị qr") || contains(lower, "hien thi qr") ||
-                              contains(lower, "mở mạng qr") || contains(lower, "mo mang qr");
+                bool walk_forward = VoiceCommands::Has(commands, kVoiceCommandWalkForward);
+                bool walk_back = VoiceCommands::Has(commands, kVoiceCommandWalkBack);
+                bool turn_left = VoiceCommands::Has(commands, kVoiceCommandTurnLeft);
+                bool turn_right = VoiceCommands::Has(commands, kVoiceCommandTurnRight);
+                bool sit_down = VoiceCommands::Has(commands, kVoiceCommandSitDown);
+                bool dance = VoiceCommands::Has(commands, kVoiceCommandDance);
+                bool bow = VoiceCommands::Has(commands, kVoiceCommandBow);
+                bool show_ip = VoiceCommands::Has(commands, kVoiceCommandShowIp);
+                bool open_panel = VoiceCommands::Has(commands, kVoiceCommandOpenPanel);
+                bool show_qr = VoiceCommands::Has(commands, kVoiceCommandShowQr);
 
                 // New voice pose triggers
-                bool toilet_pose = contains(lower, "đi vệ sinh") || contains(lower, "di ve sinh") ||
-                                   contains(lower, "đi toilet") || contains(lower, "di toilet");
-                bool pushup_pose = contains(lower, "chống đẩy") || contains(lower, "chong day") ||
-                                   contains(lower, "tập thể dục") || contains(lower, "tap the duc") ||
-                                   contains(lower, "hít đất") || contains(lower, "hit dat");
+                bool toilet_pose = VoiceCommands::Has(commands, kVoiceCommandToilet);
+                bool pushup_pose = VoiceCommands::Has(commands, kVoiceCommandPushup);
                 
                 // Birthday celebration keywords
-                bool birthday_voice = contains(lower, "chúc mừng sinh nhật") || contains(lower, "chuc mung sinh nhat") ||
-                                     contains(lower, "happy birthday") || contains(lower, "sinh nhật vui vẻ") ||
-                                     contains(lower, "sinh nhat vui ve");
+                bool birthday_voice = VoiceCommands::Has(commands, kVoiceCommandBirthday);
                 
                 if (shoot_seq) {
                     ESP_LOGI(TAG, "🔫 EXECUTING shoot/defend sequence NOW! (No text display, only emoji)");
@@ -618,15 +588,7 @@ void Application::Start() {
                         
                         // Unlock emotion after sequence completes (total ~8s)
                         // Schedule unlock after action queue finishes
-                        xTaskCreate([](void* arg) {
-                            vTaskDelay(pdMS_TO_TICKS(9000)); // Wait for sequence to complete
-                            Application* app = static_cast<Application*>(arg);
-                            app->Schedule([app]() {
-                                app->emotion_locked_ = false;
-                                ESP_LOGI("Application", "🔓 Emotion UNLOCKED after keyword sequence");
-                            });
-                            vTaskDelete(NULL);
-                        }, "emotion_unlock", 2048, this, 1, NULL);
+                        UnlockEmotionAfter(9000, "keyword sequence");
                     });
                     ESP_LOGI(TAG, "✅ Shoot/defend sequence scheduled, returning now (no chat message)");
                     return; // handled - skip SetChatMessage
@@ -643,15 +605,7 @@ void Application::Start() {
                             disp->SetEmotion("winking");
                         }
                         // Unlock after 15 seconds
-                        xTaskCreate([](void* arg) {
-                            vTaskDelay(pdMS_TO_TICKS(15000)); // Changed from 30s to 15s
-                            Application* app = static_cast<Application*>(arg);
-                            app->Schedule([app]() {
-                                app->emotion_locked_ = false;
-                                ESP_LOGI("Application", "🔓 Emotion UNLOCKED after QR winking display (15s)");
-                            });
-                            vTaskDelete(NULL);
-                        }, "qr_wink_unlock", 2048, this, 1, NULL);
+                        UnlockEmotionAfter(15000, "QR winking display (15s)");
                     });
                     return; // handled
                 }
@@ -691,15 +645,7 @@ void Application::Start() {
                         ESP_LOGI(TAG, "🎂 Displaying Silly emoji for birthday celebration (voice trigger)");
                         
                         // Unlock emotion after 15 seconds
-                        xTaskCreate([](void* arg) {
-                            vTaskDelay(pdMS_TO_TICKS(15000)); // 15 seconds display duration
-                            Application* app = static_cast<Application*>(arg);
-                            app->Schedule([app]() {
-                                app->emotion_locked_ = false;
-                                ESP_LOGI("Application", "🔓 Emotion UNLOCKED after birthday celebration (voice)");
-                            });
-                            vTaskDelete(NULL);
-                        }, "birthday_voice_unlock", 2048, this, 1, NULL);
+                        UnlockEmotionAfter(15000, "birthday celebration (voice)");
                     });
                     // Don't return here - let LLM process and respond naturally
                 }
@@ -785,16 +731,14 @@ void Application::Start() {
                                      IP2STR(&ip_info.ip));
                             disp->SetChatMessage("system", ip_str);
                             // Keep display for 30 seconds
-                            xTaskCreate([](void* arg) {
-                                vTaskDelay(pdMS_TO_TICKS(30000));
+                            ScheduleAfter(30000, []() {
                                 auto d = Board::GetInstance().GetDisplay();
                                 if (d) {
                                     d->SetEmotion("neutral");
                                     d->SetChatMessage("", "");
                                 }
                                 ESP_LOGI("Application", "🔓 IP display cleared after 30s");
-                                vTaskDelete(NULL);
-                            }, "ip_clear", 2048, nullptr, 1, NULL);
+                            });
                         } else {
                             ESP_LOGE("Application", "❌ Failed to get IP info");
                             disp->SetChatMessage("system", "WiFi chưa kết nối!");
@@ -831,16 +775,14 @@ void Application::Start() {
                                 disp->SetChatMessage("system", ip_str);
                                 
                                 // Keep display for 15 seconds
-                                xTaskCreate([](void* arg) {
-                                    vTaskDelay(pdMS_TO_TICKS(15000));
+                                ScheduleAfter(15000, []() {
                                     auto d = Board::GetInstance().GetDisplay();
                                     if (d) {
                                         d->SetEmotion("neutral");
                                         d->SetChatMessage("", "");
                                     }
                                     ESP_LOGI("Application", "🔓 IP display cleared after 15s");
-                                    vTaskDelete(NULL);
-                                }, "panel_ip_clear", 2048, nullptr, 1, NULL);
+                                });
                             } else {
                                 ESP_LOGE("Application", "❌ Failed to get IP info");
                                 disp->SetChatMessage("system", "✅ Web server đã khởi động!");
@@ -851,7 +793,7 @@ void Application::Start() {
                 }
                 
                 // Show user's recognized speech (only if NOT a keyword trigger)
-                Schedule([this, display, message = std::string(text->valuestring)]() {
+                Schedule([this, display, message]() {
                     display->SetChatMessage("user", message.c_str());
                 });
 
@@ -859,19 +801,8 @@ void Application::Start() {
                 // Keywords (Vietnamese):
                 //   - "emoji chính"  => switch to Otto GIF mode (primary/animated)
                 //   - "emoji mặc định" => switch to default text mode
-                // Also accept unaccented forms: "emoji chinh", "emoji mac dinh"
-                // Note: helpers defined above
-
-                bool ask_otto = false;
-                bool ask_default = false;
-
-                // Exact keywords only
-                if (contains(lower, "emoji chính") || contains(lower, "emoji chinh")) {
-                    ask_otto = true;
-                }
-                if (contains(lower, "emoji mặc định") || contains(lower, "emoji mac dinh")) {
-                    ask_default = true;
-                }
+                bool ask_otto = VoiceCommands::Has(commands, kVoiceCommandEmojiOtto);
+                bool ask_default = VoiceCommands::Has(commands, kVoiceCommandEmojiDefault);
 
                 if (ask_otto || ask_default) {
                     Schedule([this, ask_otto, ask_default]() {
@@ -903,10 +834,9 @@ void Application::Start() {
                     });
                 }
             }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
+        } else if (server_message.type == "llm") {
+            if (!server_message.emotion.empty()) {
+                Schedule([this, display, emotion_str = std::string(server_message.emotion)]() {
                     // Skip emotion change if locked (keyword sequence in progress)
                     if (emotion_locked_) {
                         ESP_LOGW(TAG, "⛔ Ignoring LLM emotion '%s' (emotion locked for keyword)", emotion_str.c_str());
@@ -915,6 +845,30 @@ void Application::Start() {
                     display->SetEmotion(emotion_str.c_str());
                 });
             }
+        }
+    };
+    protocol_->OnIncomingMessage(handle_server_message);
+    protocol_->OnIncomingJson([this, display, handle_server_message](const cJSON* root) {
+        // Parse JSON data
+        auto type = cJSON_GetObjectItem(root, "type");
+        if (strcmp(type->valuestring, "tts") == 0 || strcmp(type->valuestring, "stt") == 0 ||
+            strcmp(type->valuestring, "llm") == 0) {
+            // Only reached when the fast parser rejected the frame, e.g. an escaped field
+            ServerMessage server_message;
+            server_message.type = type->valuestring;
+            auto state = cJSON_GetObjectItem(root, "state");
+            if (cJSON_IsString(state)) {
+                server_message.state = state->valuestring;
+            }
+            auto emotion = cJSON_GetObjectItem(root, "emotion");
+            if (cJSON_IsString(emotion)) {
+                server_message.emotion = emotion->valuestring;
+            }
+            auto text = cJSON_GetObjectItem(root, "text");
+            if (cJSON_IsString(text)) {
+                server_message.text = text->valuestring;
+            }
+            handle_server_message(server_message);
         } else if (strcmp(type->valuestring, "mcp") == 0) {
             auto payload = cJSON_GetObjectItem(root, "payload");
             if (cJSON_IsObject(payload)) {
@@ -974,14 +928,6 @@ void Application::Start() {
 }
 
 // Add a async task to MainLoop
-void Application::Schedule(std::function<void()> callback) {
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        main_tasks_.push_back(std::move(callback));
-    }
-    xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
-}
-
 // The Main Event Loop controls the chat state and websocket connection
 // If other tasks need to access the websocket or chat state,
 // they should use Schedule to call this function
@@ -992,6 +938,7 @@ void Application::MainEventLoop() {
             MAIN_EVENT_WAKE_WORD_DETECTED |
             MAIN_EVENT_VAD_CHANGE |
             MAIN_EVENT_CLOCK_TICK |
+            MAIN_EVENT_SPEECH_START |
             MAIN_EVENT_ERROR, pdTRUE, pdFALSE, portMAX_DELAY);
 
         if (bits & MAIN_EVENT_ERROR) {
@@ -1001,12 +948,25 @@ void Application::MainEventLoop() {
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
             while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
-                    break;
+                // The packet is consumed by SendAudio(), keep its stamps to finish the trace
+                LatencyStamps stamps = packet->trace;
+                if (protocol_) {
+                    bool sent = protocol_->SendAudio(std::move(packet));
+                    audio_service_.OnPacketSent(sent);
+                    if (!sent) {
+                        break;
+                    }
                 }
+                auto& trace = LatencyTrace::GetInstance();
+                trace.Stamp(kLatencyStageSend, stamps);
+                trace.Finish(kLatencyStageUplink, stamps);
             }
         }
 
+        if (bits & MAIN_EVENT_SPEECH_START) {
+            PrewarmAudioChannel();
+        }
+
         if (bits & MAIN_EVENT_WAKE_WORD_DETECTED) {
             OnWakeWordDetected();
         }
@@ -1019,12 +979,7 @@ void Application::MainEventLoop() {
         }
 
         if (bits & MAIN_EVENT_SCHEDULE) {
-            std::unique_lock<std::mutex> lock(mutex_);
-            auto tasks = std::move(main_tasks_);
-            lock.unlock();
-            for (auto& task : tasks) {
-                task();
-            }
+            main_tasks_.RunPending();
         }
 
         if (bits & MAIN_EVENT_CLOCK_TICK) {
@@ -1032,22 +987,79 @@ void Application::MainEventLoop() {
             auto display = Board::GetInstance().GetDisplay();
             display->UpdateStatusBar();
         
+#if CONFIG_AUDIO_CHANNEL_IDLE_TTL > 0
+            // A channel kept open for the next wake word is released after the TTL. The channel reports
+            // open as soon as it connects, an early open still waiting for the hello must not be torn down.
+            if (device_state_ == kDeviceStateIdle && clock_ticks_ >= CONFIG_AUDIO_CHANNEL_IDLE_TTL &&
+                !prewarming_ && protocol_ && protocol_->IsAudioChannelOpened()) {
+                ESP_LOGI(TAG, "Closing the audio channel after %d idle seconds", clock_ticks_);
+                protocol_->CloseAudioChannel();
+            }
+#endif
+        
             // Print the debug info every 10 seconds
             if (clock_ticks_ % 10 == 0) {
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
                 // SystemInfo::PrintTaskList();
                 SystemInfo::PrintHeapStats();
+                main_tasks_.PrintStatistics();
+                timer_service_.PrintStatistics();
+                audio_service_.PrintDebugStatistics();
             }
         }
     }
 }
 
+// Opens the audio channel when the wake word engine hears speech, so the connection and the hello
+// exchange overlap with the wake word itself. Channels that end up unused are closed by the idle TTL.
+// The open runs on its own task to keep the main loop responsive, anything else that opens the
+// channel waits for it with WaitForPrewarm().
+void Application::PrewarmAudioChannel() {
+#if CONFIG_AUDIO_CHANNEL_IDLE_TTL > 0
+    if (!protocol_ || device_state_ != kDeviceStateIdle || prewarming_ || protocol_->IsAudioChannelOpened()) {
+        return;
+    }
+    // Speech without a wake word (TV, conversation in the room) must not reconnect continuously
+    int64_t now = esp_timer_get_time();
+    if (last_prewarm_time_us_ != 0 && now - last_prewarm_time_us_ < CONFIG_AUDIO_CHANNEL_IDLE_TTL * 1000000LL) {
+        return;
+    }
+    last_prewarm_time_us_ = now;
+
+    ESP_LOGI(TAG, "Speech detected, opening the audio channel");
+    xEventGroupClearBits(event_group_, MAIN_EVENT_PREWARM_DONE);
+    prewarming_ = true;
+    // The TTL counts from here, not from entering the idle state
+    clock_ticks_ = 0;
+    xTaskCreate([](void* arg) {
+        auto app = (Application*)arg;
+        app->protocol_->OpenAudioChannel();
+        xEventGroupSetBits(app->event_group_, MAIN_EVENT_PREWARM_DONE);
+        app->prewarming_ = false;
+        vTaskDelete(NULL);
+    }, "prewarm_channel", 2048 * 4, this, 2, nullptr);
+#endif
+}
+
+void Application::WaitForPrewarm() {
+    if (prewarming_) {
+        xEventGroupWaitBits(event_group_, MAIN_EVENT_PREWARM_DONE, pdFALSE, pdTRUE, portMAX_DELAY);
+    }
+}
+
 void Application::OnWakeWordDetected() {
+    if (!protocol_ || device_state_ != kDeviceStateIdle) {
+        // Only wake-ups from idle are timed
+        wake_time_us_ = 0;
+    }
     if (!protocol_) {
         return;
     }
 
     if (device_state_ == kDeviceStateIdle) {
+        // A channel still being opened early counts, the handshake overlapped with the wake word
+        wake_channel_ready_ = prewarming_ || protocol_->IsAudioChannelOpened();
+        WaitForPrewarm();
         // Wake up display immediately when wake word is detected
         auto display = Board::GetInstance().GetDisplay();
         if (display) {
@@ -1064,6 +1076,7 @@ void Application::OnWakeWordDetected() {
         if (!protocol_->IsAudioChannelOpened()) {
             SetDeviceState(kDeviceStateConnecting);
             if (!protocol_->OpenAudioChannel()) {
+                wake_time_us_ = 0;
                 audio_service_.EnableWakeWordDetection(true);
                 return;
             }
@@ -1141,6 +1154,12 @@ void Application::SetDeviceState(DeviceState state) {
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
 
+            if (int64_t wake_time_us = wake_time_us_.exchange(0); wake_time_us != 0) {
+                wake_to_listen_ms_ = (esp_timer_get_time() - wake_time_us) / 1000;
+                ESP_LOGI(TAG, "Wake to listening: %d ms, audio channel %s", wake_to_listen_ms_,
+                    wake_channel_ready_ ? "opened early" : "opened after the wake word");
+            }
+
             // Make sure the audio processor is running
             if (!audio_service_.IsAudioProcessorRunning()) {
                 // Send the start listening command
@@ -1284,6 +1303,20 @@ void Application::SendMcpMessage(const std::string& payload) {
     }
 }
 
+void Application::SendMcpMessage(size_t payload_size, Protocol::TextProducer payload) {
+    if (protocol_ == nullptr) {
+        return;
+    }
+
+    if (xTaskGetCurrentTaskHandle() == main_event_loop_task_handle_) {
+        protocol_->SendMcpMessage(payload_size, payload);
+    } else {
+        Schedule([this, payload_size, payload = std::move(payload)]() {
+            protocol_->SendMcpMessage(payload_size, payload);
+        });
+    }
+}
+
 void Application::SetAecMode(AecMode mode) {
     aec_mode_ = mode;
     Schedule([this]() {
@@ -1340,26 +1373,14 @@ void Application::SendSttMessage(const std::string& text) {
     ESP_LOGI(TAG, "SendSttMessage: %s", validated_text.c_str());
 
     // Check for special keywords that should be handled locally (not sent to server)
-    auto to_lower = [](std::string s) {
-        for (auto &ch : s) ch = (char)tolower((unsigned char)ch);
-        return s;
-    };
-    auto contains = [](const std::string &hay, const char* needle) {
-        return hay.find(needle) != std::string::npos;
-    };
-    std::string lower = to_lower(validated_text);
+    uint32_t commands = voice_commands_.Match(validated_text);
     
     // Check for QR code display keywords
-    bool show_qr = contains(lower, "mở qr") || contains(lower, "mo qr") || 
-                  contains(lower, "mở mã qr") || contains(lower, "mo ma qr") ||
-                  contains(lower, "hiển thị qr") || contains(lower, "hien thi qr") ||
-                  contains(lower, "mở mạng qr") || contains(lower, "mo mang qr");
+    bool show_qr = VoiceCommands::Has(commands, kVoiceCommandShowQr);
     
     // Check for birthday celebration keywords
-    bool birthday_celebration = contains(lower, "chúc mừng sinh nhật") || contains(lower, "chuc mung sinh nhat") ||
-                               contains(lower, "happy birthday") || contains(lower, "sinh nhật") ||
-                               contains(lower, "sinh nhat") || contains(lower, "chúc mừng") ||
-                               contains(lower, "chuc mung");
+    bool birthday_celebration = VoiceCommands::Has(commands, kVoiceCommandBirthday) ||
+                               VoiceCommands::Has(commands, kVoiceCommandCongratulate);
     
     if (show_qr) {
         ESP_LOGI(TAG, "🔒 QR CODE keyword detected - handling locally (no server send)");
@@ -1392,15 +1413,7 @@ void Application::SendSttMessage(const std::string& text) {
                 ESP_LOGI(TAG, "📱 Displaying IP QR with winking: " IPSTR, IP2STR(&ip_info.ip));
                 
                 // Unlock emotion after 15 seconds
-                xTaskCreate([](void* arg) {
-                    vTaskDelay(pdMS_TO_TICKS(15000));
-                    Application* app = static_cast<Application*>(arg);
-                    app->Schedule([app]() {
-                        app->emotion_locked_ = false;
-                        ESP_LOGI("Application", "🔓 Emotion UNLOCKED after IP QR display");
-                    });
-                    vTaskDelete(NULL);
-                }, "qr_unlock", 2048, this, 1, NULL);
+                UnlockEmotionAfter(15000, "IP QR display");
             }
         });
         return; // Skip sending to server
@@ -1425,15 +1438,7 @@ void Application::SendSttMessage(const std::string& text) {
             ESP_LOGI(TAG, "🎂 Displaying Silly emoji for birthday celebration");
             
             // Unlock emotion after 15 seconds
-            xTaskCreate([](void* arg) {
-                vTaskDelay(pdMS_TO_TICKS(15000)); // 15 seconds display duration
-                Application* app = static_cast<Application*>(arg);
-                app->Schedule([app]() {
-                    app->emotion_locked_ = false;
-                    ESP_LOGI("Application", "🔓 Emotion UNLOCKED after birthday celebration");
-                });
-                vTaskDelete(NULL);
-            }, "birthday_unlock", 2048, this, 1, NULL);
+            UnlockEmotionAfter(15000, "birthday celebration");
         });
         return; // Skip sending to server
     }
@@ -1445,6 +1450,7 @@ void Application::SendSttMessage(const std::string& text) {
     }
 
     // Open audio channel if not already open
+    WaitForPrewarm();
     if (!protocol_->IsAudioChannelOpened()) {
         SetDeviceState(kDeviceStateConnecting);
         if (!protocol_->OpenAudioChannel()) {
@@ -1588,8 +1594,7 @@ void Application::SendSttMessage(const std::string& text) {
     ESP_LOGI(TAG, "Sent stop listening signal");
     
     // Schedule timeout handler: if server doesn't respond in 8s, restore previous state
-    Schedule([this, previous_state, was_voice_processing, was_wake_word_detection]() {
-        vTaskDelay(pdMS_TO_TICKS(8000));  // Wait 8 seconds for server response
+    ScheduleAfter(8000, [this, previous_state, was_voice_processing, was_wake_word_detection]() {
         if (device_state_ == kDeviceStateListening) {
             // No response from server, reset to previous state
             ESP_LOGI(TAG, "⚠️ No server response after 8s, resetting to %s state", 
@@ -1634,40 +1639,21 @@ void Application::OpenControlPanel() {
     disp->SetEmotion("happy");
     disp->SetChatMessage("system", ip_str);
     
+    // A panel closed just before must not drop the device back to idle
+    CancelScheduled(control_panel_idle_timer_);
+    control_panel_idle_timer_ = 0;
+
     // Cancel existing timer if any
-    if (control_panel_timer_handle_ != nullptr) {
-        esp_timer_stop(control_panel_timer_handle_);
-        esp_timer_delete(control_panel_timer_handle_);
-        control_panel_timer_handle_ = nullptr;
+    if (CancelScheduled(control_panel_timer_)) {
         ESP_LOGI(TAG, "🔄 Cancelled previous control panel timer");
     }
     
-    // Create 5-minute auto-close timer
-    esp_timer_create_args_t timer_args = {
-        .callback = [](void* arg) {
-            auto app = static_cast<Application*>(arg);
-            app->Schedule([app]() {
-                app->CloseControlPanel();
-            });
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "control_panel_timer",
-        .skip_unhandled_events = false
-    };
-    
-    esp_err_t err = esp_timer_create(&timer_args, &control_panel_timer_handle_);
-    if (err == ESP_OK) {
-        // Start timer for 5 minutes (300,000,000 microseconds)
-        err = esp_timer_start_once(control_panel_timer_handle_, 300000000ULL);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "⏰ Control panel will auto-close in 5 minutes");
-        } else {
-            ESP_LOGE(TAG, "❌ Failed to start control panel timer");
-        }
-    } else {
-        ESP_LOGE(TAG, "❌ Failed to create control panel timer");
-    }
+    // 5-minute auto-close timer
+    control_panel_timer_ = ScheduleAfter(5 * 60 * 1000, [this]() {
+        control_panel_timer_ = 0;
+        CloseControlPanel();
+    });
+    ESP_LOGI(TAG, "⏰ Control panel will auto-close in 5 minutes");
 }
 
 void Application::CloseControlPanel() {
@@ -1684,13 +1670,24 @@ void Application::CloseControlPanel() {
     disp->SetChatMessage("system", "Bảng điều khiển đã đóng");
     
     // Clean up timer
-    if (control_panel_timer_handle_ != nullptr) {
-        esp_timer_stop(control_panel_timer_handle_);
-        esp_timer_delete(control_panel_timer_handle_);
-        control_panel_timer_handle_ = nullptr;
-    }
+    CancelScheduled(control_panel_timer_);
+    control_panel_timer_ = 0;
     
-    // Return to idle state
-    vTaskDelay(pdMS_TO_TICKS(2000));  // Show message for 2 seconds
-    SetDeviceState(kDeviceStateIdle);
+    // Return to idle state after showing the message for 2 seconds
+    CancelScheduled(control_panel_idle_timer_);
+    control_panel_idle_timer_ = ScheduleAfter(2000, [this]() {
+        control_panel_idle_timer_ = 0;
+        SetDeviceState(kDeviceStateIdle);
+    });
+}
+
+// Keeps the emotion locked for |ms|. A newer keyword sequence replaces the unlock of an older one,
+// so the older timer cannot end the newer lock early.
+void Application::UnlockEmotionAfter(uint32_t ms, const char* reason) {
+    CancelScheduled(emotion_unlock_timer_);
+    emotion_unlock_timer_ = ScheduleAfter(ms, [this, reason]() {
+        emotion_unlock_timer_ = 0;
+        emotion_locked_ = false;
+        ESP_LOGI(TAG, "🔓 Emotion UNLOCKED after %s", reason);
+    });
 }
@@ -7,6 +7,7 @@
 #include <esp_timer.h>
 
 #include <string>
+#include <atomic>
 #include <mutex>
 #include <deque>
 #include <memory>
@@ -15,6 +16,9 @@
 #include "ota.h"
 #include "audio_service.h"
 #include "device_state_event.h"
+#include "schedule_queue.h"
+#include "timer_service.h"
+#include "voice_commands.h"
 
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
@@ -24,6 +28,9 @@
 #define MAIN_EVENT_ERROR (1 << 4)
 #define MAIN_EVENT_CHECK_NEW_VERSION_DONE (1 << 5)
 #define MAIN_EVENT_CLOCK_TICK (1 << 6)
+#define MAIN_EVENT_SPEECH_START (1 << 7)
+// Not waited for by the main loop, set when an early audio channel open has finished
+#define MAIN_EVENT_PREWARM_DONE (1 << 8)
 
 
 enum AecMode {
@@ -46,7 +53,19 @@ public:
     void MainEventLoop();
     DeviceState GetDeviceState() const { return device_state_; }
     bool IsVoiceDetected() const { return audio_service_.IsVoiceDetected(); }
-    void Schedule(std::function<void()> callback);
+    // Runs |callback| on the main event loop. High priority tasks run before queued normal ones.
+    template <typename F>
+    void Schedule(F&& callback, SchedulePriority priority = kSchedulePriorityNormal) {
+        main_tasks_.Push(std::forward<F>(callback), priority);
+        xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
+    }
+    // Runs |callback| on the main event loop after |delay_ms|. The handle can be passed to
+    // CancelScheduled() until the callback runs.
+    template <typename F>
+    TimerService::Handle ScheduleAfter(uint32_t delay_ms, F&& callback) {
+        return timer_service_.Add(delay_ms, SmallFunction(std::forward<F>(callback)));
+    }
+    bool CancelScheduled(TimerService::Handle handle) { return timer_service_.Cancel(handle); }
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
@@ -59,11 +78,15 @@ public:
     bool UpgradeFirmware(Ota& ota, const std::string& url = "");
     bool CanEnterSleepMode();
     void SendMcpMessage(const std::string& payload);
+    void SendMcpMessage(size_t payload_size, Protocol::TextProducer payload);
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
     void PlaySound(const std::string_view& sound);
     void SendSttMessage(const std::string& text);
     AudioService& GetAudioService() { return audio_service_; }
+    Protocol* GetProtocol() { return protocol_.get(); }
+    // Wake word to listening state of the last wake up, -1 before the first one
+    int GetWakeToListenMs() const { return wake_to_listen_ms_; }
     
     // Gemini AI fallback
     void InitializeGemini();
@@ -74,12 +97,15 @@ private:
     Application();
     ~Application();
 
-    std::mutex mutex_;
-    std::deque<std::function<void()>> main_tasks_;
+    ScheduleQueue main_tasks_;
+    TimerService timer_service_{[this](SmallFunction&& callback) { Schedule(std::move(callback)); }};
+    VoiceCommands voice_commands_;
     std::unique_ptr<Protocol> protocol_;
     EventGroupHandle_t event_group_ = nullptr;
     esp_timer_handle_t clock_timer_handle_ = nullptr;
-    esp_timer_handle_t control_panel_timer_handle_ = nullptr;  // Auto-close control panel after 5 minutes
+    TimerService::Handle control_panel_timer_ = 0;  // Auto-close control panel after 5 minutes
+    TimerService::Handle control_panel_idle_timer_ = 0;  // Back to idle after the close message
+    TimerService::Handle emotion_unlock_timer_ = 0;
     volatile DeviceState device_state_ = kDeviceStateUnknown;
     ListeningMode listening_mode_ = kListeningModeAutoStop;
     AecMode aec_mode_ = kAecOff;
@@ -91,16 +117,24 @@ private:
     bool emotion_locked_ = false;  // Lock emotion during keyword trigger sequences
     std::string last_web_wake_word_;  // Track last wake word sent from web UI to skip echo
     int clock_ticks_ = 0;
+    std::atomic<bool> prewarming_ = false;
+    int64_t last_prewarm_time_us_ = 0;
+    std::atomic<int64_t> wake_time_us_ = 0;  // Stamped by the audio task when the wake word fires
+    bool wake_channel_ready_ = false;
+    int wake_to_listen_ms_ = -1;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
 
     void OnWakeWordDetected();
+    void PrewarmAudioChannel();
+    void WaitForPrewarm();
     void CheckNewVersion(Ota& ota);
     void CheckAssetsVersion();
     void ShowActivationCode(const std::string& code, const std::string& message);
     void SetListeningMode(ListeningMode mode);
     void OpenControlPanel();  // Open web control panel with IP display
     void CloseControlPanel(); // Close web control panel
+    void UnlockEmotionAfter(uint32_t ms, const char* reason);
 };
 
 
@@ -0,0 +1,238 @@
+#include "audio_benchmark.h"
+#include "audio_service.h"
+#include "jitter_buffer.h"
+#include "codecs/dummy_audio_codec.h"
+
+#include <cmath>
+#include <esp_log.h>
+#include <esp_cpu.h>
+#include <esp_heap_caps.h>
+#include <freertos/semphr.h>
+
+#define TAG "AudioBenchmark"
+
+AudioBenchmark::AudioBenchmark(int input_sample_rate, int output_sample_rate, int burst)
+    : input_sample_rate_(input_sample_rate), output_sample_rate_(output_sample_rate), burst_(burst > 0 ? burst : 1) {
+}
+
+void AudioBenchmark::SetInput(std::vector<int16_t>&& pcm) {
+    input_ = std::move(pcm);
+}
+
+void AudioBenchmark::GenerateInput() {
+    // One second of a voiced, amplitude modulated harmonic series, so opus sees speech-like content
+    input_.resize(input_sample_rate_);
+    const float pi = 3.14159265f;
+    for (int i = 0; i < input_sample_rate_; i++) {
+        float t = (float)i / input_sample_rate_;
+        float pitch = 140.0f + 30.0f * std::sin(2 * pi * 0.7f * t);
+        float envelope = 0.5f + 0.5f * std::sin(2 * pi * 3.0f * t);
+        float sample = 0;
+        for (int harmonic = 1; harmonic <= 8; harmonic++) {
+            sample += std::sin(2 * pi * pitch * harmonic * t) / harmonic;
+        }
+        input_[i] = (int16_t)(sample * envelope * 6000.0f);
+    }
+}
+
+AudioBenchmarkResult AudioBenchmark::Run(int frames) {
+    if (input_.empty()) {
+        GenerateInput();
+    }
+    result_ = AudioBenchmarkResult();
+
+    struct RunArgs {
+        AudioBenchmark* benchmark;
+        int frames;
+        SemaphoreHandle_t done;
+    } args = { this, frames, xSemaphoreCreateBinary() };
+
+    xTaskCreate([](void* arg) {
+        auto args = (RunArgs*)arg;
+        args->benchmark->RunFrames(args->frames);
+        xSemaphoreGive(args->done);
+        vTaskDelete(NULL);
+    }, "audio_benchmark", OPUS_ENCODE_TASK_STACK_SIZE, &args, 2, nullptr);
+
+    xSemaphoreTake(args.done, portMAX_DELAY);
+    vSemaphoreDelete(args.done);
+    return result_;
+}
+
+void AudioBenchmark::RunFrames(int frames) {
+    DummyAudioCodec codec(input_sample_rate_, output_sample_rate_);
+    codec.SetInputSource(input_.data(), input_.size());
+
+    OpusEncoderWrapper encoder(16000, 1, OPUS_FRAME_DURATION_MS);
+    encoder.SetComplexity(0);
+    OpusDecoderWrapper decoder(16000, 1, OPUS_FRAME_DURATION_MS);
+    OpusResampler input_resampler;
+    OpusResampler output_resampler;
+    if (input_sample_rate_ != 16000) {
+        input_resampler.Configure(input_sample_rate_, 16000);
+    }
+    if (output_sample_rate_ != 16000) {
+        output_resampler.Configure(16000, output_sample_rate_);
+    }
+
+    auto send_queue = std::make_unique<SpscRing<std::unique_ptr<AudioStreamPacket>, MAX_SEND_PACKETS_IN_QUEUE>>();
+    auto decode_queue = std::make_unique<SpscRing<std::unique_ptr<AudioStreamPacket>, MAX_DECODE_PACKETS_IN_QUEUE>>();
+    auto jitter_buffer = std::make_unique<JitterBuffer>();
+
+    std::vector<int16_t> data;
+    std::vector<int16_t> pcm;
+    std::vector<int16_t> output;
+    const int frame_samples = 16000 * OPUS_FRAME_DURATION_MS / 1000;
+    const int input_samples = frame_samples * input_sample_rate_ / 16000;
+    // The downlink runs on a simulated clock that advances one frame per played frame
+    int64_t media_ms = 0;
+    uint32_t sequence = 0;
+    // Packets are recycled here instead of taken from the packet pool, which the live audio service uses
+    std::vector<std::unique_ptr<AudioStreamPacket>> spare_packets;
+    int produced = 0;
+    int played = 0;
+    bool warmed_up = false;
+    size_t capacity_total = 0;
+
+    auto decode_one = [&](std::unique_ptr<AudioStreamPacket> packet, bool conceal) {
+        uint32_t start_cycles = esp_cpu_get_cycle_count();
+        int64_t start_time = esp_timer_get_time();
+        std::vector<uint8_t> empty;
+        bool decoded = conceal ? decoder.Decode(std::move(empty), pcm) : decoder.Decode(std::move(packet->payload), pcm);
+        if (decoded) {
+            if (output_sample_rate_ != 16000) {
+                output.resize(output_resampler.GetOutputSamples(pcm.size()));
+                output_resampler.Process(pcm.data(), pcm.size(), output.data());
+                codec.OutputData(output);
+            } else {
+                codec.OutputData(pcm);
+            }
+        }
+        result_.decode_cycles += esp_cpu_get_cycle_count() - start_cycles;
+        result_.decode_us += esp_timer_get_time() - start_time;
+        if (packet) {
+            spare_packets.push_back(std::move(packet));
+        }
+        media_ms += OPUS_FRAME_DURATION_MS;
+        played++;
+    };
+
+    auto drain_downlink = [&](bool flush) {
+        while (true) {
+            std::unique_ptr<AudioStreamPacket> packet;
+            while (!jitter_buffer->full() && decode_queue->Pop(packet)) {
+                jitter_buffer->Push(std::move(packet), media_ms);
+            }
+            int64_t now_ms = flush ? media_ms + JITTER_BUFFER_MAX_DELAY_FRAMES * OPUS_FRAME_DURATION_MS : media_ms;
+            auto result = jitter_buffer->Pop(packet, now_ms);
+            if (result == JitterBuffer::kPopNone) {
+                return;
+            }
+            decode_one(std::move(packet), result == JitterBuffer::kPopLost);
+        }
+    };
+
+    int free_heap = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    int64_t start_time = esp_timer_get_time();
+    while (produced < frames) {
+        /* Uplink: capture and encode a burst of frames */
+        for (int i = 0; i < burst_ && produced < frames && !send_queue->full(); i++, produced++) {
+            uint32_t start_cycles = esp_cpu_get_cycle_count();
+            data.resize(input_samples);
+            codec.InputData(data);
+            if (input_sample_rate_ != 16000) {
+                pcm.resize(input_resampler.GetOutputSamples(data.size()));
+                input_resampler.Process(data.data(), data.size(), pcm.data());
+            } else {
+                pcm.assign(data.begin(), data.end());
+            }
+            result_.capture_cycles += esp_cpu_get_cycle_count() - start_cycles;
+
+            start_cycles = esp_cpu_get_cycle_count();
+            int64_t encode_start = esp_timer_get_time();
+            std::unique_ptr<AudioStreamPacket> packet;
+            if (spare_packets.empty()) {
+                packet = std::make_unique<AudioStreamPacket>();
+            } else {
+                packet = std::move(spare_packets.back());
+                spare_packets.pop_back();
+            }
+            packet->sample_rate = 16000;
+            packet->frame_duration = OPUS_FRAME_DURATION_MS;
+            packet->sequence = ++sequence;
+            if (!encoder.Encode(std::move(pcm), packet->payload)) {
+                ESP_LOGE(TAG, "Failed to encode frame %d", produced);
+                continue;
+            }
+            result_.encode_cycles += esp_cpu_get_cycle_count() - start_cycles;
+            result_.encode_us += esp_timer_get_time() - encode_start;
+            send_queue->Push(std::move(packet));
+            if (send_queue->size() > result_.send_queue_peak) {
+                result_.send_queue_peak = send_queue->size();
+            }
+        }
+
+        /* Network loopback */
+        std::unique_ptr<AudioStreamPacket> packet;
+        while (!decode_queue->full() && send_queue->Pop(packet)) {
+            decode_queue->Push(std::move(packet));
+        }
+        if (decode_queue->size() > result_.decode_queue_peak) {
+            result_.decode_queue_peak = decode_queue->size();
+        }
+
+        /* Downlink: play what the jitter buffer releases */
+        drain_downlink(false);
+
+        // Buffers that still grow after the first bursts are allocations per frame
+        size_t capacity = data.capacity() + pcm.capacity() + output.capacity();
+        if (warmed_up && capacity > capacity_total) {
+            result_.buffer_allocations++;
+        }
+        capacity_total = capacity;
+        warmed_up = produced >= burst_ * 2;
+    }
+    drain_downlink(true);
+
+    result_.elapsed_us = esp_timer_get_time() - start_time;
+    result_.frames = played;
+    result_.samples_played = codec.samples_written();
+    send_queue.reset();
+    decode_queue.reset();
+    jitter_buffer.reset();
+    spare_packets.clear();
+    result_.heap_delta = free_heap - (int)heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+}
+
+cJSON* AudioBenchmark::ToJson(const AudioBenchmarkResult& result) {
+    auto root = cJSON_CreateObject();
+    int frames = result.frames > 0 ? result.frames : 1;
+    double seconds = result.elapsed_us / 1000000.0;
+    cJSON_AddNumberToObject(root, "frames", result.frames);
+    cJSON_AddNumberToObject(root, "elapsed_ms", result.elapsed_us / 1000);
+    cJSON_AddNumberToObject(root, "frames_per_second", seconds > 0 ? result.frames / seconds : 0);
+    cJSON_AddNumberToObject(root, "realtime_factor",
+        result.elapsed_us > 0 ? (double)result.frames * OPUS_FRAME_DURATION_MS * 1000 / result.elapsed_us : 0);
+    cJSON_AddNumberToObject(root, "capture_cycles_per_frame", (double)(result.capture_cycles / frames));
+    cJSON_AddNumberToObject(root, "encode_cycles_per_frame", (double)(result.encode_cycles / frames));
+    cJSON_AddNumberToObject(root, "decode_cycles_per_frame", (double)(result.decode_cycles / frames));
+    cJSON_AddNumberToObject(root, "encode_us_per_frame", (double)(result.encode_us / frames));
+    cJSON_AddNumberToObject(root, "decode_us_per_frame", (double)(result.decode_us / frames));
+    cJSON_AddNumberToObject(root, "send_queue_peak", result.send_queue_peak);
+    cJSON_AddNumberToObject(root, "decode_queue_peak", result.decode_queue_peak);
+    cJSON_AddNumberToObject(root, "buffer_allocations", result.buffer_allocations);
+    cJSON_AddNumberToObject(root, "heap_delta", result.heap_delta);
+    cJSON_AddNumberToObject(root, "samples_played", result.samples_played);
+    return root;
+}
+
+void AudioBenchmark::Log(const AudioBenchmarkResult& result) {
+    int frames = result.frames > 0 ? result.frames : 1;
+    ESP_LOGI(TAG, "%d frames in %lu ms (%lu x realtime)", result.frames, (uint32_t)(result.elapsed_us / 1000),
+        result.elapsed_us > 0 ? (uint32_t)((int64_t)result.frames * OPUS_FRAME_DURATION_MS * 1000 / result.elapsed_us) : 0);
+    ESP_LOGI(TAG, "cycles/frame capture: %lu encode: %lu decode: %lu, us/frame encode: %lu decode: %lu",
+        (uint32_t)(result.capture_cycles / frames), (uint32_t)(result.encode_cycles / frames),
+        (uint32_t)(result.decode_cycles / frames), (uint32_t)(result.encode_us / frames), (uint32_t)(result.decode_us / frames));
+    ESP_LOGI(TAG, "peak send queue: %u decode queue: %u, buffer allocations: %lu, heap delta: %d",
+        result.send_queue_peak, result.decode_queue_peak, result.buffer_allocations, result.heap_delta);
+}
@@ -0,0 +1,60 @@
+#ifndef AUDIO_BENCHMARK_H
+#define AUDIO_BENCHMARK_H
+
+#include <cstdint>
+#include <vector>
+
+#include <cJSON.h>
+
+struct AudioBenchmarkResult {
+    int frames = 0;
+    int64_t elapsed_us = 0;
+    uint64_t capture_cycles = 0;     // Codec read + resampling to 16 kHz
+    uint64_t encode_cycles = 0;
+    uint64_t decode_cycles = 0;      // Jitter buffer + opus decode + resampling to the output rate
+    int64_t encode_us = 0;
+    int64_t decode_us = 0;
+    size_t send_queue_peak = 0;
+    size_t decode_queue_peak = 0;
+    uint32_t buffer_allocations = 0; // Payload / PCM buffers that had to grow after warm-up
+    int heap_delta = 0;              // Internal heap lost between the start and the end of the run
+    size_t samples_played = 0;
+};
+
+/*
+ * Drives the audio pipeline stages (codec read, resampling, opus encode, send queue, jitter buffer,
+ * opus decode, codec write) with a DummyAudioCodec as fast as the CPU allows, to catch pipeline
+ * regressions without a network or a speaker. Runs on its own task, sized like the opus encode task.
+ *
+ * The stages are wired here from the same classes AudioService uses, with their own instances: a
+ * second AudioService would need the codec, AFE and wake word models the live one holds. Nothing
+ * is shared with the running service, packets included, so it keeps working during a run.
+ *
+ * Uplink packets are looped back into the downlink in bursts of |burst| frames, so the queues see
+ * the same kind of back pressure as with a server that sends ahead of realtime.
+ *
+ * tests/host/audio_service_benchmark.cc runs the whole AudioService the same way on a PC.
+ */
+class AudioBenchmark {
+public:
+    AudioBenchmark(int input_sample_rate, int output_sample_rate, int burst = 4);
+
+    // Replaces the default synthetic voice-like input with caller supplied PCM (mono, input sample rate)
+    void SetInput(std::vector<int16_t>&& pcm);
+    AudioBenchmarkResult Run(int frames);
+
+    static cJSON* ToJson(const AudioBenchmarkResult& result);
+    static void Log(const AudioBenchmarkResult& result);
+
+private:
+    int input_sample_rate_;
+    int output_sample_rate_;
+    int burst_;
+    std::vector<int16_t> input_;
+    AudioBenchmarkResult result_;
+
+    void GenerateInput();
+    void RunFrames(int frames);
+};
+
+#endif // AUDIO_BENCHMARK_H
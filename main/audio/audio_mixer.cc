@@ -0,0 +1,247 @@
+#include "audio_mixer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define TAG "AudioMixer"
+
+static int32_t GainToQ15(float gain) {
+    if (gain < 0) {
+        gain = 0;
+    } else if (gain > 4.0f) {
+        gain = 4.0f;
+    }
+    return (int32_t)(gain * 32768.0f);
+}
+
+MixerSource::MixerSource(const std::string& name, int output_sample_rate, float gain, bool duck,
+    std::function<void()> on_data)
+    : name_(name), output_sample_rate_(output_sample_rate), gain_q15_(GainToQ15(gain)), duck_(duck),
+      buffer_(MIXER_SOURCE_BUFFER_SAMPLES), on_data_(std::move(on_data)) {
+}
+
+void MixerSource::SetGain(float gain) {
+    gain_q15_ = GainToQ15(gain);
+}
+
+size_t MixerSource::available() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+}
+
+bool MixerSource::ready(size_t frame_samples) const {
+    size_t count = available();
+    return count >= frame_samples || (count > 0 && ended_.load(std::memory_order_acquire));
+}
+
+void MixerSource::Flush() {
+    // Applied by the output task, which owns the read position, and by the next Write() to the
+    // resampler, which belongs to the writer
+    flush_ = true;
+    reset_ = true;
+}
+
+void MixerSource::EndOfStream() {
+    ended_.store(true, std::memory_order_release);
+    if (on_data_) {
+        on_data_();
+    }
+}
+
+void MixerSource::ConfigureFilter(int sample_rate) {
+    x1_ = x2_ = y1_ = y2_ = 0;
+    filter_ = sample_rate > output_sample_rate_;
+    if (!filter_) {
+        return;
+    }
+    // Second order Butterworth low-pass (RBJ cookbook, Q = 1/sqrt(2)) at the source rate
+    float k = tanf((float)M_PI * 0.45f * output_sample_rate_ / sample_rate);
+    float norm = 1.0f / (1.0f + (float)M_SQRT2 * k + k * k);
+    b0_ = k * k * norm;
+    b1_ = 2.0f * b0_;
+    b2_ = b0_;
+    a1_ = 2.0f * (k * k - 1.0f) * norm;
+    a2_ = (1.0f - (float)M_SQRT2 * k + k * k) * norm;
+}
+
+bool MixerSource::Push(int16_t sample, int timeout_ms) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ >= buffer_.size()) {
+        cached_head_ = head_.load(std::memory_order_acquire);
+        while (tail - cached_head_ >= buffer_.size()) {
+            if (timeout_ms <= 0) {
+                return false;
+            }
+            // The output task drains a frame every few tens of milliseconds
+            vTaskDelay(pdMS_TO_TICKS(10));
+            timeout_ms -= 10;
+            cached_head_ = head_.load(std::memory_order_acquire);
+        }
+    }
+    buffer_[tail % buffer_.size()] = sample;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+bool MixerSource::Write(const int16_t* pcm, size_t samples, int sample_rate, int channels, int timeout_ms) {
+    ended_.store(false, std::memory_order_release);
+    // Flushed data must not leave its last sample or filter history in front of the new stream
+    if (reset_.exchange(false) || sample_rate != source_rate_) {
+        source_rate_ = sample_rate;
+        phase_ = 0;
+        last_sample_ = 0;
+        ConfigureFilter(sample_rate);
+    }
+    uint32_t step = ((uint64_t)sample_rate << 16) / output_sample_rate_;
+    size_t frames = samples / channels;
+    for (size_t i = 0; i < frames; i++) {
+        int32_t sample = pcm[i * channels];
+        if (channels == 2) {
+            sample = (sample + pcm[i * channels + 1]) / 2;
+        }
+        if (filter_) {
+            float x = (float)sample;
+            float y = b0_ * x + b1_ * x1_ + b2_ * x2_ - a1_ * y1_ - a2_ * y2_;
+            x2_ = x1_;
+            x1_ = x;
+            y2_ = y1_;
+            y1_ = y;
+            sample = y > INT16_MAX ? INT16_MAX : (y < INT16_MIN ? INT16_MIN : (int32_t)lrintf(y));
+        }
+        // Emit every output sample that falls between the previous input sample and this one
+        while (phase_ < 65536) {
+            int32_t out = last_sample_ + (int32_t)(((int64_t)(sample - last_sample_) * phase_) >> 16);
+            if (!Push((int16_t)out, timeout_ms)) {
+                // |phase_| stays below one input sample, the next write resumes from |last_sample_|
+                if (on_data_) {
+                    on_data_();
+                }
+                return false;
+            }
+            phase_ += step;
+        }
+        phase_ -= 65536;
+        last_sample_ = sample;
+    }
+    if (on_data_) {
+        on_data_();
+    }
+    return true;
+}
+
+size_t MixerSource::MixInto(int32_t* out, size_t samples, int32_t gain_q15_from, int32_t gain_q15_to) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    if (flush_.exchange(false)) {
+        head_.store(tail, std::memory_order_release);
+        return 0;
+    }
+    size_t count = std::min<size_t>(samples, tail - head);
+    // On underrun keep the partial frame for the next one instead of padding it with silence
+    if (count == 0 || (count < samples && !ended_.load(std::memory_order_acquire))) {
+        return 0;
+    }
+    int32_t gain_delta = gain_q15_to - gain_q15_from;
+    for (size_t i = 0; i < count; i++) {
+        int32_t gain = gain_q15_from + (int32_t)((int64_t)gain_delta * (int64_t)i / (int64_t)count);
+        out[i] += (buffer_[(head + i) % buffer_.size()] * gain) >> 15;
+    }
+    head_.store(head + count, std::memory_order_release);
+    return count;
+}
+
+AudioMixer::AudioMixer(int output_sample_rate) : output_sample_rate_(output_sample_rate) {
+    sources_.reserve(MIXER_MAX_SOURCES);
+    duck_state_q15_.reserve(MIXER_MAX_SOURCES);
+}
+
+MixerSource* AudioMixer::AddSource(const std::string& name, float gain, bool duck) {
+    // Sources are added during initialization, before any task mixes or writes
+    if (sources_.size() >= MIXER_MAX_SOURCES) {
+        ESP_LOGE(TAG, "Too many mixer sources, cannot add %s", name.c_str());
+        return nullptr;
+    }
+    sources_.push_back(std::make_unique<MixerSource>(name, output_sample_rate_, gain, duck, on_data_));
+    duck_state_q15_.push_back(32768);
+    return sources_.back().get();
+}
+
+MixerSource* AudioMixer::GetSource(const std::string& name) {
+    for (auto& source : sources_) {
+        if (source->name() == name) {
+            return source.get();
+        }
+    }
+    return nullptr;
+}
+
+void AudioMixer::SetTtsGain(float gain) {
+    tts_gain_q15_ = GainToQ15(gain);
+}
+
+void AudioMixer::PlayCue(const int16_t* pcm, size_t samples, float gain) {
+    {
+        std::lock_guard<std::mutex> lock(cue_mutex_);
+        cue_pcm_ = pcm;
+        cue_samples_ = samples;
+        cue_position_ = 0;
+        cue_gain_q15_ = GainToQ15(gain);
+    }
+    if (on_data_) {
+        on_data_();
+    }
+}
+
+bool AudioMixer::HasPendingAudio(size_t frame_samples) const {
+    for (auto& source : sources_) {
+        if (source->ready(frame_samples)) {
+            return true;
+        }
+    }
+    std::lock_guard<std::mutex> lock(cue_mutex_);
+    return cue_position_ < cue_samples_;
+}
+
+void AudioMixer::Mix(std::vector<int16_t>& pcm, size_t frame_samples, bool tts_active) {
+    if (pcm.empty()) {
+        pcm.assign(frame_samples, 0);
+    }
+    size_t samples = pcm.size();
+    if (accumulator_.size() < samples) {
+        accumulator_.resize(samples);
+    }
+
+    int32_t tts_gain = tts_gain_q15_;
+    for (size_t i = 0; i < samples; i++) {
+        accumulator_[i] = tts_gain == 32768 ? pcm[i] : (pcm[i] * tts_gain) >> 15;
+    }
+
+    for (size_t i = 0; i < sources_.size(); i++) {
+        auto& source = sources_[i];
+        // Ramp the ducking over one frame so it does not click
+        int32_t duck_to = source->ducks() && tts_active ? GainToQ15(MIXER_DUCK_GAIN) : 32768;
+        int32_t gain = GainToQ15(source->gain());
+        int32_t from = (int32_t)(((int64_t)gain * duck_state_q15_[i]) >> 15);
+        int32_t to = (int32_t)(((int64_t)gain * duck_to) >> 15);
+        duck_state_q15_[i] = duck_to;
+        source->MixInto(accumulator_.data(), samples, from, to);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(cue_mutex_);
+        if (cue_position_ < cue_samples_) {
+            size_t count = std::min(samples, cue_samples_ - cue_position_);
+            for (size_t i = 0; i < count; i++) {
+                accumulator_[i] += (cue_pcm_[cue_position_ + i] * cue_gain_q15_) >> 15;
+            }
+            cue_position_ += count;
+        }
+    }
+
+    for (size_t i = 0; i < samples; i++) {
+        int32_t value = accumulator_[i];
+        pcm[i] = value > INT16_MAX ? INT16_MAX : (value < INT16_MIN ? INT16_MIN : value);
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Samples (at the output rate, mono) buffered per mixer source, about 340 ms at 24 kHz
+#define MIXER_SOURCE_BUFFER_SAMPLES 8192
+#define MIXER_DUCK_GAIN 0.2f
+#define MIXER_MAX_SOURCES 4
+
+/*
+ * A named PCM input of the mixer. One task writes (any rate, mono or interleaved stereo),
+ * the audio output task reads. Samples are converted to the output rate on write with a
+ * linear interpolator, so sources such as 44.1 kHz MP3 music need no codec-side resampling.
+ * When downsampling, a low-pass biquad at 0.45 of the output rate runs ahead of the
+ * interpolator so content above the output Nyquist does not fold back as aliases.
+ *
+ * The output task only takes whole frames, a partial frame waits for the rest of its data
+ * until EndOfStream() says no more is coming.
+ */
+class MixerSource {
+public:
+    MixerSource(const std::string& name, int output_sample_rate, float gain, bool duck,
+        std::function<void()> on_data);
+
+    const std::string& name() const { return name_; }
+    void SetGain(float gain);
+    float gain() const { return gain_q15_ / 32768.0f; }
+    bool ducks() const { return duck_; }
+
+    // Blocks while the buffer is full, up to |timeout_ms|. Returns false if the data was not fully written.
+    bool Write(const int16_t* pcm, size_t samples, int sample_rate, int channels, int timeout_ms = 1000);
+    void Flush();
+    // Lets the output task play the last partial frame, cleared by the next Write()
+    void EndOfStream();
+    size_t available() const;
+    // Whether MixInto() would mix anything for a frame of |frame_samples|
+    bool ready(size_t frame_samples) const;
+
+    // Output task side: adds a frame of |samples| samples scaled by |gain_q15| onto |out| and
+    // returns |samples|, or returns 0 and leaves the data for the next frame if it is not complete.
+    // After EndOfStream() the remaining samples are mixed even if they are fewer.
+    size_t MixInto(int32_t* out, size_t samples, int32_t gain_q15_from, int32_t gain_q15_to);
+
+private:
+    std::string name_;
+    int output_sample_rate_;
+    std::atomic<int32_t> gain_q15_;
+    bool duck_;
+    std::vector<int16_t> buffer_;
+    std::atomic<uint32_t> head_ = 0;
+    std::atomic<uint32_t> tail_ = 0;
+    std::atomic<bool> flush_ = false;
+    std::atomic<bool> ended_ = false;
+    std::atomic<bool> reset_ = false;   // Set by Flush(), the next Write() starts the resampler over
+    uint32_t cached_head_ = 0;
+    std::function<void()> on_data_;
+    // Resampler state, producer side only
+    int source_rate_ = 0;
+    uint32_t phase_ = 0;        // Q16 position between |last_sample_| and the next input sample
+    int16_t last_sample_ = 0;
+    bool filter_ = false;
+    float b0_ = 0, b1_ = 0, b2_ = 0, a1_ = 0, a2_ = 0;
+    float x1_ = 0, x2_ = 0, y1_ = 0, y2_ = 0;
+
+    void ConfigureFilter(int sample_rate);
+
+    bool Push(int16_t sample, int timeout_ms);
+};
+
+/*
+ * Mixes several PCM sources into the frames played by the audio output task.
+ *
+ * Decoded server audio (TTS) stays on the playback queue and is the primary stream; named
+ * sources (music) and a one-shot cue are added on top of it, or mixed onto silence when no
+ * TTS is playing. Sources created with |duck| are attenuated while TTS frames are playing.
+ */
+class AudioMixer {
+public:
+    explicit AudioMixer(int output_sample_rate);
+
+    // |on_data| is called from producer tasks when a source gets data, to wake the output task.
+    // Sources keep a copy, so it has to be set before AddSource().
+    void OnData(std::function<void()> callback) { on_data_ = callback; }
+
+    MixerSource* AddSource(const std::string& name, float gain, bool duck);
+    MixerSource* GetSource(const std::string& name);
+
+    void SetTtsGain(float gain);
+    // Plays mono PCM at the output rate on top of everything else, replacing a cue in progress.
+    // The data must stay valid until it has been played (e.g. the sound cache PCM).
+    void PlayCue(const int16_t* pcm, size_t samples, float gain = 1.0f);
+
+    // Whether a source has a frame of |frame_samples| ready or a cue is playing
+    bool HasPendingAudio(size_t frame_samples) const;
+    // Mixes all sources onto |pcm|; when |pcm| is empty a silent frame of |frame_samples| is created first
+    void Mix(std::vector<int16_t>& pcm, size_t frame_samples, bool tts_active);
+
+private:
+    int output_sample_rate_;
+    std::vector<std::unique_ptr<MixerSource>> sources_;
+    std::vector<int32_t> accumulator_;
+    std::vector<int32_t> duck_state_q15_;
+    std::atomic<int32_t> tts_gain_q15_ = 32768;
+    std::function<void()> on_data_;
+
+    mutable std::mutex cue_mutex_;
+    const int16_t* cue_pcm_ = nullptr;
+    size_t cue_samples_ = 0;
+    size_t cue_position_ = 0;
+    int32_t cue_gain_q15_ = 32768;
+};
+
+#endif // AUDIO_MIXER_H
@@ -0,0 +1,25 @@
+#include "audio_packet_pool.h"
+
+ObjectPool<AudioStreamPacket, AUDIO_PACKET_POOL_SIZE>& GetPacketPool() {
+    static ObjectPool<AudioStreamPacket, AUDIO_PACKET_POOL_SIZE> pool;
+    return pool;
+}
+
+std::unique_ptr<AudioStreamPacket> AudioStreamPacket::Create() {
+    auto packet = GetPacketPool().Acquire();
+    packet->sample_rate = 0;
+    packet->frame_duration = 0;
+    packet->timestamp = 0;
+    packet->sequence = 0;
+    packet->headroom = 0;
+    packet->trace = LatencyStamps();
+    packet->payload.clear();
+    return std::unique_ptr<AudioStreamPacket>(packet);
+}
+
+void AudioStreamPacket::operator delete(AudioStreamPacket* packet, std::destroying_delete_t) {
+    if (!GetPacketPool().Release(packet)) {
+        packet->~AudioStreamPacket();
+        ::operator delete(packet);
+    }
+}
@@ -0,0 +1,14 @@
+#ifndef AUDIO_PACKET_POOL_H
+#define AUDIO_PACKET_POOL_H
+
+#include "object_pool.h"
+#include "protocol.h"
+
+// Full decode and send queues, the jitter buffer and the packets in flight (being encoded, decoded,
+// sent or received). audio_service.cc checks it against the queue lengths.
+#define AUDIO_PACKET_POOL_SIZE 100
+
+// The pool behind AudioStreamPacket::Create() and its destroying delete
+ObjectPool<AudioStreamPacket, AUDIO_PACKET_POOL_SIZE>& GetPacketPool();
+
+#endif // AUDIO_PACKET_POOL_H
@@ -1,6 +1,10 @@
 #include "audio_service.h"
+#include "audio_packet_pool.h"
+#include "pcm_kernels.h"
 #include <esp_log.h>
+#include <esp_cpu.h>
 #include <cstring>
+#include <algorithm>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -18,6 +22,37 @@
 #define TAG "AudioService"
 
 
+static_assert(AUDIO_PACKET_POOL_SIZE >= MAX_DECODE_PACKETS_IN_QUEUE + JITTER_BUFFER_CAPACITY + MAX_SEND_PACKETS_IN_QUEUE + 4,
+    "The packet pool must hold full queues plus the packets in flight");
+
+static ObjectPool<AudioTask, AUDIO_TASK_POOL_SIZE>& GetTaskPool() {
+    static ObjectPool<AudioTask, AUDIO_TASK_POOL_SIZE> pool;
+    return pool;
+}
+
+std::unique_ptr<AudioTask> AudioTask::Create() {
+    auto task = GetTaskPool().Acquire();
+    task->timestamp = 0;
+    task->trace = LatencyStamps();
+    task->pcm.clear();
+    return std::unique_ptr<AudioTask>(task);
+}
+
+void AudioTask::operator delete(AudioTask* task, std::destroying_delete_t) {
+    if (!GetTaskPool().Release(task)) {
+        task->~AudioTask();
+        ::operator delete(task);
+    }
+}
+
+
+static BaseType_t GetTaskCore(int core) {
+    if (core < 0 || core >= portNUM_PROCESSORS) {
+        return tskNO_AFFINITY;
+    }
+    return core;
+}
+
 AudioService::AudioService() {
     event_group_ = xEventGroupCreate();
 }
@@ -34,9 +69,17 @@ void AudioService::Initialize(AudioCodec* codec) {
     codec_->Start();
 
     /* Setup the audio codec */
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
+    decoder_cache_ = std::make_unique<DecoderCache>(codec->output_sample_rate());
+    sound_cache_ = std::make_unique<SoundCache>(codec->output_sample_rate());
+    mixer_ = std::make_unique<AudioMixer>(codec->output_sample_rate());
+    mixer_->OnData([this]() {
+        xEventGroupSetBits(event_group_, AS_EVENT_PLAYBACK_NOT_EMPTY);
+    });
+    mixer_->AddSource("music", 1.0f, true);
+    decoder_cache_->Select(codec->output_sample_rate(), OPUS_FRAME_DURATION_MS);
+    opus_encoder_ = std::make_unique<UplinkEncoder>(16000, 1, OPUS_FRAME_DURATION_MS);
     opus_encoder_->SetComplexity(0);
+    opus_encoder_->SetBitrate(uplink_rate_.bitrate());
 
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
@@ -75,7 +118,8 @@ void AudioService::Initialize(AudioCodec* codec) {
 
 void AudioService::Start() {
     service_stopped_ = false;
-    xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING | AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING);
+    xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING | AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING |
+        AS_EVENT_QUEUE_BITS);
 
     esp_timer_start_periodic(audio_power_timer_, 1000000);
 
@@ -109,12 +153,20 @@ void AudioService::Start() {
     }, "audio_output", 2048, this, 4, &audio_output_task_handle_);
 #endif
 
-    /* Start the opus codec task */
-    xTaskCreate([](void* arg) {
+    /* Start the opus encoder and decoder tasks, they run independently so a burst in one direction does not stall the other */
+    xTaskCreatePinnedToCore([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
-        audio_service->OpusCodecTask();
+        audio_service->OpusEncodeTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 13, this, 2, &opus_codec_task_handle_);
+    }, "opus_encode", OPUS_ENCODE_TASK_STACK_SIZE, this, CONFIG_OPUS_ENCODE_TASK_PRIORITY,
+        &opus_encode_task_handle_, GetTaskCore(CONFIG_OPUS_ENCODE_TASK_CORE));
+
+    xTaskCreatePinnedToCore([](void* arg) {
+        AudioService* audio_service = (AudioService*)arg;
+        audio_service->OpusDecodeTask();
+        vTaskDelete(NULL);
+    }, "opus_decode", OPUS_DECODE_TASK_STACK_SIZE, this, CONFIG_OPUS_DECODE_TASK_PRIORITY,
+        &opus_decode_task_handle_, GetTaskCore(CONFIG_OPUS_DECODE_TASK_CORE));
 }
 
 void AudioService::Stop() {
@@ -124,15 +176,19 @@ void AudioService::Stop() {
         AS_EVENT_WAKE_WORD_RUNNING |
         AS_EVENT_AUDIO_PROCESSOR_RUNNING);
 
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    audio_encode_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    audio_encode_queue_.Clear();
+    audio_decode_queue_.Clear();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+    xEventGroupSetBits(event_group_, AS_EVENT_QUEUE_BITS);
+}
+
+bool AudioService::WaitQueueEvent(EventBits_t bits, TickType_t timeout) {
+    xEventGroupWaitBits(event_group_, bits, pdTRUE, pdFALSE, timeout);
+    return !service_stopped_;
 }
 
-bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
+bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples, AudioInputScratch& scratch) {
     if (!codec_->input_enabled()) {
         esp_timer_stop(audio_power_timer_);
         esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
@@ -145,25 +201,42 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
             return false;
         }
         if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
+            /* Place the scratch channels so they line up with |data| and the SIMD kernels see aligned blocks */
+            size_t frames = data.size() / 2;
+            size_t lead = PcmAlignmentLead(data.data());
+            int16_t* mic = AlignPcmScratch(scratch.mic, frames, lead);
+            int16_t* reference = AlignPcmScratch(scratch.reference, frames, lead);
+            uint32_t start_cycles = esp_cpu_get_cycle_count();
+            DeinterleaveStereo(data.data(), mic, reference, frames);
+            uint32_t interleave_cycles = esp_cpu_get_cycle_count() - start_cycles;
+
+            std::lock_guard<std::mutex> lock(input_resampler_mutex_);
+            size_t resampled_frames = input_resampler_.GetOutputSamples(frames);
+            data.resize(resampled_frames * 2);
+            lead = PcmAlignmentLead(data.data());
+            int16_t* resampled_mic = AlignPcmScratch(scratch.resampled_mic, resampled_frames, lead);
+            int16_t* resampled_reference = AlignPcmScratch(scratch.resampled_reference, resampled_frames, lead);
+            start_cycles = esp_cpu_get_cycle_count();
+            input_resampler_.Process(mic, frames, resampled_mic);
+            reference_resampler_.Process(reference, frames, resampled_reference);
+            debug_statistics_.resample_cycles += esp_cpu_get_cycle_count() - start_cycles;
+
+            start_cycles = esp_cpu_get_cycle_count();
+            InterleaveStereo(resampled_mic, resampled_reference, data.data(), resampled_frames);
+            debug_statistics_.interleave_cycles += interleave_cycles + (esp_cpu_get_cycle_count() - start_cycles);
+            debug_statistics_.convert_count++;
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            std::lock_guard<std::mutex> lock(input_resampler_mutex_);
+            size_t resampled_size = input_resampler_.GetOutputSamples(data.size());
+            if (scratch.resampled_mic.size() < resampled_size) {
+                scratch.resampled_mic.resize(resampled_size);
+            }
+            uint32_t start_cycles = esp_cpu_get_cycle_count();
+            input_resampler_.Process(data.data(), data.size(), scratch.resampled_mic.data());
+            debug_statistics_.resample_cycles += esp_cpu_get_cycle_count() - start_cycles;
+            debug_statistics_.convert_count++;
+            // Copy back instead of swapping so |data| keeps the larger capacity needed for the next read
+            data.assign(scratch.resampled_mic.begin(), scratch.resampled_mic.begin() + resampled_size);
         }
     } else {
         data.resize(samples * codec_->input_channels());
@@ -188,6 +261,8 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
 }
 
 void AudioService::AudioInputTask() {
+    /* Reused for every read so the capture loop does not allocate */
+    std::vector<int16_t> data;
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
             AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING,
@@ -209,16 +284,11 @@ void AudioService::AudioInputTask() {
                 EnableAudioTesting(false);
                 continue;
             }
-            std::vector<int16_t> data;
             int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
-            if (ReadAudioData(data, 16000, samples)) {
+            if (ReadAudioData(data, 16000, samples, input_scratch_)) {
                 // If input channels is 2, we need to fetch the left channel data
                 if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
+                    ExtractLeftChannel(data);
                 }
                 PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
                 continue;
@@ -227,10 +297,9 @@ void AudioService::AudioInputTask() {
 
         /* Feed the wake word */
         if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
             int samples = wake_word_->GetFeedSize();
             if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
+                if (ReadAudioData(data, 16000, samples, input_scratch_)) {
                     wake_word_->Feed(data);
                     continue;
                 }
@@ -239,10 +308,10 @@ void AudioService::AudioInputTask() {
 
         /* Feed the audio processor */
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
-                if (ReadAudioData(data, 16000, samples)) {
+                if (ReadAudioData(data, 16000, samples, input_scratch_)) {
+                    LatencyTrace::GetInstance().MarkCaptured(samples);
                     audio_processor_->Feed(std::move(data));
                     continue;
                 }
@@ -257,24 +326,35 @@ void AudioService::AudioInputTask() {
 }
 
 void AudioService::AudioOutputTask() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
-        if (service_stopped_) {
-            break;
+    while (!service_stopped_) {
+        if (audio_playback_queue_.ApplyPendingClear()) {
+            xEventGroupSetBits(event_group_, AS_EVENT_PLAYBACK_NOT_FULL);
         }
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        audio_queue_cv_.notify_all();
-        lock.unlock();
-
-        if (!codec_->output_enabled()) {
-            esp_timer_stop(audio_power_timer_);
-            esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-            codec_->EnableOutput(true);
+        std::unique_ptr<AudioTask> task;
+        if (!audio_playback_queue_.Pop(task)) {
+            size_t frame_samples = codec_->output_sample_rate() * OPUS_FRAME_DURATION_MS / 1000;
+            if (!mixer_->HasPendingAudio(frame_samples)) {
+                WaitQueueEvent(AS_EVENT_PLAYBACK_NOT_EMPTY);
+                continue;
+            }
+            /* No TTS frame, play the other mixer sources on their own */
+            mix_buffer_.clear();
+            mixer_->Mix(mix_buffer_, frame_samples, false);
+            EnableOutput();
+            codec_->OutputData(mix_buffer_);
+            last_output_time_ = std::chrono::steady_clock::now();
+            continue;
         }
+        xEventGroupSetBits(event_group_, AS_EVENT_PLAYBACK_NOT_FULL);
+        auto& trace = LatencyTrace::GetInstance();
+        trace.Stamp(kLatencyStagePlaybackQueue, task->trace);
+
+        mixer_->Mix(task->pcm, task->pcm.size(), true);
+        EnableOutput();
         codec_->OutputData(task->pcm);
+        trace.Stamp(kLatencyStageOutput, task->trace);
+        trace.Finish(kLatencyStageDownlink, task->trace);
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
@@ -282,9 +362,12 @@ void AudioService::AudioOutputTask() {
 
 #if CONFIG_USE_SERVER_AEC
         /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
-            lock.lock();
-            timestamp_queue_.push_back(task->timestamp);
+        if (task->timestamp > 0 && !timestamp_queue_.Push(uint32_t(task->timestamp))) {
+            // Stays full for as long as nothing is encoded, so only log at 1, 2, 4, 8... drops
+            uint32_t dropped = ++debug_statistics_.timestamps_dropped;
+            if ((dropped & (dropped - 1)) == 0) {
+                ESP_LOGW(TAG, "Timestamp queue is full, %lu timestamps dropped", dropped);
+            }
         }
 #endif
     }
@@ -292,148 +375,256 @@ void AudioService::AudioOutputTask() {
     ESP_LOGW(TAG, "Audio output task stopped");
 }
 
-void AudioService::OpusCodecTask() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
-            return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
-        });
-        if (service_stopped_) {
-            break;
+void AudioService::OpusDecodeTask() {
+    while (!service_stopped_) {
+        /* Apply clears requested by Stop() / ResetDecoder() and release the waiting producers */
+        if (audio_decode_queue_.ApplyPendingClear()) {
+            jitter_buffer_.Reset();
+            decoder_cache_->decoder()->ResetState();
+            xEventGroupSetBits(event_group_, AS_EVENT_DECODE_NOT_FULL);
         }
+        audio_testing_queue_.ApplyPendingClear();
 
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
+        if (audio_playback_queue_.full()) {
+            WaitQueueEvent(AS_EVENT_PLAYBACK_NOT_FULL);
+            continue;
+        }
 
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
+        size_t depth = audio_decode_queue_.size();
+        if (depth > debug_statistics_.decode_queue_peak) {
+            debug_statistics_.decode_queue_peak = depth;
+        }
 
-            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
-                }
+        /* Move arrived packets into the jitter buffer, unsequenced ones (websocket, local sounds) are decoded directly */
+        int64_t now_ms = esp_timer_get_time() / 1000;
+        std::unique_ptr<AudioStreamPacket> packet;
+        while (!jitter_buffer_.full()) {
+            std::unique_ptr<AudioStreamPacket> incoming;
+            if (!audio_decode_queue_.Pop(incoming)) {
+                break;
+            }
+            xEventGroupSetBits(event_group_, AS_EVENT_DECODE_NOT_FULL);
+            if (incoming->sequence == 0) {
+                packet = std::move(incoming);
+                break;
+            }
+            jitter_buffer_.Push(std::move(incoming), now_ms);
+        }
 
-                lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
+        bool conceal = false;
+        if (!packet) {
+            conceal = jitter_buffer_.Pop(packet, now_ms) == JitterBuffer::kPopLost;
+        }
+        if (!packet && !conceal && audio_testing_playback_ && !audio_testing_queue_.Pop(packet)) {
+            audio_testing_playback_ = false;
+        }
+        if (!packet && !conceal) {
+            if (jitter_buffer_.empty()) {
+                WaitQueueEvent(AS_EVENT_DECODE_NOT_EMPTY);
             } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
-                lock.lock();
-            }
-            debug_statistics_.decode_count++;
-        }
-        
-        /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
-            auto task = std::move(audio_encode_queue_.front());
-            audio_encode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
-                continue;
+                WaitQueueEvent(AS_EVENT_DECODE_NOT_EMPTY, pdMS_TO_TICKS(JITTER_BUFFER_POLL_MS));
             }
+            continue;
+        }
 
-            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
+        int64_t start_time = esp_timer_get_time();
+        auto task = AudioTask::Create();
+        task->type = kAudioTaskTypeDecodeToPlaybackQueue;
+        if (packet) {
+            task->trace = packet->trace;
+            LatencyTrace::GetInstance().Stamp(kLatencyStageDecodeQueue, task->trace);
+        }
+        size_t pcm_capacity = task->pcm.capacity();
+        bool decoded;
+        OpusResampler* output_resampler = nullptr;
+        if (conceal) {
+            // An empty payload makes opus run its packet loss concealment for one frame
+            plc_payload_.clear();
+            auto decoder = decoder_cache_->decoder();
+            decoded = decoder->Decode(std::move(plc_payload_), task->pcm);
+            output_resampler = decoder_cache_->resampler();
+            if (!decoded) {
+                task->pcm.assign(decoder->sample_rate() * decoder->duration_ms() / 1000, 0);
+                decoded = true;
+            }
+        } else {
+            task->timestamp = packet->timestamp;
+            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
+            decoded = decoder_cache_->decoder()->Decode(std::move(packet->payload), task->pcm);
+            output_resampler = decoder_cache_->resampler();
+        }
+        if (decoded) {
+            // Resample if the sample rate is different
+            if (output_resampler != nullptr) {
+                int target_size = output_resampler->GetOutputSamples(task->pcm.size());
+                if (output_resample_buffer_.capacity() < (size_t)target_size) {
+                    debug_statistics_.buffer_allocations++;
                 }
-            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                audio_testing_queue_.push_back(std::move(packet));
+                output_resample_buffer_.resize(target_size);
+                output_resampler->Process(task->pcm.data(), task->pcm.size(), output_resample_buffer_.data());
+                // Swap so both buffers keep their capacity for the next frame
+                task->pcm.swap(output_resample_buffer_);
             }
-            debug_statistics_.encode_count++;
-            lock.lock();
+            if (task->pcm.capacity() > pcm_capacity) {
+                debug_statistics_.buffer_allocations++;
+            }
+            LatencyTrace::GetInstance().Stamp(kLatencyStageDecode, task->trace);
+
+            // This task is the only playback producer, so the space checked above is still there
+            audio_playback_queue_.Push(std::move(task));
+            xEventGroupSetBits(event_group_, AS_EVENT_PLAYBACK_NOT_EMPTY);
+        } else {
+            ESP_LOGE(TAG, "Failed to decode audio");
         }
+        debug_statistics_.decode_count++;
+        debug_statistics_.decode_busy_us += esp_timer_get_time() - start_time;
     }
 
-    ESP_LOGW(TAG, "Opus codec task stopped");
+    ESP_LOGW(TAG, "Opus decode task stopped");
 }
 
-void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
-    if (opus_decoder_->sample_rate() == sample_rate && opus_decoder_->duration_ms() == frame_duration) {
-        return;
-    }
+void AudioService::OpusEncodeTask() {
+    while (!service_stopped_) {
+        if (audio_encode_queue_.ApplyPendingClear()) {
+            xEventGroupSetBits(event_group_, AS_EVENT_ENCODE_NOT_FULL);
+        }
+
+        bool has_task = !audio_encode_queue_.empty();
+        if (!has_task || audio_send_queue_.full()) {
+            WaitQueueEvent(has_task ? AS_EVENT_SEND_NOT_FULL : AS_EVENT_ENCODE_NOT_EMPTY);
+            continue;
+        }
+
+        size_t depth = audio_encode_queue_.size();
+        if (depth > debug_statistics_.encode_queue_peak) {
+            debug_statistics_.encode_queue_peak = depth;
+        }
 
-    opus_decoder_.reset();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+        std::unique_ptr<AudioTask> task;
+        if (!audio_encode_queue_.Pop(task)) {
+            continue;
+        }
+        xEventGroupSetBits(event_group_, AS_EVENT_ENCODE_NOT_FULL);
+        auto& trace = LatencyTrace::GetInstance();
+        trace.Stamp(kLatencyStageEncodeQueue, task->trace);
+
+        int64_t start_time = esp_timer_get_time();
+        auto packet = AudioStreamPacket::Create();
+        packet->frame_duration = OPUS_FRAME_DURATION_MS;
+        packet->sample_rate = 16000;
+        packet->timestamp = task->timestamp;
+        size_t payload_capacity = packet->payload.capacity();
+        int bitrate = uplink_rate_.bitrate();
+        if (bitrate != opus_encoder_->bitrate()) {
+            opus_encoder_->SetBitrate(bitrate);
+        }
+        // Packets for the server leave room for the transport header, so it can frame them in place
+        if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+            packet->headroom = AUDIO_PACKET_HEADROOM;
+        }
+        if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload, packet->headroom)) {
+            ESP_LOGE(TAG, "Failed to encode audio");
+            continue;
+        }
+        if (packet->payload.capacity() > payload_capacity) {
+            debug_statistics_.buffer_allocations++;
+        }
+        packet->trace = task->trace;
+        trace.Stamp(kLatencyStageEncode, packet->trace);
 
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+        if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+            audio_send_queue_.Push(std::move(packet));
+            if (callbacks_.on_send_queue_available) {
+                callbacks_.on_send_queue_available();
+            }
+        } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
+            if (!audio_testing_queue_.Push(std::move(packet))) {
+                ESP_LOGW(TAG, "Audio testing queue is full, dropping packet");
+            }
+        }
+        debug_statistics_.encode_count++;
+        debug_statistics_.encode_busy_us += esp_timer_get_time() - start_time;
     }
+
+    ESP_LOGW(TAG, "Opus encode task stopped");
+}
+
+void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
+    // Cached decoders make switching between cue and server audio formats cheap
+    decoder_cache_->Select(sample_rate, frame_duration);
 }
 
 void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
-    auto task = std::make_unique<AudioTask>();
+    auto task = AudioTask::Create();
     task->type = type;
-    task->pcm = std::move(pcm);
+    // Swap instead of move: the producer gets the pooled buffer back and can refill it without allocating
+    task->pcm.swap(pcm);
     
     /* Push the task to the encode queue */
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
+    std::lock_guard<std::mutex> lock(encode_producer_mutex_);
 
     /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
-        } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        size_t timestamps = timestamp_queue_.size();
+        uint32_t timestamp;
+        if (timestamp_queue_.Pop(timestamp)) {
+            if (timestamps <= MAX_TIMESTAMPS_IN_QUEUE) {
+                task->timestamp = timestamp;
+            } else {
+                ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamps);
+            }
         }
-        timestamp_queue_.pop_front();
+        auto& trace = LatencyTrace::GetInstance();
+        trace.Begin(task->trace, trace.CaptureTime(task->pcm.size()));
     }
 
-    audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
-    audio_encode_queue_.push_back(std::move(task));
-    audio_queue_cv_.notify_all();
+    while (audio_encode_queue_.full()) {
+        if (!WaitQueueEvent(AS_EVENT_ENCODE_NOT_FULL)) {
+            return;
+        }
+    }
+    LatencyTrace::GetInstance().Stamp(kLatencyStageCapture, task->trace);
+    audio_encode_queue_.Push(std::move(task));
+    xEventGroupSetBits(event_group_, AS_EVENT_ENCODE_NOT_EMPTY);
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
-        if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
-        } else {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(decode_producer_mutex_);
+            if (!audio_decode_queue_.full()) {
+                LatencyTrace::GetInstance().Stamp(kLatencyStageReceive, packet->trace);
+                audio_decode_queue_.Push(std::move(packet));
+                xEventGroupSetBits(event_group_, AS_EVENT_DECODE_NOT_EMPTY);
+                return true;
+            }
+        }
+        // Wait without the lock, a blocking PlaySound() must not hold up the network receive path
+        if (!wait || !WaitQueueEvent(AS_EVENT_DECODE_NOT_FULL)) {
             return false;
         }
     }
-    audio_decode_queue_.push_back(std::move(packet));
-    audio_queue_cv_.notify_all();
-    return true;
 }
 
 std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    if (audio_send_queue_.empty()) {
+    std::unique_ptr<AudioStreamPacket> packet;
+    // A backlog beyond the budget is stale by the time it would arrive, dropping the oldest frames
+    // keeps the uplink latency bounded while the rate controller lowers the bitrate
+    while (audio_send_queue_.size() > UPLINK_MAX_DELAY_FRAMES && audio_send_queue_.Pop(packet)) {
+        uplink_rate_.OnFrameDropped();
+    }
+    if (!audio_send_queue_.Pop(packet)) {
         return nullptr;
     }
-    auto packet = std::move(audio_send_queue_.front());
-    audio_send_queue_.pop_front();
-    audio_queue_cv_.notify_all();
+    xEventGroupSetBits(event_group_, AS_EVENT_SEND_NOT_FULL);
+    LatencyTrace::GetInstance().Stamp(kLatencyStageSendQueue, packet->trace);
     return packet;
 }
 
+void AudioService::OnPacketSent(bool sent) {
+    uplink_rate_.OnSendResult(sent, audio_send_queue_.size(), esp_timer_get_time() / 1000);
+}
+
 void AudioService::EncodeWakeWord() {
     if (wake_word_) {
         wake_word_->EncodeWakeWordData();
@@ -445,7 +636,7 @@ const std::string& AudioService::GetLastWakeWord() const {
 }
 
 std::unique_ptr<AudioStreamPacket> AudioService::PopWakeWordPacket() {
-    auto packet = std::make_unique<AudioStreamPacket>();
+    auto packet = AudioStreamPacket::Create();
     if (wake_word_->GetWakeWordOpus(packet->payload)) {
         return packet;
     }
@@ -485,6 +676,7 @@ void AudioService::EnableVoiceProcessing(bool enable) {
         /* We should make sure no audio is playing */
         ResetDecoder();
         audio_input_need_warmup_ = true;
+        LatencyTrace::GetInstance().ResetCapture();
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
@@ -499,10 +691,9 @@ void AudioService::EnableAudioTesting(bool enable) {
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
-        audio_queue_cv_.notify_all();
+        /* Let the opus decode task play back audio_testing_queue_ once the decode queue is drained */
+        audio_testing_playback_ = true;
+        xEventGroupSetBits(event_group_, AS_EVENT_DECODE_NOT_EMPTY);
     }
 }
 
@@ -520,118 +711,57 @@ void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
     callbacks_ = callbacks;
 }
 
-void AudioService::PlaySound(const std::string_view& ogg) {
+void AudioService::EnableOutput() {
     if (!codec_->output_enabled()) {
         esp_timer_stop(audio_power_timer_);
         esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
         codec_->EnableOutput(true);
     }
+}
 
-    const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
-    size_t size = ogg.size();
-    size_t offset = 0;
-
-    auto find_page = [&](size_t start)->size_t {
-        for (size_t i = start; i + 4 <= size; ++i) {
-            if (buf[i] == 'O' && buf[i+1] == 'g' && buf[i+2] == 'g' && buf[i+3] == 'S') return i;
-        }
-        return static_cast<size_t>(-1);
-    };
-
-    bool seen_head = false;
-    bool seen_tags = false;
-    int sample_rate = 16000; // 默认值
+void AudioService::PlaySound(const std::string_view& ogg) {
+    EnableOutput();
 
-    while (true) {
-        size_t pos = find_page(offset);
-        if (pos == static_cast<size_t>(-1)) break;
-        offset = pos;
-        if (offset + 27 > size) break;
-
-        const uint8_t* page = buf + offset;
-        uint8_t page_segments = page[26];
-        size_t seg_table_off = offset + 27;
-        if (seg_table_off + page_segments > size) break;
-
-        size_t body_size = 0;
-        for (size_t i = 0; i < page_segments; ++i) body_size += page[27 + i];
-
-        size_t body_off = seg_table_off + page_segments;
-        if (body_off + body_size > size) break;
-
-        // Parse packets using lacing
-        size_t cur = body_off;
-        size_t seg_idx = 0;
-        while (seg_idx < page_segments) {
-            size_t pkt_len = 0;
-            size_t pkt_start = cur;
-            bool continued = false;
-            do {
-                uint8_t l = page[27 + seg_idx++];
-                pkt_len += l;
-                cur += l;
-                continued = (l == 255);
-            } while (continued && seg_idx < page_segments);
-
-            if (pkt_len == 0) continue;
-            const uint8_t* pkt_ptr = buf + pkt_start;
-
-            if (!seen_head) {
-                // 解析OpusHead包
-                if (pkt_len >= 19 && std::memcmp(pkt_ptr, "OpusHead", 8) == 0) {
-                    seen_head = true;
-                    
-                    // OpusHead结构：[0-7] "OpusHead", [8] version, [9] channel_count, [10-11] pre_skip
-                    // [12-15] input_sample_rate, [16-17] output_gain, [18] mapping_family
-                    if (pkt_len >= 12) {
-                        uint8_t version = pkt_ptr[8];
-                        uint8_t channel_count = pkt_ptr[9];
-                        
-                        if (pkt_len >= 16) {
-                            // 读取输入采样率 (little-endian)
-                            sample_rate = pkt_ptr[12] | (pkt_ptr[13] << 8) | 
-                                        (pkt_ptr[14] << 16) | (pkt_ptr[15] << 24);
-                            ESP_LOGI(TAG, "OpusHead: version=%d, channels=%d, sample_rate=%d", 
-                                   version, channel_count, sample_rate);
-                        }
-                    }
-                }
-                continue;
-            }
-            if (!seen_tags) {
-                // Expect OpusTags in second packet
-                if (pkt_len >= 8 && std::memcmp(pkt_ptr, "OpusTags", 8) == 0) {
-                    seen_tags = true;
-                }
-                continue;
-            }
+    /* The OGG pages are parsed once, later plays only walk the packet index */
+    auto sound = sound_cache_->Get(ogg);
+    if (sound == nullptr) {
+        return;
+    }
 
-            // Audio packet (Opus)
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->sample_rate = sample_rate;
-            packet->frame_duration = 60;
-            packet->payload.resize(pkt_len);
-            std::memcpy(packet->payload.data(), pkt_ptr, pkt_len);
-            PushPacketToDecodeQueue(std::move(packet), true);
-        }
+    if (sound->pcm_ready) {
+        /* Pre-decoded cue: mixed on top of whatever is playing instead of waiting behind TTS */
+        mixer_->PlayCue(sound->pcm, sound->pcm_samples);
+        return;
+    }
 
-        offset = body_off + body_size;
+    for (auto& ref : sound->packets) {
+        auto packet = AudioStreamPacket::Create();
+        packet->sample_rate = sound->sample_rate;
+        packet->frame_duration = 60;
+        packet->payload.assign(sound->data + ref.offset, sound->data + ref.offset + ref.length);
+        PushPacketToDecodeQueue(std::move(packet), true);
     }
 }
 
+void AudioService::PreloadSounds(std::vector<std::string_view>&& sounds) {
+    sound_cache_->Preload(std::move(sounds));
+}
+
 bool AudioService::IsIdle() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && jitter_buffer_.empty() &&
+        audio_playback_queue_.empty() && audio_testing_queue_.empty() &&
+        !mixer_->HasPendingAudio(codec_->output_sample_rate() * OPUS_FRAME_DURATION_MS / 1000);
 }
 
 void AudioService::ResetDecoder() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    opus_decoder_->ResetState();
-    timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    /* The opus decode task resets the decoder state when it applies the decode queue clear */
+    timestamp_queue_.Clear();
+    audio_decode_queue_.Clear();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+    audio_testing_playback_ = false;
+    /* Wake the consumers so the cleared packets are released right away */
+    xEventGroupSetBits(event_group_, AS_EVENT_DECODE_NOT_EMPTY | AS_EVENT_PLAYBACK_NOT_EMPTY);
 }
 
 void AudioService::CheckAndUpdateAudioPowerState() {
@@ -649,6 +779,40 @@ void AudioService::CheckAndUpdateAudioPowerState() {
     }
 }
 
+void AudioService::PrintDebugStatistics() {
+    debug_statistics_.pool_heap_allocations = GetPacketPool().heap_allocations() + GetTaskPool().heap_allocations();
+    ESP_LOGI(TAG, "frames input: %lu encode: %lu decode: %lu playback: %lu, aec timestamps dropped: %lu",
+        debug_statistics_.input_count, debug_statistics_.encode_count,
+        debug_statistics_.decode_count, debug_statistics_.playback_count, debug_statistics_.timestamps_dropped);
+    ESP_LOGI(TAG, "opus encode: queue %u (peak %u) send %u busy %lu ms, decode: queue %u (peak %u) playback %u busy %lu ms",
+        audio_encode_queue_.size(), debug_statistics_.encode_queue_peak, audio_send_queue_.size(),
+        (uint32_t)(debug_statistics_.encode_busy_us / 1000),
+        audio_decode_queue_.size(), debug_statistics_.decode_queue_peak, audio_playback_queue_.size(),
+        (uint32_t)(debug_statistics_.decode_busy_us / 1000));
+    auto& uplink = uplink_rate_.statistics();
+    ESP_LOGI(TAG, "uplink: bitrate %d, sent: %lu failures: %lu dropped: %lu, queue peak %u",
+        uplink_rate_.bitrate(), uplink.sent, uplink.failures, uplink.dropped, uplink.queue_peak);
+    auto& jitter = jitter_buffer_.statistics();
+    ESP_LOGI(TAG, "jitter buffer: %u frames (target %d) jitter %d ms, received: %lu late: %lu duplicate: %lu lost: %lu concealed: %lu underruns: %lu",
+        jitter_buffer_.size(), jitter_buffer_.target_delay_frames(), jitter_buffer_.jitter_ms(),
+        jitter.received, jitter.late, jitter.duplicate, jitter.lost, jitter.concealed, jitter.underruns);
+    if (debug_statistics_.convert_count > 0) {
+        ESP_LOGI(TAG, "input convert: (de)interleave %lu cycles/frame, resample %lu cycles/frame",
+            (uint32_t)(debug_statistics_.interleave_cycles / debug_statistics_.convert_count),
+            (uint32_t)(debug_statistics_.resample_cycles / debug_statistics_.convert_count));
+    }
+    ESP_LOGI(TAG, "packet pool: %u/%u peak, task pool: %u/%u peak, heap allocations pool: %lu buffers: %lu",
+        GetPacketPool().high_water(), GetPacketPool().capacity(),
+        GetTaskPool().high_water(), GetTaskPool().capacity(),
+        debug_statistics_.pool_heap_allocations, debug_statistics_.buffer_allocations);
+    ESP_LOGI(TAG, "sound cache: %u sounds, index %u bytes, decoded %u bytes",
+        sound_cache_->size(), sound_cache_->index_memory(), sound_cache_->pcm_memory());
+    auto& decoders = decoder_cache_->statistics();
+    ESP_LOGI(TAG, "decoder cache: %u bytes, switches: %lu misses: %lu evictions: %lu",
+        decoders.memory, decoders.switches, decoders.misses, decoders.evictions);
+    LatencyTrace::GetInstance().Dump();
+}
+
 void AudioService::SetModelsList(srmodel_list_t* models_list) {
     models_list_ = models_list;
 
@@ -674,6 +838,11 @@ void AudioService::SetModelsList(srmodel_list_t* models_list) {
                 callbacks_.on_wake_word_detected(wake_word);
             }
         });
+        wake_word_->OnSpeechStart([this]() {
+            if (callbacks_.on_wake_word_speech) {
+                callbacks_.on_wake_word_speech();
+            }
+        });
     }
 }
 
@@ -2,8 +2,7 @@
 #define AUDIO_SERVICE_H
 
 #include <memory>
-#include <deque>
-#include <condition_variable>
+#include <atomic>
 #include <chrono>
 #include <mutex>
 
@@ -22,16 +21,30 @@
 #include "processors/audio_debugger.h"
 #include "wake_word.h"
 #include "protocol.h"
+#include "spsc_ring.h"
+#include "object_pool.h"
+#include "jitter_buffer.h"
+#include "latency_trace.h"
+#include "decoder_cache.h"
+#include "sound_cache.h"
+#include "audio_mixer.h"
+#include "uplink_encoder.h"
+#include "uplink_rate_controller.h"
 
 
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server) -> {Decode Queue} -> [Jitter Buffer] -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
  *
- * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
+ * We use one task for MIC / Speaker / Processors, and separate tasks for the Opus Encoder and the Opus Decoder
+ * (core affinity and priority of the two are set in Kconfig).
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
+ *
+ * Every queue is a preallocated SPSC ring with its own "not empty" / "not full" event bit, so a
+ * push or pop only wakes the task waiting on that queue. Queues that are fed from more than one
+ * task (encode, decode) serialize their producers with a producer-only mutex; consumers never lock.
  * 
  */
 
@@ -42,6 +55,14 @@
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
 #define MAX_TIMESTAMPS_IN_QUEUE 3
+#define AUDIO_TASK_POOL_SIZE (MAX_ENCODE_TASKS_IN_QUEUE + MAX_PLAYBACK_TASKS_IN_QUEUE + 4)
+#define MAX_TESTING_PACKETS_IN_QUEUE (AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS + MAX_ENCODE_TASKS_IN_QUEUE)
+
+// How often the decode task rechecks a jitter buffer that holds packets not yet due
+#define JITTER_BUFFER_POLL_MS 10
+
+#define OPUS_ENCODE_TASK_STACK_SIZE (2048 * 13)
+#define OPUS_DECODE_TASK_STACK_SIZE (2048 * 8)
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
@@ -51,10 +72,21 @@
 #define AS_EVENT_WAKE_WORD_RUNNING          (1 << 1)
 #define AS_EVENT_AUDIO_PROCESSOR_RUNNING    (1 << 2)
 #define AS_EVENT_PLAYBACK_NOT_EMPTY         (1 << 3)
+#define AS_EVENT_PLAYBACK_NOT_FULL          (1 << 4)
+#define AS_EVENT_ENCODE_NOT_EMPTY           (1 << 5)
+#define AS_EVENT_ENCODE_NOT_FULL            (1 << 6)
+#define AS_EVENT_DECODE_NOT_EMPTY           (1 << 7)
+#define AS_EVENT_DECODE_NOT_FULL            (1 << 8)
+#define AS_EVENT_SEND_NOT_FULL              (1 << 9)
+#define AS_EVENT_QUEUE_BITS                 (AS_EVENT_PLAYBACK_NOT_EMPTY | AS_EVENT_PLAYBACK_NOT_FULL | \
+                                             AS_EVENT_ENCODE_NOT_EMPTY | AS_EVENT_ENCODE_NOT_FULL | \
+                                             AS_EVENT_DECODE_NOT_EMPTY | AS_EVENT_DECODE_NOT_FULL | \
+                                             AS_EVENT_SEND_NOT_FULL)
 
 struct AudioServiceCallbacks {
     std::function<void(void)> on_send_queue_available;
     std::function<void(const std::string&)> on_wake_word_detected;
+    std::function<void(void)> on_wake_word_speech;
     std::function<void(bool)> on_vad_change;
     std::function<void(void)> on_audio_testing_queue_full;
 };
@@ -70,6 +102,20 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    LatencyStamps trace;
+
+    // Pooled like AudioStreamPacket, the pcm buffer is kept when the task is released
+    static std::unique_ptr<AudioTask> Create();
+    static void operator delete(AudioTask* task, std::destroying_delete_t);
+};
+
+// Scratch buffers for converting the input of one read. Every task that reads audio input keeps
+// its own across reads, so converting does not allocate and two readers never share a buffer.
+struct AudioInputScratch {
+    std::vector<int16_t> mic;
+    std::vector<int16_t> reference;
+    std::vector<int16_t> resampled_mic;
+    std::vector<int16_t> resampled_reference;
 };
 
 struct DebugStatistics {
@@ -77,6 +123,16 @@ struct DebugStatistics {
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    uint32_t timestamps_dropped = 0;        // Server AEC timestamps that did not fit in the timestamp queue
+    uint32_t pool_heap_allocations = 0;     // Packets / tasks allocated because a pool was empty
+    uint32_t buffer_allocations = 0;        // Payload / PCM buffers that had to grow in the codec path
+    uint64_t interleave_cycles = 0;         // CPU cycles spent in the stereo (de)interleave kernels
+    uint64_t resample_cycles = 0;           // CPU cycles spent resampling input
+    uint32_t convert_count = 0;
+    uint64_t encode_busy_us = 0;            // Time the opus encode task spent encoding
+    uint64_t decode_busy_us = 0;            // Time the opus decode task spent decoding and resampling
+    size_t encode_queue_peak = 0;
+    size_t decode_queue_peak = 0;
 };
 
 class AudioService {
@@ -104,11 +160,21 @@ public:
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
+    // Drops frames beyond the uplink delay budget before returning the oldest remaining one
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    // Reports the result of sending a popped packet to the uplink rate controller
+    void OnPacketSent(bool sent);
+    const UplinkRateController& uplink_rate() const { return uplink_rate_; }
     void PlaySound(const std::string_view& sound);
-    bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
+    // Index (and with PSRAM, pre-decode) UI sounds ahead of their first PlaySound()
+    void PreloadSounds(std::vector<std::string_view>&& sounds);
+    // Named PCM inputs mixed into the output, e.g. "music" (ducked while TTS is playing)
+    MixerSource* GetMixerSource(const std::string& name) { return mixer_->GetSource(name); }
+    AudioMixer& mixer() { return *mixer_; }
+    bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples, AudioInputScratch& scratch);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
+    void PrintDebugStatistics();
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -116,11 +182,20 @@ private:
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
-    std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
-    std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
+    std::unique_ptr<UplinkEncoder> opus_encoder_;
+    UplinkRateController uplink_rate_;
+    std::unique_ptr<DecoderCache> decoder_cache_;
+    std::unique_ptr<SoundCache> sound_cache_;
+    std::unique_ptr<AudioMixer> mixer_;
+    // The resamplers keep filter state between reads, readers on different tasks take turns
+    std::mutex input_resampler_mutex_;
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
-    OpusResampler output_resampler_;
+    std::vector<int16_t> output_resample_buffer_;
+    // Output task frame for mixer sources when no TTS is playing
+    std::vector<int16_t> mix_buffer_;
+    // Capture scratch of AudioInputTask
+    AudioInputScratch input_scratch_;
     DebugStatistics debug_statistics_;
     srmodel_list_t* models_list_ = nullptr;
 
@@ -129,16 +204,22 @@ private:
     // Audio encode / decode
     TaskHandle_t audio_input_task_handle_ = nullptr;
     TaskHandle_t audio_output_task_handle_ = nullptr;
-    TaskHandle_t opus_codec_task_handle_ = nullptr;
-    std::mutex audio_queue_mutex_;
-    std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
-    // For server AEC
-    std::deque<uint32_t> timestamp_queue_;
+    TaskHandle_t opus_encode_task_handle_ = nullptr;
+    TaskHandle_t opus_decode_task_handle_ = nullptr;
+    std::mutex decode_producer_mutex_;
+    std::mutex encode_producer_mutex_;
+    SpscRing<std::unique_ptr<AudioStreamPacket>, MAX_DECODE_PACKETS_IN_QUEUE> audio_decode_queue_;
+    SpscRing<std::unique_ptr<AudioStreamPacket>, MAX_SEND_PACKETS_IN_QUEUE> audio_send_queue_;
+    SpscRing<std::unique_ptr<AudioStreamPacket>, MAX_TESTING_PACKETS_IN_QUEUE> audio_testing_queue_;
+    SpscRing<std::unique_ptr<AudioTask>, MAX_ENCODE_TASKS_IN_QUEUE> audio_encode_queue_;
+    SpscRing<std::unique_ptr<AudioTask>, MAX_PLAYBACK_TASKS_IN_QUEUE> audio_playback_queue_;
+    // For server AEC, produced by the output task and consumed by the encode producers
+    SpscRing<uint32_t, MAX_TIMESTAMPS_IN_QUEUE * 2> timestamp_queue_;
+    // Recorded test audio is played back by the opus decode task once testing stops
+    std::atomic<bool> audio_testing_playback_ = false;
+    // Owned by the opus decode task, reorders sequenced downlink packets before decoding
+    JitterBuffer jitter_buffer_;
+    std::vector<uint8_t> plc_payload_;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
@@ -152,9 +233,12 @@ private:
 
     void AudioInputTask();
     void AudioOutputTask();
-    void OpusCodecTask();
+    void EnableOutput();
+    void OpusEncodeTask();
+    void OpusDecodeTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
+    bool WaitQueueEvent(EventBits_t bits, TickType_t timeout = portMAX_DELAY);
     void CheckAndUpdateAudioPowerState();
 };
 
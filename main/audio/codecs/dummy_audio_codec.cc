@@ -1,5 +1,8 @@
 #include "dummy_audio_codec.h"
 
+#include <algorithm>
+#include <cstring>
+
 DummyAudioCodec::DummyAudioCodec(int input_sample_rate, int output_sample_rate) {
     duplex_ = true;
     input_reference_ = false;
@@ -11,10 +14,28 @@ DummyAudioCodec::DummyAudioCodec(int input_sample_rate, int output_sample_rate)
 DummyAudioCodec::~DummyAudioCodec() {
 }
 
+void DummyAudioCodec::SetInputSource(const int16_t* pcm, size_t samples) {
+    source_ = pcm;
+    source_samples_ = samples;
+    source_position_ = 0;
+}
+
 int DummyAudioCodec::Read(int16_t* dest, int samples) {
-    return 0;
+    if (source_ == nullptr || source_samples_ == 0) {
+        memset(dest, 0, samples * sizeof(int16_t));
+        return samples;
+    }
+    int copied = 0;
+    while (copied < samples) {
+        size_t chunk = std::min<size_t>(samples - copied, source_samples_ - source_position_);
+        memcpy(dest + copied, source_ + source_position_, chunk * sizeof(int16_t));
+        copied += chunk;
+        source_position_ = (source_position_ + chunk) % source_samples_;
+    }
+    return copied;
 }
 
 int DummyAudioCodec::Write(const int16_t* data, int samples) {
-    return 0;
+    samples_written_ += samples;
+    return samples;
 }
@@ -3,14 +3,29 @@
 
 #include "audio_codec.h"
 
+#include <atomic>
+
+/*
+ * Codec without hardware. Reads return silence, or loop over the PCM set with SetInputSource(),
+ * and never block, so the audio pipeline can be driven faster than realtime (see AudioBenchmark).
+ */
 class DummyAudioCodec : public AudioCodec {
 private:
+    const int16_t* source_ = nullptr;
+    size_t source_samples_ = 0;
+    size_t source_position_ = 0;
+    std::atomic<size_t> samples_written_ = 0;
+
     virtual int Read(int16_t* dest, int samples) override;
     virtual int Write(const int16_t* data, int samples) override;
 
 public:
     DummyAudioCodec(int input_sample_rate, int output_sample_rate);
     virtual ~DummyAudioCodec();
+
+    // The buffer must stay valid while the codec reads from it
+    void SetInputSource(const int16_t* pcm, size_t samples);
+    size_t samples_written() const { return samples_written_; }
 };
 
-#endif // _DUMMY_AUDIO_CODEC_H
\ No newline at end of file
+#endif // _DUMMY_AUDIO_CODEC_H
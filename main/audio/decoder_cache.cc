@@ -0,0 +1,101 @@
+#include "decoder_cache.h"
+
+#include <esp_log.h>
+#include <opus.h>
+
+#define TAG "DecoderCache"
+
+DecoderCache::DecoderCache(int output_sample_rate) : output_sample_rate_(output_sample_rate) {
+}
+
+bool DecoderCache::Select(int sample_rate, int frame_duration) {
+    if (active_ != nullptr && active_->sample_rate == sample_rate && active_->frame_duration == frame_duration) {
+        return false;
+    }
+
+    Entry* entry = Find(sample_rate, frame_duration);
+    if (entry == nullptr) {
+        entry = Create(sample_rate, frame_duration);
+    } else {
+        // The cached decoder still holds the state of the stream it played last
+        entry->decoder->ResetState();
+    }
+    if (active_ != nullptr) {
+        statistics_.switches++;
+    }
+    active_ = entry;
+    active_->last_used = ++use_counter_;
+    EnforceMemoryCap();
+    return true;
+}
+
+DecoderCache::Entry* DecoderCache::Find(int sample_rate, int frame_duration) {
+    for (auto& entry : entries_) {
+        if (entry.decoder && entry.sample_rate == sample_rate && entry.frame_duration == frame_duration) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+DecoderCache::Entry* DecoderCache::Create(int sample_rate, int frame_duration) {
+    // Reuse a free slot, or the least recently used one that is not active
+    Entry* slot = nullptr;
+    for (auto& entry : entries_) {
+        if (!entry.decoder) {
+            slot = &entry;
+            break;
+        }
+        if (&entry != active_ && (slot == nullptr || entry.last_used < slot->last_used)) {
+            slot = &entry;
+        }
+    }
+    if (slot->decoder) {
+        Evict(*slot);
+    }
+
+    slot->sample_rate = sample_rate;
+    slot->frame_duration = frame_duration;
+    slot->decoder = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+    if (sample_rate != output_sample_rate_) {
+        ESP_LOGI(TAG, "Resampling audio from %d to %d", sample_rate, output_sample_rate_);
+        slot->resampler = std::make_unique<OpusResampler>();
+        slot->resampler->Configure(sample_rate, output_sample_rate_);
+    }
+    // Computed from the state sizes rather than the change in free heap, which other tasks'
+    // allocations during construction would skew
+    slot->memory = sizeof(OpusDecoderWrapper) + opus_decoder_get_size(1);
+    if (slot->resampler) {
+        slot->memory += sizeof(OpusResampler);
+    }
+    statistics_.memory += slot->memory;
+    statistics_.misses++;
+    ESP_LOGI(TAG, "Created decoder %d Hz / %d ms (%u bytes, cache %u bytes)",
+        sample_rate, frame_duration, slot->memory, statistics_.memory);
+    return slot;
+}
+
+void DecoderCache::Evict(Entry& entry) {
+    ESP_LOGI(TAG, "Evicting decoder %d Hz / %d ms", entry.sample_rate, entry.frame_duration);
+    statistics_.memory -= entry.memory;
+    statistics_.evictions++;
+    entry.decoder.reset();
+    entry.resampler.reset();
+    entry.memory = 0;
+    entry.last_used = 0;
+}
+
+void DecoderCache::EnforceMemoryCap() {
+    while (statistics_.memory > DECODER_CACHE_MEMORY_CAP) {
+        Entry* oldest = nullptr;
+        for (auto& entry : entries_) {
+            if (entry.decoder && &entry != active_ && (oldest == nullptr || entry.last_used < oldest->last_used)) {
+                oldest = &entry;
+            }
+        }
+        if (oldest == nullptr) {
+            break;
+        }
+        Evict(*oldest);
+    }
+}
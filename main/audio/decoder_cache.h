@@ -0,0 +1,63 @@
+#ifndef DECODER_CACHE_H
+#define DECODER_CACHE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <opus_decoder.h>
+#include <opus_resampler.h>
+
+#define DECODER_CACHE_MAX_ENTRIES 4
+// Heap the cached decoders and resamplers may hold, the active one is always kept
+#define DECODER_CACHE_MEMORY_CAP (64 * 1024)
+
+struct DecoderCacheStatistics {
+    uint32_t switches = 0;      // Active decoder changed to another (rate, duration)
+    uint32_t misses = 0;        // A decoder had to be constructed
+    uint32_t evictions = 0;
+    size_t memory = 0;          // Heap held by the cached entries, from the decoder and resampler state sizes
+};
+
+/*
+ * Ready-to-use opus decoders (and the resampler to the codec output rate) keyed by
+ * (sample rate, frame duration), so switching between 16 kHz cues and 24 kHz server
+ * audio does not rebuild a decoder per switch. Least recently used entries are dropped
+ * when the memory cap is exceeded. Only the opus decode task uses it.
+ */
+class DecoderCache {
+public:
+    explicit DecoderCache(int output_sample_rate);
+
+    // Makes the decoder for (sample_rate, frame_duration) active, returns true if it changed
+    bool Select(int sample_rate, int frame_duration);
+
+    OpusDecoderWrapper* decoder() const { return active_ != nullptr ? active_->decoder.get() : nullptr; }
+    // nullptr when the decoder already runs at the output sample rate
+    OpusResampler* resampler() const { return active_ != nullptr ? active_->resampler.get() : nullptr; }
+    const DecoderCacheStatistics& statistics() const { return statistics_; }
+
+private:
+    struct Entry {
+        int sample_rate = 0;
+        int frame_duration = 0;
+        std::unique_ptr<OpusDecoderWrapper> decoder;
+        std::unique_ptr<OpusResampler> resampler;
+        size_t memory = 0;
+        uint32_t last_used = 0;
+    };
+
+    int output_sample_rate_;
+    std::array<Entry, DECODER_CACHE_MAX_ENTRIES> entries_;
+    Entry* active_ = nullptr;
+    uint32_t use_counter_ = 0;
+    DecoderCacheStatistics statistics_;
+
+    Entry* Find(int sample_rate, int frame_duration);
+    Entry* Create(int sample_rate, int frame_duration);
+    void Evict(Entry& entry);
+    void EnforceMemoryCap();
+};
+
+#endif // DECODER_CACHE_H
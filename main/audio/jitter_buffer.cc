@@ -0,0 +1,164 @@
+#include "jitter_buffer.h"
+
+#include <cmath>
+#include <esp_log.h>
+
+#define TAG "JitterBuffer"
+
+bool JitterBuffer::Push(std::unique_ptr<AudioStreamPacket> packet, int64_t now_ms) {
+    uint32_t sequence = packet->sequence;
+    if (packet->frame_duration > 0) {
+        frame_duration_ms_ = packet->frame_duration;
+    }
+
+    if (!started_) {
+        // Before playout starts the earliest sequence seen so far is the first one to play, as long
+        // as everything buffered still fits in the slots behind it. An older packet is late.
+        if (count_ == 0) {
+            next_sequence_ = sequence;
+            last_sequence_ = sequence;
+        } else if (static_cast<int32_t>(sequence - next_sequence_) < 0 &&
+                   last_sequence_ - sequence < JITTER_BUFFER_CAPACITY) {
+            next_sequence_ = sequence;
+        }
+    }
+
+    int32_t offset = static_cast<int32_t>(sequence - next_sequence_);
+    int64_t gap_ms = now_ms - last_arrival_ms_;
+    if (count_ == 0 && gap_ms > JITTER_BUFFER_MAX_DELAY_FRAMES * frame_duration_ms_) {
+        // The buffer drained and nothing came for longer than the largest delay could cover: the
+        // server paused between replies. The sequence carries on while the clock moved, so the gap
+        // is not jitter and the transit baseline starts over.
+        has_transit_ = false;
+    }
+    if (offset < 0 && count_ == 0 && gap_ms > JITTER_BUFFER_CAPACITY * frame_duration_ms_) {
+        // Nothing arrived for a while, this is a new stream (e.g. the audio channel was reopened)
+        Reset();
+        next_sequence_ = sequence;
+        offset = 0;
+    }
+    last_arrival_ms_ = now_ms;
+    if (offset < 0) {
+        statistics_.late++;
+        return false;
+    }
+    if (offset >= JITTER_BUFFER_CAPACITY) {
+        if (offset >= 2 * JITTER_BUFFER_CAPACITY) {
+            // The sender restarted its sequence numbers, start a new stream
+            ESP_LOGW(TAG, "Sequence jump %lu -> %lu, resetting", next_sequence_, sequence);
+        } else {
+            statistics_.lost += count_;
+        }
+        Discard();
+        started_ = false;
+        buffering_ = true;
+        has_transit_ = false;
+        next_sequence_ = sequence;
+    }
+
+    auto& slot = SlotFor(sequence);
+    if (slot.packet) {
+        statistics_.duplicate++;
+        return false;
+    }
+
+    if (count_ == 0 || static_cast<int32_t>(sequence - last_sequence_) > 0) {
+        last_sequence_ = sequence;
+    }
+    UpdateJitter(*packet, now_ms);
+    slot.packet = std::move(packet);
+    slot.arrival_ms = now_ms;
+    count_++;
+    statistics_.received++;
+    return true;
+}
+
+JitterBuffer::PopResult JitterBuffer::Pop(std::unique_ptr<AudioStreamPacket>& packet, int64_t now_ms) {
+    if (count_ == 0) {
+        if (started_ && !buffering_) {
+            statistics_.underruns++;
+            buffering_ = true;
+        }
+        return kPopNone;
+    }
+
+    int target_delay_ms = target_delay_frames_ * frame_duration_ms_;
+    bool waited_long_enough = now_ms - OldestArrival() >= target_delay_ms;
+    if (buffering_) {
+        if ((int)count_ < target_delay_frames_ && !waited_long_enough) {
+            return kPopNone;
+        }
+        buffering_ = false;
+        started_ = true;
+    }
+
+    auto& slot = SlotFor(next_sequence_);
+    if (slot.packet) {
+        packet = std::move(slot.packet);
+        count_--;
+        next_sequence_++;
+        consecutive_lost_ = 0;
+        return kPopPacket;
+    }
+
+    // The next frame is missing but later ones are here: give it until the buffer fills or the delay expires
+    if ((int)count_ < target_delay_frames_ && !waited_long_enough) {
+        return kPopNone;
+    }
+    statistics_.lost++;
+    next_sequence_++;
+    if (++consecutive_lost_ > JITTER_BUFFER_MAX_CONCEAL_FRAMES) {
+        // Long gap, jump straight to the next frame we have instead of synthesizing seconds of PLC
+        while (!SlotFor(next_sequence_).packet) {
+            statistics_.lost++;
+            next_sequence_++;
+        }
+        return Pop(packet, now_ms);
+    }
+    statistics_.concealed++;
+    return kPopLost;
+}
+
+void JitterBuffer::Reset() {
+    Discard();
+    started_ = false;
+    buffering_ = true;
+    consecutive_lost_ = 0;
+    has_transit_ = false;
+}
+
+int64_t JitterBuffer::OldestArrival() const {
+    int64_t oldest = INT64_MAX;
+    for (auto& slot : slots_) {
+        if (slot.packet && slot.arrival_ms < oldest) {
+            oldest = slot.arrival_ms;
+        }
+    }
+    return oldest;
+}
+
+void JitterBuffer::UpdateJitter(const AudioStreamPacket& packet, int64_t now_ms) {
+    // Transit time relative to the media clock implied by the sequence number
+    int64_t transit_ms = now_ms - (int64_t)packet.sequence * frame_duration_ms_;
+    if (has_transit_) {
+        float d = std::fabs((float)(transit_ms - last_transit_ms_));
+        jitter_ms_ += (d - jitter_ms_) / 16.0f;
+    }
+    last_transit_ms_ = transit_ms;
+    has_transit_ = true;
+
+    int target = 1 + (int)std::ceil(2.0f * jitter_ms_ / frame_duration_ms_);
+    if (target < JITTER_BUFFER_MIN_DELAY_FRAMES) {
+        target = JITTER_BUFFER_MIN_DELAY_FRAMES;
+    } else if (target > JITTER_BUFFER_MAX_DELAY_FRAMES) {
+        target = JITTER_BUFFER_MAX_DELAY_FRAMES;
+    }
+    target_delay_frames_ = target;
+}
+
+void JitterBuffer::Discard() {
+    for (auto& slot : slots_) {
+        slot.packet.reset();
+    }
+    count_ = 0;
+}
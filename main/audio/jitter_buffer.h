@@ -0,0 +1,81 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "protocol.h"
+
+#define JITTER_BUFFER_CAPACITY 16
+#define JITTER_BUFFER_MIN_DELAY_FRAMES 1
+#define JITTER_BUFFER_MAX_DELAY_FRAMES 8
+// Longest run of missing frames that is concealed, longer gaps are skipped
+#define JITTER_BUFFER_MAX_CONCEAL_FRAMES 3
+
+struct JitterBufferStatistics {
+    uint32_t received = 0;
+    uint32_t late = 0;          // Arrived after their playout slot
+    uint32_t duplicate = 0;
+    uint32_t lost = 0;          // Never arrived in time
+    uint32_t concealed = 0;     // Lost frames handed to the decoder for concealment
+    uint32_t underruns = 0;
+};
+
+/*
+ * Reorders sequenced downlink packets and releases them with an adaptive delay.
+ *
+ * The delay follows the interarrival jitter (RFC 3550 style estimate), so a clean
+ * network plays with one frame of buffering and a congested one buffers more. A pause
+ * between replies restarts the estimate's baseline instead of counting as jitter. Only
+ * the opus decode task touches the buffer, except size() which may be read anywhere.
+ */
+class JitterBuffer {
+public:
+    enum PopResult {
+        kPopNone,       // Nothing to play yet
+        kPopPacket,     // |packet| holds the next frame
+        kPopLost,       // The next frame is missing, conceal it
+    };
+
+    // Returns false if the packet was dropped as late or duplicate
+    bool Push(std::unique_ptr<AudioStreamPacket> packet, int64_t now_ms);
+    PopResult Pop(std::unique_ptr<AudioStreamPacket>& packet, int64_t now_ms);
+    void Reset();
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ >= JITTER_BUFFER_CAPACITY; }
+    int target_delay_frames() const { return target_delay_frames_; }
+    int jitter_ms() const { return (int)jitter_ms_; }
+    const JitterBufferStatistics& statistics() const { return statistics_; }
+
+private:
+    struct Slot {
+        std::unique_ptr<AudioStreamPacket> packet;
+        int64_t arrival_ms = 0;
+    };
+
+    std::array<Slot, JITTER_BUFFER_CAPACITY> slots_;
+    std::atomic<size_t> count_ = 0;
+    uint32_t next_sequence_ = 0;
+    uint32_t last_sequence_ = 0;    // Highest sequence buffered, all of them lie in [next_sequence_, next_sequence_ + CAPACITY)
+    bool started_ = false;
+    bool buffering_ = true;
+    int consecutive_lost_ = 0;
+    int frame_duration_ms_ = 60;
+    int target_delay_frames_ = JITTER_BUFFER_MIN_DELAY_FRAMES;
+    float jitter_ms_ = 0;
+    int64_t last_transit_ms_ = 0;
+    int64_t last_arrival_ms_ = 0;
+    bool has_transit_ = false;
+    JitterBufferStatistics statistics_;
+
+    Slot& SlotFor(uint32_t sequence) { return slots_[sequence % JITTER_BUFFER_CAPACITY]; }
+    int64_t OldestArrival() const;
+    void UpdateJitter(const AudioStreamPacket& packet, int64_t now_ms);
+    void Discard();
+};
+
+#endif // JITTER_BUFFER_H
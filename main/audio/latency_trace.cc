@@ -0,0 +1,135 @@
+#include "latency_trace.h"
+
+#include <esp_log.h>
+
+#define TAG "LatencyTrace"
+
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+
+static const char* const kLatencyStageNames[kLatencyStageCount] = {
+    "capture", "encode_queue", "encode", "send_queue", "send", "uplink",
+    "receive", "decode_queue", "decode", "playback_queue", "output", "downlink",
+};
+
+static const uint32_t kLatencyBucketLimitsMs[LATENCY_HISTOGRAM_BUCKETS - 1] = {
+    1, 2, 5, 10, 20, 50, 100, 200, 500, 1000,
+};
+
+// Upper bound of the bucket that holds the given percentile, in milliseconds
+static uint32_t Percentile(const LatencyHistogram& histogram, int percent) {
+    uint32_t target = (histogram.count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < LATENCY_HISTOGRAM_BUCKETS - 1; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= target) {
+            return kLatencyBucketLimitsMs[i];
+        }
+    }
+    return histogram.max_us / 1000;
+}
+
+void LatencyTrace::Add(LatencyStage stage, int64_t latency_us) {
+    if (latency_us < 0) {
+        latency_us = 0;
+    }
+    auto& histogram = histograms_[stage];
+    int bucket = 0;
+    while (bucket < LATENCY_HISTOGRAM_BUCKETS - 1 && latency_us > (int64_t)kLatencyBucketLimitsMs[bucket] * 1000) {
+        bucket++;
+    }
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    histogram.total_us += latency_us;
+    if (latency_us > histogram.max_us) {
+        histogram.max_us = latency_us;
+    }
+}
+
+int64_t LatencyTrace::CaptureTime(size_t samples) {
+    processed_samples_ += samples;
+    // Skip the capture blocks that ended before the last sample of this frame
+    while (current_capture_.end_sample < processed_samples_) {
+        if (!captures_.Pop(current_capture_)) {
+            return 0;
+        }
+    }
+    return current_capture_.time_us;
+}
+
+void LatencyTrace::ResetCapture() {
+    captures_.Clear();
+    captured_samples_ = 0;
+    processed_samples_ = 0;
+    current_capture_ = CaptureStamp();
+}
+
+void LatencyTrace::Reset() {
+    for (auto& histogram : histograms_) {
+        histogram = LatencyHistogram();
+    }
+}
+
+void LatencyTrace::Dump() const {
+    for (int i = 0; i < kLatencyStageCount; i++) {
+        auto& histogram = histograms_[i];
+        if (histogram.count == 0) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-14s n=%lu avg=%lu.%01lu ms p50<=%lu ms p95<=%lu ms max=%lu ms", kLatencyStageNames[i],
+            histogram.count, (uint32_t)(histogram.total_us / histogram.count / 1000),
+            (uint32_t)(histogram.total_us / histogram.count % 1000 / 100),
+            Percentile(histogram, 50), Percentile(histogram, 95), histogram.max_us / 1000);
+    }
+}
+
+cJSON* LatencyTrace::ToJson() const {
+    auto root = cJSON_CreateObject();
+    auto limits = cJSON_CreateArray();
+    for (auto limit : kLatencyBucketLimitsMs) {
+        cJSON_AddItemToArray(limits, cJSON_CreateNumber(limit));
+    }
+    cJSON_AddItemToObject(root, "bucket_limits_ms", limits);
+
+    for (int i = 0; i < kLatencyStageCount; i++) {
+        auto& histogram = histograms_[i];
+        auto stage = cJSON_CreateObject();
+        cJSON_AddNumberToObject(stage, "count", histogram.count);
+        if (histogram.count > 0) {
+            cJSON_AddNumberToObject(stage, "avg_ms", (double)histogram.total_us / histogram.count / 1000.0);
+            cJSON_AddNumberToObject(stage, "p50_ms", Percentile(histogram, 50));
+            cJSON_AddNumberToObject(stage, "p95_ms", Percentile(histogram, 95));
+            cJSON_AddNumberToObject(stage, "max_ms", histogram.max_us / 1000.0);
+        }
+        auto buckets = cJSON_CreateArray();
+        for (auto count : histogram.buckets) {
+            cJSON_AddItemToArray(buckets, cJSON_CreateNumber(count));
+        }
+        cJSON_AddItemToObject(stage, "buckets", buckets);
+        cJSON_AddItemToObject(root, kLatencyStageNames[i], stage);
+    }
+    return root;
+}
+
+#else
+
+void LatencyTrace::Add(LatencyStage stage, int64_t latency_us) {
+}
+
+int64_t LatencyTrace::CaptureTime(size_t samples) {
+    return 0;
+}
+
+void LatencyTrace::ResetCapture() {
+}
+
+void LatencyTrace::Reset() {
+}
+
+void LatencyTrace::Dump() const {
+}
+
+cJSON* LatencyTrace::ToJson() const {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <esp_timer.h>
+#include <cJSON.h>
+
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+#include "spsc_ring.h"
+#endif
+
+enum LatencyStage {
+    // Uplink
+    kLatencyStageCapture,           // Microphone sample read -> audio processor output
+    kLatencyStageEncodeQueue,
+    kLatencyStageEncode,
+    kLatencyStageSendQueue,
+    kLatencyStageSend,              // Protocol::SendAudio()
+    kLatencyStageUplink,            // Total: microphone -> handed to the network
+    // Downlink
+    kLatencyStageReceive,           // OnIncomingAudio -> decode queue (time blocked on a full queue)
+    kLatencyStageDecodeQueue,       // Includes the jitter buffer delay
+    kLatencyStageDecode,
+    kLatencyStagePlaybackQueue,
+    kLatencyStageOutput,            // Codec write to I2S
+    kLatencyStageDownlink,          // Total: received from the network -> written to the speaker
+    kLatencyStageCount,
+};
+
+// Carried by every frame so each stage can measure the time since the previous one
+struct LatencyStamps {
+    int64_t start_us = 0;
+    int64_t stage_us = 0;
+};
+
+#define LATENCY_HISTOGRAM_BUCKETS 11
+
+struct LatencyHistogram {
+    uint32_t count = 0;
+    uint32_t max_us = 0;
+    uint64_t total_us = 0;
+    // Bucket upper bounds are kLatencyBucketLimitsMs, the last bucket collects everything slower
+    std::array<uint32_t, LATENCY_HISTOGRAM_BUCKETS> buckets = {};
+};
+
+/*
+ * Per-stage latency histograms of the audio pipeline, enabled with CONFIG_USE_AUDIO_LATENCY_TRACE.
+ *
+ * When the option is off every call below is an empty inline function, so the stamps in the
+ * audio path compile away. Histograms are diagnostic only and are read without locking.
+ */
+class LatencyTrace {
+public:
+    static LatencyTrace& GetInstance() {
+        static LatencyTrace instance;
+        return instance;
+    }
+    LatencyTrace(const LatencyTrace&) = delete;
+    LatencyTrace& operator=(const LatencyTrace&) = delete;
+
+    static constexpr bool enabled() {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Starts tracing a frame that enters the pipeline now (or at |time_us| if given)
+    void Begin(LatencyStamps& stamps, int64_t time_us = 0) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+        stamps.start_us = time_us != 0 ? time_us : esp_timer_get_time();
+        stamps.stage_us = stamps.start_us;
+#endif
+    }
+
+    // Records the time spent in |stage| since the previous stamp of the frame
+    void Stamp(LatencyStage stage, LatencyStamps& stamps) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+        if (stamps.stage_us == 0) {
+            return;
+        }
+        int64_t now = esp_timer_get_time();
+        Add(stage, now - stamps.stage_us);
+        stamps.stage_us = now;
+#endif
+    }
+
+    // Records the time since Begin() as the end-to-end latency of the frame
+    void Finish(LatencyStage stage, const LatencyStamps& stamps) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+        if (stamps.start_us != 0) {
+            Add(stage, stamps.stage_us - stamps.start_us);
+        }
+#endif
+    }
+
+    // The input task reports every captured block, the processor output maps frames back to it
+    void MarkCaptured(size_t samples) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+        captured_samples_ += samples;
+        captures_.Push(CaptureStamp{captured_samples_, esp_timer_get_time()});
+#endif
+    }
+    int64_t CaptureTime(size_t samples);
+    void ResetCapture();
+
+    void Reset();
+    void Dump() const;
+    // Returns nullptr when tracing is disabled
+    cJSON* ToJson() const;
+
+private:
+    LatencyTrace() = default;
+
+    void Add(LatencyStage stage, int64_t latency_us);
+
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    struct CaptureStamp {
+        uint64_t end_sample = 0;
+        int64_t time_us = 0;
+    };
+
+    std::array<LatencyHistogram, kLatencyStageCount> histograms_;
+    SpscRing<CaptureStamp, 16> captures_;
+    uint64_t captured_samples_ = 0;
+    uint64_t processed_samples_ = 0;
+    CaptureStamp current_capture_;
+#endif
+};
+
+#endif // LATENCY_TRACE_H
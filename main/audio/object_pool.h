@@ -0,0 +1,71 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*
+ * Fixed-capacity pool of constructed objects.
+ *
+ * Objects are never destroyed while they live in the pool, so members such as std::vector
+ * keep their capacity between uses and a warmed-up pool does not touch the heap. When the
+ * pool is exhausted Acquire() falls back to the heap and counts it, so misses are visible.
+ */
+template <typename T, size_t Capacity>
+class ObjectPool {
+public:
+    ObjectPool() {
+        for (size_t i = 0; i < Capacity; ++i) {
+            free_list_[i] = &objects_[Capacity - 1 - i];
+        }
+        free_count_ = Capacity;
+    }
+
+    T* Acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            acquired_++;
+            if (free_count_ > 0) {
+                size_t in_use = Capacity - --free_count_;
+                if (in_use > high_water_) {
+                    high_water_ = in_use;
+                }
+                return free_list_[free_count_];
+            }
+            heap_allocations_++;
+        }
+        return new T();
+    }
+
+    // Returns false if the object does not belong to the pool and must be freed by the caller
+    bool Release(T* object) {
+        if (!Owns(object)) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_list_[free_count_++] = object;
+        return true;
+    }
+
+    bool Owns(const T* object) const {
+        return object >= objects_.data() && object < objects_.data() + Capacity;
+    }
+
+    uint32_t acquired() const { return acquired_; }
+    uint32_t heap_allocations() const { return heap_allocations_; }
+    size_t high_water() const { return high_water_; }
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    std::mutex mutex_;
+    std::array<T, Capacity> objects_;
+    std::array<T*, Capacity> free_list_;
+    size_t free_count_ = 0;
+    size_t high_water_ = 0;
+    uint32_t acquired_ = 0;
+    uint32_t heap_allocations_ = 0;
+};
+
+#endif // OBJECT_POOL_H
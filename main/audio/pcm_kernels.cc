@@ -0,0 +1,111 @@
+#include "pcm_kernels.h"
+
+#include <sdkconfig.h>
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#define PCM_KERNELS_USE_PIE 1
+#else
+#define PCM_KERNELS_USE_PIE 0
+#endif
+
+static inline bool IsAligned16(const void* pointer) {
+    return (reinterpret_cast<uintptr_t>(pointer) & 15) == 0;
+}
+
+size_t PcmAlignmentLead(const int16_t* interleaved) {
+    uintptr_t misalignment = reinterpret_cast<uintptr_t>(interleaved) & 15;
+    // A stereo frame is 4 bytes, a buffer that is not 4-byte aligned can never line up
+    if (misalignment % 4 != 0) {
+        return 0;
+    }
+    return ((16 - misalignment) & 15) / 4;
+}
+
+int16_t* AlignPcmScratch(std::vector<int16_t>& buffer, size_t samples, size_t lead) {
+    if (buffer.size() < samples + lead + 8) {
+        buffer.resize(samples + lead + 8);
+    }
+    uintptr_t address = reinterpret_cast<uintptr_t>(buffer.data() + lead);
+    size_t offset = ((16 - (address & 15)) & 15) / sizeof(int16_t);
+    return buffer.data() + offset;
+}
+
+void DeinterleaveStereo(const int16_t* interleaved, int16_t* left, int16_t* right, size_t frames) {
+    size_t i = 0;
+#if PCM_KERNELS_USE_PIE
+    size_t lead = PcmAlignmentLead(interleaved);
+    if (lead < frames) {
+        for (; i < lead; ++i) {
+            left[i] = interleaved[2 * i];
+            right[i] = interleaved[2 * i + 1];
+        }
+        const int16_t* src = interleaved + 2 * i;
+        int16_t* dst_left = left + i;
+        int16_t* dst_right = right + i;
+        if (IsAligned16(src) && IsAligned16(dst_left) && IsAligned16(dst_right)) {
+            size_t blocks = (frames - i) / 8;
+            for (size_t b = 0; b < blocks; ++b) {
+                // q0 = frames 0-3, q1 = frames 4-7; unzip leaves the even (left) lanes in q0 and the odd (right) lanes in q1
+                asm volatile (
+                    "ee.vld.128.ip q0, %0, 16\n"
+                    "ee.vld.128.ip q1, %0, 16\n"
+                    "ee.vunzip.16 q0, q1\n"
+                    "ee.vst.128.ip q0, %1, 16\n"
+                    "ee.vst.128.ip q1, %2, 16\n"
+                    : "+r"(src), "+r"(dst_left), "+r"(dst_right)
+                    :
+                    : "memory");
+            }
+            i += blocks * 8;
+        }
+    }
+#endif
+    for (; i < frames; ++i) {
+        left[i] = interleaved[2 * i];
+        right[i] = interleaved[2 * i + 1];
+    }
+}
+
+void InterleaveStereo(const int16_t* left, const int16_t* right, int16_t* interleaved, size_t frames) {
+    size_t i = 0;
+#if PCM_KERNELS_USE_PIE
+    size_t lead = PcmAlignmentLead(interleaved);
+    if (lead < frames) {
+        for (; i < lead; ++i) {
+            interleaved[2 * i] = left[i];
+            interleaved[2 * i + 1] = right[i];
+        }
+        const int16_t* src_left = left + i;
+        const int16_t* src_right = right + i;
+        int16_t* dst = interleaved + 2 * i;
+        if (IsAligned16(dst) && IsAligned16(src_left) && IsAligned16(src_right)) {
+            size_t blocks = (frames - i) / 8;
+            for (size_t b = 0; b < blocks; ++b) {
+                // zip puts frames 0-3 in q0 and frames 4-7 in q1
+                asm volatile (
+                    "ee.vld.128.ip q0, %1, 16\n"
+                    "ee.vld.128.ip q1, %2, 16\n"
+                    "ee.vzip.16 q0, q1\n"
+                    "ee.vst.128.ip q0, %0, 16\n"
+                    "ee.vst.128.ip q1, %0, 16\n"
+                    : "+r"(dst), "+r"(src_left), "+r"(src_right)
+                    :
+                    : "memory");
+            }
+            i += blocks * 8;
+        }
+    }
+#endif
+    for (; i < frames; ++i) {
+        interleaved[2 * i] = left[i];
+        interleaved[2 * i + 1] = right[i];
+    }
+}
+
+void ExtractLeftChannel(std::vector<int16_t>& data) {
+    size_t frames = data.size() / 2;
+    for (size_t i = 0; i < frames; ++i) {
+        data[i] = data[2 * i];
+    }
+    data.resize(frames);
+}
@@ -0,0 +1,28 @@
+#ifndef PCM_KERNELS_H
+#define PCM_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Stereo PCM helpers used on the capture path.
+ *
+ * On ESP32-S3 the (de)interleave kernels use the PIE SIMD unit for 16-byte aligned blocks of
+ * 8 frames; everything else (other targets, unaligned heads and tails) takes the scalar path.
+ */
+
+// Number of stereo frames before |interleaved| reaches a 16-byte boundary
+size_t PcmAlignmentLead(const int16_t* interleaved);
+
+// Returns a pointer into |buffer| with room for |samples| samples whose element |lead| is 16-byte aligned.
+// |buffer| only grows, so a buffer kept across calls stops allocating after the first frame.
+int16_t* AlignPcmScratch(std::vector<int16_t>& buffer, size_t samples, size_t lead);
+
+void DeinterleaveStereo(const int16_t* interleaved, int16_t* left, int16_t* right, size_t frames);
+void InterleaveStereo(const int16_t* left, const int16_t* right, int16_t* interleaved, size_t frames);
+
+// Keeps the left channel of interleaved stereo data in place and shrinks |data| to mono
+void ExtractLeftChannel(std::vector<int16_t>& data);
+
+#endif // PCM_KERNELS_H
@@ -0,0 +1,216 @@
+#include "sound_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <opus_decoder.h>
+#include <opus_resampler.h>
+
+#define TAG "SoundCache"
+
+#define SOUND_CACHE_FRAME_DURATION_MS 60
+#define SOUND_CACHE_TASK_STACK_SIZE (2048 * 8)
+
+SoundCache::SoundCache(int output_sample_rate) : output_sample_rate_(output_sample_rate) {
+}
+
+SoundCache::~SoundCache() {
+    for (auto& sound : sounds_) {
+        if (sound.pcm != nullptr) {
+            heap_caps_free(sound.pcm);
+        }
+    }
+}
+
+size_t SoundCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sounds_.size();
+}
+
+CachedSound* SoundCache::Find(const char* data) {
+    for (auto& sound : sounds_) {
+        if (sound.data == data) {
+            return &sound;
+        }
+    }
+    return nullptr;
+}
+
+const CachedSound* SoundCache::Get(const std::string_view& ogg) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto sound = Find(ogg.data());
+    if (sound != nullptr) {
+        return sound;
+    }
+
+    // Deque elements never move, so the returned pointer stays valid as the cache grows
+    auto& entry = sounds_.emplace_back();
+    if (!Index(ogg, entry)) {
+        ESP_LOGE(TAG, "Invalid OGG/Opus sound (%u bytes)", ogg.size());
+        sounds_.pop_back();
+        return nullptr;
+    }
+    index_memory_ += sizeof(CachedSound) + entry.packets.capacity() * sizeof(SoundPacketRef);
+    return &entry;
+}
+
+bool SoundCache::Index(const std::string_view& ogg, CachedSound& sound) {
+    const uint8_t* buf = reinterpret_cast<const uint8_t*>(ogg.data());
+    size_t size = ogg.size();
+    size_t offset = 0;
+    sound.data = ogg.data();
+    sound.size = size;
+
+    auto find_page = [&](size_t start)->size_t {
+        for (size_t i = start; i + 4 <= size; ++i) {
+            if (buf[i] == 'O' && buf[i+1] == 'g' && buf[i+2] == 'g' && buf[i+3] == 'S') return i;
+        }
+        return static_cast<size_t>(-1);
+    };
+
+    bool seen_head = false;
+    bool seen_tags = false;
+
+    while (true) {
+        size_t pos = find_page(offset);
+        if (pos == static_cast<size_t>(-1)) break;
+        offset = pos;
+        if (offset + 27 > size) break;
+
+        const uint8_t* page = buf + offset;
+        uint8_t page_segments = page[26];
+        size_t seg_table_off = offset + 27;
+        if (seg_table_off + page_segments > size) break;
+
+        size_t body_size = 0;
+        for (size_t i = 0; i < page_segments; ++i) body_size += page[27 + i];
+
+        size_t body_off = seg_table_off + page_segments;
+        if (body_off + body_size > size) break;
+
+        // Parse packets using lacing
+        size_t cur = body_off;
+        size_t seg_idx = 0;
+        while (seg_idx < page_segments) {
+            size_t pkt_len = 0;
+            size_t pkt_start = cur;
+            bool continued = false;
+            do {
+                uint8_t l = page[27 + seg_idx++];
+                pkt_len += l;
+                cur += l;
+                continued = (l == 255);
+            } while (continued && seg_idx < page_segments);
+
+            if (pkt_len == 0) continue;
+            const uint8_t* pkt_ptr = buf + pkt_start;
+
+            if (!seen_head) {
+                // OpusHead: [0-7] "OpusHead", [8] version, [9] channel_count, [10-11] pre_skip,
+                // [12-15] input_sample_rate (little-endian), [16-17] output_gain, [18] mapping_family
+                if (pkt_len >= 19 && std::memcmp(pkt_ptr, "OpusHead", 8) == 0) {
+                    seen_head = true;
+                    sound.sample_rate = pkt_ptr[12] | (pkt_ptr[13] << 8) | (pkt_ptr[14] << 16) | (pkt_ptr[15] << 24);
+                }
+                continue;
+            }
+            if (!seen_tags) {
+                // Expect OpusTags in second packet
+                if (pkt_len >= 8 && std::memcmp(pkt_ptr, "OpusTags", 8) == 0) {
+                    seen_tags = true;
+                }
+                continue;
+            }
+
+            sound.packets.push_back(SoundPacketRef{(uint32_t)pkt_start, (uint16_t)pkt_len});
+        }
+
+        offset = body_off + body_size;
+    }
+
+    sound.packets.shrink_to_fit();
+    sound.duration_ms = sound.packets.size() * SOUND_CACHE_FRAME_DURATION_MS;
+    return seen_head && !sound.packets.empty();
+}
+
+void SoundCache::Preload(std::vector<std::string_view>&& sounds) {
+    for (auto& ogg : sounds) {
+        Get(ogg);
+    }
+    ESP_LOGI(TAG, "Indexed %u sounds, index memory: %u bytes", size(), index_memory_.load());
+
+#if CONFIG_SPIRAM
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        preload_queue_ = std::move(sounds);
+    }
+    // Decoding takes opus stack and some CPU, keep it off the caller's task
+    xTaskCreate([](void* arg) {
+        auto cache = (SoundCache*)arg;
+        cache->PreloadTask();
+        vTaskDelete(NULL);
+    }, "sound_cache", SOUND_CACHE_TASK_STACK_SIZE, this, 1, nullptr);
+#endif
+}
+
+void SoundCache::PreloadTask() {
+    std::vector<std::string_view> sounds;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sounds.swap(preload_queue_);
+    }
+    for (auto& ogg : sounds) {
+        CachedSound* sound;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sound = Find(ogg.data());
+        }
+        if (sound != nullptr && !sound->pcm_ready && sound->duration_ms <= SOUND_CACHE_PCM_MAX_MS) {
+            Decode(*sound);
+        }
+    }
+    ESP_LOGI(TAG, "Decoded sound memory: %u bytes (PSRAM)", pcm_memory_.load());
+}
+
+void SoundCache::Decode(CachedSound& sound) {
+    size_t capacity = (size_t)sound.duration_ms * output_sample_rate_ / 1000;
+    auto pcm = (int16_t*)heap_caps_malloc(capacity * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (pcm == nullptr) {
+        ESP_LOGW(TAG, "No PSRAM for a %d ms sound", sound.duration_ms);
+        return;
+    }
+
+    OpusDecoderWrapper decoder(sound.sample_rate, 1, SOUND_CACHE_FRAME_DURATION_MS);
+    OpusResampler resampler;
+    if (sound.sample_rate != output_sample_rate_) {
+        resampler.Configure(sound.sample_rate, output_sample_rate_);
+    }
+
+    std::vector<uint8_t> payload;
+    std::vector<int16_t> frame;
+    std::vector<int16_t> resampled;
+    size_t samples = 0;
+    for (auto& ref : sound.packets) {
+        payload.assign(sound.data + ref.offset, sound.data + ref.offset + ref.length);
+        if (!decoder.Decode(std::move(payload), frame)) {
+            continue;
+        }
+        const std::vector<int16_t>* out = &frame;
+        if (sound.sample_rate != output_sample_rate_) {
+            resampled.resize(resampler.GetOutputSamples(frame.size()));
+            resampler.Process(frame.data(), frame.size(), resampled.data());
+            out = &resampled;
+        }
+        size_t count = std::min(out->size(), capacity - samples);
+        memcpy(pcm + samples, out->data(), count * sizeof(int16_t));
+        samples += count;
+    }
+
+    sound.pcm = pcm;
+    sound.pcm_samples = samples;
+    pcm_memory_ += capacity * sizeof(int16_t);
+    sound.pcm_ready = true;
+}
@@ -0,0 +1,67 @@
+#ifndef SOUND_CACHE_H
+#define SOUND_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+// Cues up to this length are also kept decoded, at the codec output rate, in PSRAM
+#define SOUND_CACHE_PCM_MAX_MS 2000
+
+struct SoundPacketRef {
+    uint32_t offset;
+    uint16_t length;
+};
+
+struct CachedSound {
+    const char* data = nullptr;
+    size_t size = 0;
+    int sample_rate = 16000;
+    int duration_ms = 0;
+    std::vector<SoundPacketRef> packets;
+    // Written once by the preload task, valid when pcm_ready is set
+    int16_t* pcm = nullptr;
+    size_t pcm_samples = 0;
+    std::atomic<bool> pcm_ready = false;
+};
+
+/*
+ * Packet index of the embedded OGG/Opus UI sounds, keyed by the address of the sound data.
+ *
+ * Get() parses an OGG file once and afterwards returns its list of opus packets, so PlaySound()
+ * no longer scans pages on every call. Preload() does the same ahead of time for the given
+ * sounds and, when PSRAM is available, decodes the short ones on a background task so they
+ * can be played without any opus work.
+ */
+class SoundCache {
+public:
+    explicit SoundCache(int output_sample_rate);
+    ~SoundCache();
+
+    // Returns nullptr if the data is not a valid OGG/Opus stream
+    const CachedSound* Get(const std::string_view& ogg);
+    void Preload(std::vector<std::string_view>&& sounds);
+
+    size_t index_memory() const { return index_memory_; }
+    size_t pcm_memory() const { return pcm_memory_; }
+    size_t size() const;
+
+private:
+    int output_sample_rate_;
+    mutable std::mutex mutex_;
+    std::deque<CachedSound> sounds_;
+    std::vector<std::string_view> preload_queue_;
+    std::atomic<size_t> index_memory_ = 0;
+    std::atomic<size_t> pcm_memory_ = 0;
+
+    CachedSound* Find(const char* data);
+    static bool Index(const std::string_view& ogg, CachedSound& sound);
+    void Decode(CachedSound& sound);
+    void PreloadTask();
+};
+
+#endif // SOUND_CACHE_H
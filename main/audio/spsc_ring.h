@@ -0,0 +1,109 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/*
+ * Bounded single-producer / single-consumer ring.
+ *
+ * Push() must only be called from one task at a time and Pop() from one task at a time.
+ * Storage is preallocated (rounded up to a power of two so the free-running 32-bit
+ * indices wrap cleanly), nothing is allocated after construction.
+ *
+ * Clear() may be called from any task. It only records the current write position;
+ * the consumer discards everything up to that position on its next Pop() or
+ * ApplyPendingClear(), so items pushed after Clear() are kept.
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+public:
+    static_assert(Capacity > 0, "SpscRing capacity must be positive");
+
+    bool Push(T&& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        if (tail - head >= Capacity) {
+            return false;
+        }
+        slots_[tail & kMask] = std::move(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& item) {
+        ApplyPendingClear();
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        if (head == tail) {
+            return false;
+        }
+        item = std::move(slots_[head & kMask]);
+        slots_[head & kMask] = T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: drop everything queued before the last Clear(). Returns true if a clear was applied.
+    bool ApplyPendingClear() {
+        if (!clear_pending_.exchange(false, std::memory_order_acq_rel)) {
+            return false;
+        }
+        uint32_t until = clear_tail_.load(std::memory_order_acquire);
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        while (static_cast<int32_t>(until - head) > 0) {
+            slots_[head & kMask] = T();
+            head++;
+        }
+        head_.store(head, std::memory_order_release);
+        return true;
+    }
+
+    void Clear() {
+        clear_tail_.store(tail_.load(std::memory_order_acquire), std::memory_order_release);
+        clear_pending_.store(true, std::memory_order_release);
+    }
+
+    size_t size() const {
+        uint32_t head = head_.load(std::memory_order_acquire);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        if (clear_pending_.load(std::memory_order_acquire)) {
+            uint32_t until = clear_tail_.load(std::memory_order_acquire);
+            if (static_cast<int32_t>(until - head) > 0) {
+                head = until;
+            }
+        }
+        return tail - head;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Physical fullness, as seen by the producer (a pending Clear() frees space only once applied)
+    bool full() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire) >= Capacity;
+    }
+
+    static constexpr size_t capacity() { return Capacity; }
+
+private:
+    static constexpr size_t RoundUpPowerOfTwo(size_t n) {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+    static constexpr size_t kSlots = RoundUpPowerOfTwo(Capacity);
+    static constexpr uint32_t kMask = kSlots - 1;
+
+    std::array<T, kSlots> slots_{};
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+    std::atomic<uint32_t> clear_tail_{0};
+    std::atomic<bool> clear_pending_{false};
+};
+
+#endif // SPSC_RING_H
@@ -0,0 +1,62 @@
+#include "uplink_encoder.h"
+
+#include <esp_log.h>
+
+#define TAG "UplinkEncoder"
+// Largest packet opus_encode() may produce, as recommended by the libopus documentation
+#define UPLINK_ENCODER_MAX_PACKET 1276
+
+UplinkEncoder::UplinkEncoder(int sample_rate, int channels, int duration_ms)
+    : channels_(channels), frame_size_(sample_rate * duration_ms / 1000) {
+    int error;
+    encoder_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+    if (encoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio encoder, error code: %d", error);
+        return;
+    }
+    opus_encoder_ctl(encoder_, OPUS_SET_DTX(1));
+}
+
+UplinkEncoder::~UplinkEncoder() {
+    if (encoder_ != nullptr) {
+        opus_encoder_destroy(encoder_);
+    }
+}
+
+void UplinkEncoder::SetComplexity(int complexity) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(complexity));
+    }
+}
+
+void UplinkEncoder::SetBitrate(int bitrate) {
+    if (encoder_ == nullptr) {
+        return;
+    }
+    int ret = opus_encoder_ctl(encoder_, OPUS_SET_BITRATE(bitrate > 0 ? bitrate : OPUS_AUTO));
+    if (ret != OPUS_OK) {
+        ESP_LOGE(TAG, "Failed to set bitrate %d, error code: %d", bitrate, ret);
+        return;
+    }
+    bitrate_ = bitrate;
+}
+
+bool UplinkEncoder::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus, size_t headroom) {
+    if (encoder_ == nullptr) {
+        return false;
+    }
+    if (pcm.size() != (size_t)(frame_size_ * channels_)) {
+        ESP_LOGE(TAG, "Frame of %u samples, expected %d", pcm.size(), frame_size_ * channels_);
+        return false;
+    }
+    // The packet buffer keeps its capacity between frames, resize() only sets the length
+    opus.resize(headroom + UPLINK_ENCODER_MAX_PACKET);
+    int ret = opus_encode(encoder_, pcm.data(), frame_size_, opus.data() + headroom, UPLINK_ENCODER_MAX_PACKET);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to encode audio, error code: %d", ret);
+        opus.clear();
+        return false;
+    }
+    opus.resize(headroom + ret);
+    return true;
+}
@@ -0,0 +1,36 @@
+#ifndef UPLINK_ENCODER_H
+#define UPLINK_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <opus.h>
+
+/*
+ * Opus encoder for the microphone stream. It is configured like OpusEncoderWrapper (VOIP, DTX),
+ * but also exposes the bitrate, which the uplink rate controller lowers when the network falls behind.
+ * Only the opus encode task uses it.
+ */
+class UplinkEncoder {
+public:
+    UplinkEncoder(int sample_rate, int channels, int duration_ms);
+    ~UplinkEncoder();
+
+    void SetComplexity(int complexity);
+    // Bits per second, 0 for the opus default
+    void SetBitrate(int bitrate);
+    int bitrate() const { return bitrate_; }
+
+    // |pcm| must hold exactly one frame. The packet starts |headroom| bytes into |opus|, the bytes
+    // in front of it are left for the transport to write its header into.
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus, size_t headroom = 0);
+
+private:
+    OpusEncoder* encoder_ = nullptr;
+    int channels_;
+    int frame_size_;
+    int bitrate_ = 0;
+};
+
+#endif // UPLINK_ENCODER_H
@@ -0,0 +1,56 @@
+#include "uplink_rate_controller.h"
+
+#include <esp_log.h>
+
+#define TAG "UplinkRate"
+
+// 16 kbps is close to the opus default for 16 kHz mono voice at 60 ms; 6 kbps is the narrowband floor
+static const int kBitrates[] = {16000, 12000, 9000, 6000};
+static const int kLevelCount = sizeof(kBitrates) / sizeof(kBitrates[0]);
+
+UplinkRateController::UplinkRateController() : bitrate_(kBitrates[0]) {
+}
+
+void UplinkRateController::OnSendResult(bool sent, size_t queue_depth, int64_t now_ms) {
+    if (sent) {
+        statistics_.sent++;
+    } else {
+        statistics_.failures++;
+    }
+    if (queue_depth > statistics_.queue_peak) {
+        statistics_.queue_peak = queue_depth;
+    }
+
+    if (!sent || queue_depth >= UPLINK_CONGESTED_FRAMES) {
+        last_congestion_ms_ = now_ms;
+        if (level_ < kLevelCount - 1 && now_ms - last_change_ms_ >= UPLINK_STEP_DOWN_HOLD_MS) {
+            statistics_.step_downs++;
+            SetLevel(level_ + 1, now_ms);
+            ESP_LOGW(TAG, "Uplink congested (queue %u, %s), bitrate %d", queue_depth, sent ? "sent" : "send failed",
+                bitrate_.load());
+        }
+    } else if (level_ > 0 && now_ms - last_congestion_ms_ >= UPLINK_STEP_UP_HOLD_MS &&
+               now_ms - last_change_ms_ >= UPLINK_STEP_UP_HOLD_MS) {
+        statistics_.step_ups++;
+        SetLevel(level_ - 1, now_ms);
+        ESP_LOGI(TAG, "Uplink recovered, bitrate %d", bitrate_.load());
+    }
+}
+
+void UplinkRateController::SetLevel(int level, int64_t now_ms) {
+    level_ = level;
+    last_change_ms_ = now_ms;
+    bitrate_ = kBitrates[level];
+}
+
+cJSON* UplinkRateController::ToJson() const {
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "bitrate", bitrate_);
+    cJSON_AddNumberToObject(json, "sent", statistics_.sent);
+    cJSON_AddNumberToObject(json, "failures", statistics_.failures);
+    cJSON_AddNumberToObject(json, "dropped", statistics_.dropped);
+    cJSON_AddNumberToObject(json, "step_downs", statistics_.step_downs);
+    cJSON_AddNumberToObject(json, "step_ups", statistics_.step_ups);
+    cJSON_AddNumberToObject(json, "queue_peak", statistics_.queue_peak);
+    return json;
+}
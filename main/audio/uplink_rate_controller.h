@@ -0,0 +1,56 @@
+#ifndef UPLINK_RATE_CONTROLLER_H
+#define UPLINK_RATE_CONTROLLER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <cJSON.h>
+
+// Send queue depth that counts as congestion, 240 ms of audio at 60 ms frames
+#define UPLINK_CONGESTED_FRAMES 4
+// Frames older than this budget are dropped from the head of the send queue, 720 ms at 60 ms frames
+#define UPLINK_MAX_DELAY_FRAMES 12
+#define UPLINK_STEP_DOWN_HOLD_MS 1000
+#define UPLINK_STEP_UP_HOLD_MS 5000
+
+struct UplinkRateStatistics {
+    uint32_t sent = 0;
+    uint32_t failures = 0;      // Protocol::SendAudio() returned false
+    uint32_t dropped = 0;       // Stale frames dropped from the send queue
+    uint32_t step_downs = 0;
+    uint32_t step_ups = 0;
+    size_t queue_peak = 0;
+};
+
+/*
+ * Chooses the uplink opus bitrate from the send queue backpressure.
+ *
+ * The main task reports every send attempt with the queue depth left behind it. A deep queue or a
+ * failed send lowers the bitrate one step (at most once per UPLINK_STEP_DOWN_HOLD_MS, so the
+ * previous step can take effect), and UPLINK_STEP_UP_HOLD_MS without congestion raises it again.
+ * The opus encode task reads bitrate() before each frame.
+ */
+class UplinkRateController {
+public:
+    UplinkRateController();
+
+    void OnSendResult(bool sent, size_t queue_depth, int64_t now_ms);
+    void OnFrameDropped() { statistics_.dropped++; }
+
+    int bitrate() const { return bitrate_; }
+    const UplinkRateStatistics& statistics() const { return statistics_; }
+    cJSON* ToJson() const;
+
+private:
+    std::atomic<int> bitrate_;
+    int level_ = 0;
+    // The first congestion may step down right away
+    int64_t last_change_ms_ = -UPLINK_STEP_DOWN_HOLD_MS;
+    int64_t last_congestion_ms_ = 0;
+    UplinkRateStatistics statistics_;
+
+    void SetLevel(int level, int64_t now_ms);
+};
+
+#endif // UPLINK_RATE_CONTROLLER_H
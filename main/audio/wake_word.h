@@ -15,6 +15,8 @@ public:
     virtual bool Initialize(AudioCodec* codec, srmodel_list_t* models_list) = 0;
     virtual void Feed(const std::vector<int16_t>& data) = 0;
     virtual void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) = 0;
+    // Called when speech starts, before any wake word is recognized. Engines without VAD never call it.
+    virtual void OnSpeechStart(std::function<void()> callback) {}
     virtual void Start() = 0;
     virtual void Stop() = 0;
     virtual size_t GetFeedSize() = 0;
@@ -77,6 +77,10 @@ bool AfeWakeWord::Initialize(AudioCodec* codec, srmodel_list_t* models_list) {
     afe_config->afe_perferred_core = 1;
     afe_config->afe_perferred_priority = 1;
     afe_config->memory_alloc_mode = AFE_MEMORY_ALLOC_MORE_PSRAM;
+#if CONFIG_AUDIO_CHANNEL_IDLE_TTL > 0
+    // Speech start lets the application open the audio channel while the wake word is being spoken
+    afe_config->vad_init = true;
+#endif
     
     afe_iface_ = esp_afe_handle_from_config(afe_config);
     afe_data_ = afe_iface_->create_from_config(afe_config);
@@ -94,6 +98,10 @@ void AfeWakeWord::OnWakeWordDetected(std::function<void(const std::string& wake_
     wake_word_detected_callback_ = callback;
 }
 
+void AfeWakeWord::OnSpeechStart(std::function<void()> callback) {
+    speech_start_callback_ = callback;
+}
+
 void AfeWakeWord::Start() {
     xEventGroupSetBits(event_group_, DETECTION_RUNNING_EVENT);
 }
@@ -136,6 +144,14 @@ void AfeWakeWord::AudioDetectionTask() {
         // Store the wake word data for voice recognition, like who is speaking
         StoreWakeWordData(res->data, res->data_size / sizeof(int16_t));
 
+        if (speech_start_callback_) {
+            bool speaking = res->vad_state == VAD_SPEECH;
+            if (speaking && !is_speaking_) {
+                speech_start_callback_();
+            }
+            is_speaking_ = speaking;
+        }
+
         if (res->wakeup_state == WAKENET_DETECTED) {
             Stop();
             last_detected_wake_word_ = wake_words_[res->wakenet_model_index - 1];
@@ -21,6 +21,7 @@ namespace audio_wifi_config
         const int kInputSampleRate = 16000;                                    // Input sampling rate
         const float kDownsampleStep = static_cast<float>(kInputSampleRate) / static_cast<float>(kAudioSampleRate); // Downsampling step
         std::vector<int16_t> audio_data;
+        AudioInputScratch scratch;
         AudioSignalProcessor signal_processor(kAudioSampleRate, kMarkFrequency, kSpaceFrequency, kBitRate, kWindowSize);
         AudioDataBuffer data_buffer;
 
@@ -33,7 +34,7 @@ namespace audio_wifi_config
                 continue;
             }
             
-            if (!app->GetAudioService().ReadAudioData(audio_data, 16000, 480)) { // 16kHz, 480 samples corresponds to 30ms data
+            if (!app->GetAudioService().ReadAudioData(audio_data, 16000, 480, scratch)) { // 16kHz, 480 samples corresponds to 30ms data
                 // 读取音频失败，短暂延迟后重试
                 ESP_LOGI(kLogTag, "Failed to read audio data, retrying.");
                 vTaskDelay(pdMS_TO_TICKS(10));
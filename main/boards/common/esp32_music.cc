@@ -45,14 +45,7 @@ Esp32Music::~Esp32Music() {
     Stop();  // Renamed from StopStreaming
     
     // Wait for tasks to finish
-    if (download_task_handle_ != nullptr) {
-        vTaskDelete(download_task_handle_);
-        download_task_handle_ = nullptr;
-    }
-    if (play_task_handle_ != nullptr) {
-        vTaskDelete(play_task_handle_);
-        play_task_handle_ = nullptr;
-    }
+    DeleteTasks();
     
     // Cleanup
     ClearAudioBuffer();
@@ -75,6 +68,26 @@ void Esp32Music::ClearAudioBuffer() {
     buffer_size_ = 0;
 }
 
+size_t Esp32Music::GetBufferSize() const {
+    std::lock_guard<std::mutex> lock(buffer_mutex_);
+    return buffer_size_;
+}
+
+// Deletes the streaming tasks that have not ended by themselves
+void Esp32Music::DeleteTasks() {
+    std::lock_guard<std::mutex> lock(task_mutex_);
+    if (download_task_handle_ != nullptr) {
+        vTaskDelete(download_task_handle_);
+        download_task_handle_ = nullptr;
+        ESP_LOGI(TAG, "Download task deleted");
+    }
+    if (play_task_handle_ != nullptr) {
+        vTaskDelete(play_task_handle_);
+        play_task_handle_ = nullptr;
+        ESP_LOGI(TAG, "Play task deleted");
+    }
+}
+
 void Esp32Music::MonitorPsramUsage() {
     size_t free_psram = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
     size_t free_sram = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
@@ -227,35 +240,17 @@ bool Esp32Music::StartStreaming(const std::string& music_url) {
         return false;
     }
     
+    std::lock_guard<std::mutex> control_lock(control_mutex_);
+
     // Reset stopping flag
     is_stopping_.store(false, std::memory_order_release);
     
-    // Stop any existing playback
+    // Stop any existing playback, this also deletes the tasks still running
     if (is_playing_ || is_downloading_) {
         ESP_LOGI(TAG, "🛑 Stopping existing playback before starting new stream");
-        Stop();  // Renamed from StopStreaming
-        
-        // Wait for tasks to fully terminate (up to 1 second)
-        int wait_count = 0;
-        while ((download_task_handle_ != nullptr || play_task_handle_ != nullptr) && wait_count < 20) {
-            vTaskDelay(pdMS_TO_TICKS(50));
-            wait_count++;
-        }
-        
-        if (download_task_handle_ != nullptr || play_task_handle_ != nullptr) {
-            ESP_LOGW(TAG, "⚠️ Tasks did not terminate cleanly, forcing cleanup");
-            if (download_task_handle_ != nullptr) {
-                vTaskDelete(download_task_handle_);
-                download_task_handle_ = nullptr;
-            }
-            if (play_task_handle_ != nullptr) {
-                vTaskDelete(play_task_handle_);
-                play_task_handle_ = nullptr;
-            }
-        } else {
-            ESP_LOGI(TAG, "✅ Previous playback stopped cleanly");
-        }
+        StopLocked();
     }
+    DeleteTasks();
     
     // Clear buffers and decoders
     ESP_LOGI(TAG, "🧹 Clearing buffers and reinitializing decoder");
@@ -290,12 +285,17 @@ bool Esp32Music::StartStreaming(const std::string& music_url) {
     is_playing_ = true;
     
     ESP_LOGI(TAG, "🚀 Creating streaming tasks...");
+    std::lock_guard<std::mutex> task_lock(task_mutex_);
     
     // Create download task with 8KB stack (priority 5)
     xTaskCreatePinnedToCore(
         [](void* param) {
             auto* self = static_cast<Esp32Music*>(param);
             self->DownloadAudioStream(self->current_music_url_);
+            {
+                std::lock_guard<std::mutex> lock(self->task_mutex_);
+                self->download_task_handle_ = nullptr;
+            }
             vTaskDelete(nullptr);
         },
         "MusicDownload",
@@ -311,6 +311,10 @@ bool Esp32Music::StartStreaming(const std::string& music_url) {
         [](void* param) {
             auto* self = static_cast<Esp32Music*>(param);
             self->PlayAudioStream();
+            {
+                std::lock_guard<std::mutex> lock(self->task_mutex_);
+                self->play_task_handle_ = nullptr;
+            }
             vTaskDelete(nullptr);
         },
         "MusicPlayback",
@@ -479,6 +483,14 @@ void Esp32Music::PlayAudioStream() {
         codec->EnableOutput(true);
     }
     
+    // Music goes through the audio service mixer, which resamples it and ducks it under TTS
+    auto music = Application::GetInstance().GetAudioService().GetMixerSource("music");
+    if (!music) {
+        ESP_LOGE(TAG, "Music mixer source not available");
+        is_playing_ = false;
+        return;
+    }
+    
     // Wait for minimum buffer before starting
     {
         std::unique_lock<std::mutex> lock(buffer_mutex_);
@@ -618,10 +630,11 @@ void Esp32Music::PlayAudioStream() {
                 continue;
             }
             
-            // Play PCM data through codec
+            // Hand PCM data to the mixer, blocks while its buffer is full
             int sample_count = mp3_frame_info_.outputSamps;
-            std::vector<int16_t> pcm_data(pcm_buffer, pcm_buffer + sample_count);
-            codec->OutputData(pcm_data);
+            if (!music->Write(pcm_buffer, sample_count, mp3_frame_info_.samprate, mp3_frame_info_.nChans)) {
+                ESP_LOGW(TAG, "Mixer did not take the frame in time");
+            }
             
             total_played += sample_count * sizeof(int16_t);
             
@@ -643,6 +656,9 @@ void Esp32Music::PlayAudioStream() {
         }
     }
     
+    // Let the mixer play the last partial frame of the song
+    music->EndOfStream();
+    
     // Cleanup
     if (mp3_input_buffer) {
         heap_caps_free(mp3_input_buffer);
@@ -660,6 +676,11 @@ void Esp32Music::PlayAudioStream() {
 // ========== Stop Streaming ==========
 
 bool Esp32Music::Stop() {
+    std::lock_guard<std::mutex> lock(control_mutex_);
+    return StopLocked();
+}
+
+bool Esp32Music::StopLocked() {
     ESP_LOGI(TAG, "Stopping streaming");
     
     // Prevent rapid stop spam
@@ -691,17 +712,12 @@ bool Esp32Music::Stop() {
     
     // Wait for tasks to finish (simple approach)
     vTaskDelay(pdMS_TO_TICKS(100));  // Give tasks time to exit
+    DeleteTasks();
     
-    if (download_task_handle_ != nullptr) {
-        vTaskDelete(download_task_handle_);
-        download_task_handle_ = nullptr;
-        ESP_LOGI(TAG, "Download task deleted");
-    }
-    
-    if (play_task_handle_ != nullptr) {
-        vTaskDelete(play_task_handle_);
-        play_task_handle_ = nullptr;
-        ESP_LOGI(TAG, "Play task deleted");
+    // Drop the music still buffered in the mixer
+    auto music = Application::GetInstance().GetAudioService().GetMixerSource("music");
+    if (music) {
+        music->Flush();
     }
     
     // Cleanup resources
@@ -61,13 +61,18 @@ private:
     std::atomic<bool> is_stopping_;  // Guard to prevent spam Stop() calls
     TaskHandle_t play_task_handle_;
     TaskHandle_t download_task_handle_;
+    // StartStreaming() and Stop() come from MCP tool workers and the main loop at the same time,
+    // control_mutex_ runs them one after the other. task_mutex_ guards the two task handles,
+    // which the tasks clear themselves when they end.
+    std::mutex control_mutex_;
+    std::mutex task_mutex_;
     int64_t current_play_time_ms_;  // 当前播放时间(毫秒)
     int64_t last_frame_time_ms_;    // 上一帧的时间戳
     int total_frames_decoded_;      // 已解码的帧数
 
     // 音频缓冲区
     std::queue<AudioChunk> audio_buffer_;
-    std::mutex buffer_mutex_;
+    mutable std::mutex buffer_mutex_;
     std::condition_variable buffer_cv_;
     size_t buffer_size_;
     // Optimized for ESP32-S3 Otto - balance memory and performance
@@ -89,6 +94,8 @@ private:
     void DownloadAudioStream(const std::string& music_url);
     void PlayAudioStream();
     void ClearAudioBuffer();
+    bool StopLocked();
+    void DeleteTasks();
     bool InitializeMp3Decoder();
     void CleanupMp3Decoder();
     void ResetSampleRate();  // 重置采样率到原始值
@@ -118,7 +125,7 @@ public:
     // 新增方法
     virtual bool StartStreaming(const std::string& music_url) override;
     virtual bool Stop() override;  // 停止流式播放 (renamed from StopStreaming)
-    virtual size_t GetBufferSize() const override { return buffer_size_; }
+    virtual size_t GetBufferSize() const override;
     virtual bool IsDownloading() const override { return is_downloading_; }
     virtual bool IsPlaying() const override { return is_playing_.load(); }
     virtual int16_t* GetAudioData() override { return final_pcm_data_fft; }
@@ -14,9 +14,14 @@
 #include "config.h"
 #include "mcp_server.h"
 #include "otto_movements.h"
+#include "otto_motion.h"
 #include "sdkconfig.h"
 #include "settings.h"
 
+#if CONFIG_USE_OTTO_MOTION_BENCHMARK
+#include "otto_motion_benchmark.h"
+#endif
+
 // Forward declarations for web server control
 extern "C" {
     esp_err_t otto_start_webserver(void);
@@ -29,6 +34,7 @@ extern "C" {
 class OttoController {
 private:
     Otto otto_;
+    OttoMotion motion_{otto_};
     TaskHandle_t action_task_handle_ = nullptr;
     QueueHandle_t action_queue_;
     bool is_action_in_progress_ = false;
@@ -123,26 +129,25 @@ private:
                 }
                 controller->idle_mode_ = false;
 
+                // The blocking movements below must not share the servos with a running track
+                controller->motion_.Stop();
+
                 switch (params.action_type) {
                     // Dog-style movement actions
                     case ACTION_DOG_WALK:
-                        controller->otto_.DogWalk(params.steps, params.speed);
-                        controller->otto_.WagTail(3, 100); // Wag tail after walk
+                        controller->PlayMotion(MotionTrack::Walk(params.steps, params.speed, FORWARD), 3, 100);
                         break;
                     case ACTION_DOG_WALK_BACK:
                         ESP_LOGI(TAG, "🐕 DogWalkBack: steps=%d, speed=%d", params.steps, params.speed);
-                        controller->otto_.DogWalkBack(params.steps, params.speed);
-                        controller->otto_.WagTail(3, 100); // Wag tail after walk back
+                        controller->PlayMotion(MotionTrack::Walk(params.steps, params.speed, BACKWARD), 3, 100);
                         break;
                     case ACTION_DOG_TURN_LEFT:
                         ESP_LOGI(TAG, "🐕 DogTurnLeft: steps=%d, speed=%d", params.steps, params.speed);
-                        controller->otto_.DogTurnLeft(params.steps, params.speed);
-                        controller->otto_.WagTail(3, 100); // Wag tail after turn
+                        controller->PlayMotion(MotionTrack::Turn(params.steps, params.speed, LEFT), 3, 100);
                         break;
                     case ACTION_DOG_TURN_RIGHT:
                         ESP_LOGI(TAG, "🐕 DogTurnRight: steps=%d, speed=%d", params.steps, params.speed);
-                        controller->otto_.DogTurnRight(params.steps, params.speed);
-                        controller->otto_.WagTail(3, 100); // Wag tail after turn
+                        controller->PlayMotion(MotionTrack::Turn(params.steps, params.speed, RIGHT), 3, 100);
                         break;
                     case ACTION_DOG_SIT_DOWN:
                         ESP_LOGI(TAG, "🐕 DogSitDown: speed=%d", params.speed);
@@ -181,8 +186,7 @@ private:
                         controller->otto_.WagTail(3, 100); // Wag tail after bow
                         break;
                     case ACTION_DOG_DANCE:
-                        controller->otto_.DogDance(params.steps, params.speed);
-                        controller->otto_.WagTail(5, 80); // More energetic tail wag after dance
+                        controller->PlayMotion(MotionTrack::Dance(params.steps), 5, 80); // More energetic tail wag after dance
                         break;
                     case ACTION_DOG_WAVE_RIGHT_FOOT:
                         controller->otto_.DogWaveRightFoot(params.steps, params.speed);
@@ -214,7 +218,7 @@ private:
                         break;
                     case ACTION_DOG_WAG_TAIL:
                         ESP_LOGI(TAG, "🐕 WagTail: wags=%d, speed=%d", params.steps, params.speed);
-                        controller->otto_.WagTail(params.steps, params.speed);
+                        controller->PlayMotion(MotionTrack(), params.steps, params.speed);
                         break;
                     
                     case ACTION_DOG_ROLL_OVER:
@@ -269,8 +273,12 @@ private:
                         break;
                     
                     case ACTION_DOG_BALANCE:
-                        ESP_LOGI(TAG, "⚖️ DogBalance: duration=%d ms, speed=%d", params.steps, params.speed);
-                        controller->otto_.DogBalance(params.steps, params.speed);
+                        {
+                            ESP_LOGI(TAG, "⚖️ DogBalance: duration=%d ms, speed=%d", params.steps, params.speed);
+                            auto display = Board::GetInstance().GetDisplay();
+                            if (display) display->SetEmotion("neutral");
+                            controller->PlayMotion(MotionTrack::Balance(params.steps, params.speed));
+                        }
                         break;
                     case ACTION_DOG_TOILET:
                         ESP_LOGI(TAG, "🚽 DogToilet: hold=%d ms, speed=%d", params.steps, params.speed);
@@ -279,12 +287,11 @@ private:
                         
                     // Legacy actions (adapted for 4 servos)
                     case ACTION_WALK:
-                        controller->otto_.Walk(params.steps, params.speed, params.direction);
-                        controller->otto_.WagTail(3, 100); // Wag tail after walk
+                        // Legacy period is four servo moves
+                        controller->PlayMotion(MotionTrack::Walk(params.steps, params.speed / 4, params.direction), 3, 100);
                         break;
                     case ACTION_TURN:
-                        controller->otto_.Turn(params.steps, params.speed, params.direction);
-                        controller->otto_.WagTail(3, 100); // Wag tail after turn
+                        controller->PlayMotion(MotionTrack::Turn(params.steps, params.speed / 4, params.direction), 3, 100);
                         break;
                     case ACTION_JUMP:
                         {
@@ -302,7 +309,7 @@ private:
                         break;
                     case ACTION_HOME:
                         ESP_LOGI(TAG, "🏠 Going Home");
-                        controller->otto_.Home();
+                        controller->PlayMotion(MotionTrack::Stand());
                         break;
                     case ACTION_DELAY:
                         ESP_LOGI(TAG, "⏱️ Delay: %d ms", params.speed);
@@ -365,6 +372,27 @@ private:
         }
     }
 
+    // Starts |track| on the motion engine, followed by a tail wag if |wags| > 0
+    void PlayMotionAsync(MotionTrack&& track, int wags = 0, int wag_speed = 100) {
+        if (wags > 0) {
+            if (otto_.HasServo(SERVO_TAIL)) {
+                track.Append(MotionTrack::WagTail(wags, wag_speed));
+            } else if (track.frames.empty()) {
+                ESP_LOGW(TAG, "Tail servo not connected, skipping wag tail");
+            }
+        }
+        motion_.Play(std::move(track));
+    }
+
+    // For the action task: returns when the track is done or another action is queued, which then
+    // takes over on the next tick
+    void PlayMotion(MotionTrack&& track, int wags = 0, int wag_speed = 100) {
+        PlayMotionAsync(std::move(track), wags, wag_speed);
+        while (motion_.IsPlaying() && uxQueueMessagesWaiting(action_queue_) == 0) {
+            vTaskDelay(pdMS_TO_TICKS(MOTION_TICK_MS));
+        }
+    }
+
     void StartActionTaskIfNeeded() {
         if (action_task_handle_ == nullptr) {
             ESP_LOGI(TAG, "🚀 Creating ActionTask...");
@@ -477,10 +505,8 @@ public:
                                int steps = properties["steps"].value<int>();
                                int speed = properties["speed"].value<int>();
                                ESP_LOGI(TAG, "⚡ IMMEDIATE ACTION: Walking forward %d steps at speed %dms", steps, speed);
-                               // FAST RESPONSE: Execute immediately like esp-hi, no queue delay
-                               otto_.DogWalk(steps, speed);
-                               otto_.WagTail(3, 100); // Happy tail wag!
-                               ESP_LOGI(TAG, "✅ Walk forward completed with tail wag");
+                               // FAST RESPONSE: Runs on the motion engine, the reply does not wait for the walk
+                               PlayMotionAsync(MotionTrack::Walk(steps, speed, FORWARD), 3, 100);
                                return true;
                            });
 
@@ -499,11 +525,9 @@ public:
                                    ESP_LOGI(TAG, "🐕 MCP walk_backward called: steps=%d, speed=%d", steps, speed);
                                    
                                    // Execute movement
-                                   otto_.DogWalkBack(steps, speed);
-                                   otto_.WagTail(3, 100);
-                                   
-                                   ESP_LOGI(TAG, "✅ Walk backward completed successfully");
-                                   return "Walked backward " + std::to_string(steps) + " steps at " + std::to_string(speed) + "ms speed";
+                                   PlayMotionAsync(MotionTrack::Walk(steps, speed, BACKWARD), 3, 100);
+
+                                   return "Walking backward " + std::to_string(steps) + " steps at " + std::to_string(speed) + "ms speed";
                                } catch (const std::exception& e) {
                                    ESP_LOGE(TAG, "❌ Walk backward failed: %s", e.what());
                                    throw;
@@ -522,10 +546,8 @@ public:
                                int steps = properties["steps"].value<int>();
                                int speed = properties["speed"].value<int>();
                                ESP_LOGI(TAG, "⚡ IMMEDIATE ACTION: Turning left %d steps at speed %dms", steps, speed);
-                               // FAST RESPONSE: Execute immediately like esp-hi
-                               otto_.DogTurnLeft(steps, speed);
-                               otto_.WagTail(3, 100); // Happy tail wag!
-                               ESP_LOGI(TAG, "✅ Turn left completed with tail wag");
+                               // FAST RESPONSE: Runs on the motion engine
+                               PlayMotionAsync(MotionTrack::Turn(steps, speed, LEFT), 3, 100);
                                return true;
                            });
 
@@ -541,10 +563,8 @@ public:
                                int steps = properties["steps"].value<int>();
                                int speed = properties["speed"].value<int>();
                                ESP_LOGI(TAG, "⚡ IMMEDIATE ACTION: Turning right %d steps at speed %dms", steps, speed);
-                               // FAST RESPONSE: Execute immediately like esp-hi
-                               otto_.DogTurnRight(steps, speed);
-                               otto_.WagTail(3, 100); // Happy tail wag!
-                               ESP_LOGI(TAG, "✅ Turn right completed with tail wag");
+                               // FAST RESPONSE: Runs on the motion engine
+                               PlayMotionAsync(MotionTrack::Turn(steps, speed, RIGHT), 3, 100);
                                return true;
                            });
 
@@ -620,8 +640,8 @@ public:
                                if (auto display = Board::GetInstance().GetDisplay()) {
                                    display->SetEmotion("happy");
                                }
-                               // FAST RESPONSE: Execute immediately like esp-hi
-                               otto_.DogDance(cycles, speed);
+                               // FAST RESPONSE: Runs on the motion engine
+                               PlayMotionAsync(MotionTrack::Dance(cycles));
                                return true;
                            });
 
@@ -926,8 +946,8 @@ public:
                                xQueueReset(action_queue_);
 
                                ESP_LOGI(TAG, "🐾 Kiki stopped! 🛑");
-                               // FAST RESPONSE: Execute immediately like esp-hi
-                               otto_.Home();
+                               // FAST RESPONSE: Stand up from wherever the current track left the legs
+                               motion_.Play(MotionTrack::Stand());
                                return true;
                            });
 
@@ -1027,6 +1047,22 @@ public:
                            });
         */
 
+#if CONFIG_USE_OTTO_MOTION_BENCHMARK
+        // User only, so it does not count against the tool limit. Moves the robot for a few seconds,
+        // so it runs on an MCP worker
+        auto benchmark = new McpTool("self.dog.motion_benchmark",
+                           "Walk with the blocking movement code and with the motion engine, and compare their timing",
+                           PropertyList({Property("steps", kPropertyTypeInteger, 2, 1, 10),
+                                         Property("speed", kPropertyTypeInteger, 150, 50, 500)}),
+                           [this](const PropertyList& properties) -> ReturnValue {
+                               return OttoMotionBenchmark::Run(otto_, motion_, properties["steps"].value<int>(),
+                                                               properties["speed"].value<int>());
+                           });
+        benchmark->set_user_only(true);
+        benchmark->set_blocking(1);
+        mcp_server.AddTool(benchmark);
+#endif
+
         ESP_LOGI(TAG, "🐾 Dog Robot MCP tools registered (trimmed for 32-tool limit)! 🐶");
     }
 
@@ -1048,8 +1084,8 @@ public:
         // Set flag to stop current action
         is_action_in_progress_ = false;
         
-        // Go to home position immediately
-        otto_.Home();
+        // Go to home position, taking over from any running track
+        motion_.Play(MotionTrack::Stand());
         
         ESP_LOGI(TAG, "✅ Robot stopped and at home position");
     }
@@ -0,0 +1,277 @@
+#include "otto_motion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "esp_log.h"
+
+static const char* TAG = "OttoMotion";
+
+///////////////////////////////////////////////////////////////////
+//-- MOTION TRACKS ----------------------------------------------//
+///////////////////////////////////////////////////////////////////
+MotionTrack& MotionTrack::Pose(int lf, int rf, int lb, int rb, int duration_ms, int tail) {
+    MotionKeyframe frame;
+    frame.angles[SERVO_LF] = lf;
+    frame.angles[SERVO_RF] = rf;
+    frame.angles[SERVO_LB] = lb;
+    frame.angles[SERVO_RB] = rb;
+    frame.angles[SERVO_TAIL] = tail;
+    frame.duration_ms = 0;
+    frames.push_back(frame);
+    return Pause(duration_ms);
+}
+
+MotionTrack& MotionTrack::Move(int servo_id, int angle, int duration_ms) {
+    return Move(servo_id, angle, servo_id, angle, duration_ms);
+}
+
+MotionTrack& MotionTrack::Move(int servo_a, int angle_a, int servo_b, int angle_b, int duration_ms) {
+    MotionKeyframe frame;
+    std::fill(std::begin(frame.angles), std::end(frame.angles), MOTION_HOLD);
+    frame.angles[servo_a] = angle_a;
+    frame.angles[servo_b] = angle_b;
+    frame.duration_ms = 0;
+    frames.push_back(frame);
+    return Pause(duration_ms);
+}
+
+MotionTrack& MotionTrack::Pause(int duration_ms) {
+    while (duration_ms > 0) {
+        MotionKeyframe frame;
+        std::fill(std::begin(frame.angles), std::end(frame.angles), MOTION_HOLD);
+        frame.duration_ms = std::min(duration_ms, (int)UINT16_MAX);
+        frames.push_back(frame);
+        duration_ms -= frame.duration_ms;
+    }
+    return *this;
+}
+
+MotionTrack& MotionTrack::Append(const MotionTrack& track) {
+    frames.insert(frames.end(), track.frames.begin(), track.frames.end());
+    return *this;
+}
+
+uint32_t MotionTrack::duration_ms() const {
+    uint32_t duration = 0;
+    for (auto& frame : frames) {
+        duration += frame.duration_ms;
+    }
+    return duration;
+}
+
+//-- Stand: the StandUp() jump of all legs to 90°, then its wait
+MotionTrack MotionTrack::Stand(int duration_ms) {
+    MotionTrack track;
+    track.Pose(90, 90, 90, 90, duration_ms);
+    return track;
+}
+
+//-- Walk: the DogWalk / DogWalkBack diagonal sequence, each pair moving together
+MotionTrack MotionTrack::Walk(int steps, int speed_delay, int dir) {
+    int lift = dir == FORWARD ? 35 : 145;
+    int push = dir == FORWARD ? 145 : 35;
+    MotionTrack track = Stand();
+    track.Pause(120);
+    for (int i = 0; i < steps; i++) {
+        track.Move(SERVO_LF, lift, SERVO_RB, lift, speed_delay)
+            .Move(SERVO_RF, push, SERVO_LB, push, speed_delay)
+            .Move(SERVO_LF, 90, SERVO_RB, 90, speed_delay)
+            .Move(SERVO_RF, 90, SERVO_LB, 90, speed_delay)
+            .Move(SERVO_RF, lift, SERVO_LB, lift, speed_delay)
+            .Move(SERVO_LF, push, SERVO_RB, push, speed_delay)
+            .Move(SERVO_RF, 90, SERVO_LB, 90, speed_delay)
+            .Move(SERVO_LF, 90, SERVO_RB, 90, speed_delay);
+    }
+    return track;
+}
+
+//-- Turn: the DogTurnLeft / DogTurnRight sequence
+MotionTrack MotionTrack::Turn(int steps, int speed_delay, int dir) {
+    int first_a = dir == LEFT ? SERVO_RF : SERVO_LF;
+    int first_b = dir == LEFT ? SERVO_LB : SERVO_RB;
+    int second_a = dir == LEFT ? SERVO_LF : SERVO_RF;
+    int second_b = dir == LEFT ? SERVO_RB : SERVO_LB;
+    MotionTrack track = Stand();
+    track.Pause(500);
+    for (int i = 0; i < steps; i++) {
+        track.Move(first_a, 45, first_b, 135, speed_delay)
+            .Move(second_a, 45, second_b, 135, speed_delay)
+            .Move(first_a, 90, first_b, 90, speed_delay)
+            .Move(second_a, 90, second_b, 90, speed_delay);
+    }
+    return track;
+}
+
+//-- Dance: the DogDance lean left, lean right, crouch and hop
+MotionTrack MotionTrack::Dance(int cycles) {
+    MotionTrack track;
+    for (int i = 0; i < cycles; i++) {
+        track.Pose(60, 120, 60, 120, 200)
+            .Pose(120, 60, 120, 60, 200)
+            .Pose(75, 75, 105, 105, 150)
+            .Pause(100)
+            .Pose(105, 105, 75, 75, 150);
+    }
+    return track.Append(Stand());
+}
+
+//-- Balance: the DogBalance rise onto the hind legs, hold and come back down
+MotionTrack MotionTrack::Balance(int duration_ms, int speed_delay) {
+    MotionTrack track;
+    track.Pose(70, 70, 60, 60, speed_delay * 2).Pause(500)
+        .Pose(100, 100, 50, 50, speed_delay * 2).Pause(300)
+        .Pose(120, 120, 45, 45, speed_delay * 2).Pause(300)
+        .Pose(140, 140, 40, 40, speed_delay * 2).Pause(duration_ms)
+        .Pose(110, 110, 50, 50, speed_delay * 2).Pause(300)
+        .Pose(90, 90, 75, 75, speed_delay * 2).Pause(300);
+    return track.Append(Stand());
+}
+
+//-- Wag tail: the WagTail swing between 30° and 150°
+MotionTrack MotionTrack::WagTail(int wags, int speed_delay) {
+    MotionTrack track;
+    track.Move(SERVO_TAIL, 90, 200);
+    for (int i = 0; i < wags; i++) {
+        track.Move(SERVO_TAIL, 150, speed_delay)
+            .Move(SERVO_TAIL, 30, speed_delay);
+    }
+    track.Move(SERVO_TAIL, 90, speed_delay);
+    return track;
+}
+
+///////////////////////////////////////////////////////////////////
+//-- MOTION ENGINE ----------------------------------------------//
+///////////////////////////////////////////////////////////////////
+OttoMotion::OttoMotion(Otto& otto) : otto_(otto) {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<OttoMotion*>(arg)->OnTick();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "otto_motion",
+        .skip_unhandled_events = true
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_handle_));
+}
+
+OttoMotion::~OttoMotion() {
+    if (timer_handle_ != nullptr) {
+        esp_timer_stop(timer_handle_);
+        esp_timer_delete(timer_handle_);
+    }
+}
+
+void OttoMotion::Play(MotionTrack&& track) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = std::move(track);
+    has_pending_ = true;
+    if (!timer_running_) {
+        StartTimer();
+    }
+}
+
+void OttoMotion::Stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.frames.clear();
+    has_pending_ = false;
+    playing_ = false;
+}
+
+bool OttoMotion::IsPlaying() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return playing_ || has_pending_;
+}
+
+void OttoMotion::StartTimer() {
+    last_tick_us_ = 0;
+    timer_running_ = esp_timer_start_periodic(timer_handle_, MOTION_TICK_MS * 1000) == ESP_OK;
+    if (!timer_running_) {
+        ESP_LOGE(TAG, "Failed to start the motion timer");
+    }
+}
+
+void OttoMotion::OnTick() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+
+    if (last_tick_us_ != 0) {
+        uint32_t jitter = std::abs(now - last_tick_us_ - MOTION_TICK_MS * 1000);
+        stats_.intervals++;
+        stats_.max_jitter_us = std::max(stats_.max_jitter_us, jitter);
+        stats_.total_jitter_us += jitter;
+        if (jitter > MOTION_TICK_MS * 500) {
+            stats_.late_ticks++;
+        }
+    }
+    last_tick_us_ = now;
+    stats_.ticks++;
+
+    // A new track takes over from the current angles
+    if (has_pending_) {
+        track_ = std::move(pending_);
+        pending_.frames.clear();
+        has_pending_ = false;
+        playing_ = !track_.frames.empty();
+        frame_index_ = 0;
+        frame_start_us_ = now;
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            from_[i] = otto_.GetServoAngle(i);
+            written_[i] = INT16_MIN;
+        }
+    }
+
+    // Several keyframes can end in one tick when they are shorter than MOTION_TICK_MS
+    while (playing_) {
+        const MotionKeyframe& frame = track_.frames[frame_index_];
+        int64_t duration_us = frame.duration_ms * 1000LL;
+        int64_t elapsed_us = now - frame_start_us_;
+        float t = elapsed_us >= duration_us ? 1.0f : (float)elapsed_us / duration_us;
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            if (frame.angles[i] == MOTION_HOLD) {
+                continue;
+            }
+            int angle = std::lround(from_[i] + (frame.angles[i] - from_[i]) * t);
+            if (angle != written_[i]) {
+                otto_.ServoWrite(i, angle);
+                written_[i] = angle;
+            }
+        }
+        if (t < 1.0f) {
+            break;
+        }
+
+        stats_.frames++;
+        stats_.last_frame_late_us = elapsed_us - duration_us;
+        stats_.max_frame_late_us = std::max(stats_.max_frame_late_us, stats_.last_frame_late_us);
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            if (frame.angles[i] != MOTION_HOLD) {
+                from_[i] = frame.angles[i];
+            }
+        }
+        // The next keyframe starts when this one was due, not when the tick came
+        frame_start_us_ += duration_us;
+        if (++frame_index_ == track_.frames.size()) {
+            playing_ = false;
+        }
+    }
+
+    if (!playing_ && !has_pending_) {
+        esp_timer_stop(timer_handle_);
+        timer_running_ = false;
+    }
+    stats_.max_tick_us = std::max<uint32_t>(stats_.max_tick_us, esp_timer_get_time() - now);
+}
+
+MotionStats OttoMotion::GetStatistics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void OttoMotion::ResetStatistics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ = MotionStats();
+}
+
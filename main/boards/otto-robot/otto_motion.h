@@ -0,0 +1,99 @@
+#ifndef __OTTO_MOTION_H__
+#define __OTTO_MOTION_H__
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "esp_timer.h"
+#include "otto_movements.h"
+
+// -- Motion engine tick, 50 Hz is the servo PWM frame rate so faster updates would not be seen
+#define MOTION_TICK_MS 20
+// -- Keyframe angle that leaves the servo where it is
+#define MOTION_HOLD -1
+
+//-- All servo targets of one keyframe, reached linearly over duration_ms from the previous one.
+//-- A keyframe of duration 0 writes its targets at once, like ServoAngleSet().
+struct MotionKeyframe {
+    int16_t angles[SERVO_COUNT];
+    uint16_t duration_ms;
+};
+
+//-- A gait as a list of keyframes. Builders below mirror the blocking Dog* movements of Otto:
+//-- Pose() and Move() jump to the angles and hold them for duration_ms, as ServoAngleSet()
+//-- followed by its delay does.
+class MotionTrack {
+public:
+    std::vector<MotionKeyframe> frames;
+
+    MotionTrack& Pose(int lf, int rf, int lb, int rb, int duration_ms, int tail = MOTION_HOLD);
+    MotionTrack& Move(int servo_id, int angle, int duration_ms);
+    MotionTrack& Move(int servo_a, int angle_a, int servo_b, int angle_b, int duration_ms);
+    MotionTrack& Pause(int duration_ms);
+    MotionTrack& Append(const MotionTrack& track);
+    uint32_t duration_ms() const;
+
+    // StandUp() waits 1200 + 500 ms after the jump
+    static MotionTrack Stand(int duration_ms = 1700);
+    static MotionTrack Walk(int steps, int speed_delay, int dir = FORWARD);
+    static MotionTrack Turn(int steps, int speed_delay, int dir = LEFT);
+    static MotionTrack Dance(int cycles);
+    static MotionTrack Balance(int duration_ms, int speed_delay);
+    static MotionTrack WagTail(int wags, int speed_delay);
+};
+
+struct MotionStats {
+    uint32_t ticks = 0;
+    uint32_t intervals = 0;         // Tick intervals measured, the first tick of a run has none
+    uint32_t max_jitter_us = 0;     // Largest deviation of a tick interval from MOTION_TICK_MS
+    uint64_t total_jitter_us = 0;
+    uint32_t late_ticks = 0;        // Ticks more than half a period late
+    uint32_t max_tick_us = 0;       // Longest time spent in a tick
+    uint32_t frames = 0;
+    uint32_t max_frame_late_us = 0; // Keyframe reached after its scheduled time, at most one tick when on time
+    uint32_t last_frame_late_us = 0;
+};
+
+/*
+ * Plays a MotionTrack on a periodic esp_timer, interpolating all servos of each keyframe in
+ * parallel. Play() returns at once, a track started while another one runs takes over on the
+ * next tick from wherever the servos are. Keyframes are scheduled from the start of the track,
+ * so a late tick does not shift the rest of the gait. The timer only runs while a track plays.
+ */
+class OttoMotion {
+public:
+    explicit OttoMotion(Otto& otto);
+    ~OttoMotion();
+
+    void Play(MotionTrack&& track);
+    // No servo is written once this returns
+    void Stop();
+    bool IsPlaying();
+
+    MotionStats GetStatistics();
+    void ResetStatistics();
+
+private:
+    Otto& otto_;
+    esp_timer_handle_t timer_handle_ = nullptr;
+    std::mutex mutex_;
+
+    MotionTrack track_;
+    MotionTrack pending_;
+    bool has_pending_ = false;
+    bool playing_ = false;
+    bool timer_running_ = false;
+    size_t frame_index_ = 0;
+    int64_t frame_start_us_ = 0;
+    float from_[SERVO_COUNT];
+    int written_[SERVO_COUNT];
+
+    int64_t last_tick_us_ = 0;
+    MotionStats stats_;
+
+    void OnTick();
+    void StartTimer();
+};
+
+#endif  // __OTTO_MOTION_H__
@@ -0,0 +1,68 @@
+#include "otto_motion_benchmark.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+static const char* TAG = "OttoMotionBenchmark";
+
+cJSON* OttoMotionBenchmark::Run(Otto& otto, OttoMotion& motion, int steps, int speed_delay) {
+    motion.Stop();
+    MotionTrack track = MotionTrack::Walk(steps, speed_delay);
+    uint32_t nominal_ms = track.duration_ms();
+
+    // Blocking playback, as ServoAngleSet + vTaskDelay: keyframe ends are measured against the schedule
+    uint32_t legacy_max_error_us = 0;
+    uint64_t legacy_total_error_us = 0;
+    int64_t start_time = esp_timer_get_time();
+    int64_t scheduled_end = start_time;
+    for (auto& frame : track.frames) {
+        int64_t frame_start = esp_timer_get_time();
+        for (int i = 0; i < SERVO_COUNT; i++) {
+            if (frame.angles[i] != MOTION_HOLD) {
+                otto.ServoWrite(i, frame.angles[i]);
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(frame.duration_ms));
+        int64_t now = esp_timer_get_time();
+        uint32_t error = std::abs(now - frame_start - frame.duration_ms * 1000LL);
+        legacy_max_error_us = std::max(legacy_max_error_us, error);
+        legacy_total_error_us += error;
+        scheduled_end += frame.duration_ms * 1000LL;
+    }
+    int64_t legacy_drift_us = esp_timer_get_time() - scheduled_end;
+    uint32_t legacy_ms = (esp_timer_get_time() - start_time) / 1000;
+
+    motion.ResetStatistics();
+    start_time = esp_timer_get_time();
+    motion.Play(std::move(track));
+    while (motion.IsPlaying()) {
+        vTaskDelay(pdMS_TO_TICKS(MOTION_TICK_MS));
+    }
+    uint32_t engine_ms = (esp_timer_get_time() - start_time) / 1000;
+    MotionStats stats = motion.GetStatistics();
+
+    size_t frames = stats.frames;
+    uint32_t legacy_avg_error_us = frames > 0 ? legacy_total_error_us / frames : 0;
+    uint32_t avg_jitter_us = stats.intervals > 0 ? stats.total_jitter_us / stats.intervals : 0;
+    ESP_LOGI(TAG, "%u keyframes, %lu ms nominal. Blocking: keyframe error max %lu us avg %lu us, drift %ld us, %lu ms. "
+        "Motion engine: tick jitter max %lu us avg %lu us, keyframe late max %lu us, end %lu us late, %lu ms",
+        frames, nominal_ms, legacy_max_error_us, legacy_avg_error_us, (int32_t)legacy_drift_us, legacy_ms,
+        stats.max_jitter_us, avg_jitter_us, stats.max_frame_late_us, stats.last_frame_late_us, engine_ms);
+
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "keyframes", frames);
+    cJSON_AddNumberToObject(root, "nominal_ms", nominal_ms);
+    cJSON_AddNumberToObject(root, "blocking_ms", legacy_ms);
+    cJSON_AddNumberToObject(root, "blocking_max_keyframe_error_us", legacy_max_error_us);
+    cJSON_AddNumberToObject(root, "blocking_avg_keyframe_error_us", legacy_avg_error_us);
+    cJSON_AddNumberToObject(root, "blocking_drift_us", legacy_drift_us);
+    cJSON_AddNumberToObject(root, "engine_ms", engine_ms);
+    cJSON_AddNumberToObject(root, "engine_tick_hz", 1000 / MOTION_TICK_MS);
+    cJSON_AddNumberToObject(root, "engine_max_tick_jitter_us", stats.max_jitter_us);
+    cJSON_AddNumberToObject(root, "engine_avg_tick_jitter_us", avg_jitter_us);
+    cJSON_AddNumberToObject(root, "engine_late_ticks", stats.late_ticks);
+    cJSON_AddNumberToObject(root, "engine_max_tick_us", stats.max_tick_us);
+    cJSON_AddNumberToObject(root, "engine_max_keyframe_late_us", stats.max_frame_late_us);
+    cJSON_AddNumberToObject(root, "engine_end_late_us", stats.last_frame_late_us);
+    return root;
+}
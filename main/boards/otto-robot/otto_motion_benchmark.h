@@ -0,0 +1,19 @@
+#ifndef __OTTO_MOTION_BENCHMARK_H__
+#define __OTTO_MOTION_BENCHMARK_H__
+
+#include <cJSON.h>
+
+#include "otto_motion.h"
+
+/*
+ * Plays the walk gait twice on the real servos: once the way the Dog* movements do it, writing
+ * each keyframe at once and blocking in vTaskDelay for its duration, and once on OttoMotion.
+ * Reports how far the keyframes land from their schedule with each, and the tick jitter of the
+ * motion timer. The robot walks, so run it with room in front.
+ */
+class OttoMotionBenchmark {
+public:
+    static cJSON* Run(Otto& otto, OttoMotion& motion, int steps, int speed_delay);
+};
+
+#endif  // __OTTO_MOTION_BENCHMARK_H__
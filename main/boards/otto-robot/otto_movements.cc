@@ -17,6 +17,7 @@ Otto::Otto() {
         servo_pins_[i] = -1;
         servo_trim_[i] = 0;
         servo_compensate_[i] = 0;  // Compensation angles
+        servo_angle_[i] = 90;
     }
 }
 
@@ -92,6 +93,8 @@ void Otto::ServoWrite(int servo_id, float angle) {
         return;
     }
     
+    servo_angle_[servo_id] = angle;
+
     // Apply compensation and trim
     angle += servo_compensate_[servo_id] + servo_trim_[servo_id];
     
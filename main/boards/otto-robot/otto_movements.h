@@ -1,6 +1,8 @@
 #ifndef __OTTO_MOVEMENTS_H__
 #define __OTTO_MOVEMENTS_H__
 
+#include <atomic>
+
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_timer.h"
@@ -54,6 +56,10 @@ public:
     void ServoWrite(int servo_id, float angle);
     void ServoAngleSet(int servo_id, float angle, int delay_time);
     void ServoInit(int lf_angle, int rf_angle, int lb_angle, int rb_angle, int delay_time);
+    //-- Last angle written to a servo, before trim and compensation
+    // Written from the action task and the motion engine's timer
+    float GetServoAngle(int servo_id) { return servo_angle_[servo_id].load(std::memory_order_relaxed); }
+    bool HasServo(int servo_id) { return servo_pins_[servo_id] != -1; }
 
     //-- HOME = Otto at rest position
     void Home();
@@ -101,6 +107,7 @@ private:
     int servo_pins_[SERVO_COUNT];
     int servo_trim_[SERVO_COUNT];
     int servo_compensate_[SERVO_COUNT];  // Compensation angles like DogMaster
+    std::atomic<float> servo_angle_[SERVO_COUNT];
 
     unsigned long final_time_;
     unsigned long partial_time_;
@@ -0,0 +1,256 @@
+#include "keyword_matcher.h"
+
+#include <algorithm>
+#include <utility>
+#include <esp_log.h>
+
+#define TAG "KeywordMatcher"
+
+// Base letters of U+00C0..U+00FF, '.' for the ones that are not letters with diacritics
+static const char kLatin1Base[] = "aaaaaa.ceeeeiiii.nooooo..uuuuy..aaaaaa.ceeeeiiii.nooooo..uuuuy.y";
+// Base letters of U+1EA0..U+1EF9 (Latin Extended Additional, ạ .. ỹ), upper and lower case alternate
+static const char kVietnameseBase[] = "aaaaaaaaaaaaaaaaaaaaaaaaeeeeeeeeeeeeeeeeiiiioooooooooooooooooooooooouuuuuuuuuuuuuuyyyyyyyy";
+
+static bool FoldCodepoint(uint32_t cp, char& base, uint16_t& lower) {
+    if (cp >= 0xC0 && cp <= 0xFF) {
+        base = kLatin1Base[cp - 0xC0];
+        lower = cp <= 0xDE ? cp + 0x20 : cp;
+        return base != '.';
+    }
+    if (cp >= 0x1EA0 && cp <= 0x1EF9) {
+        base = kVietnameseBase[cp - 0x1EA0];
+        lower = cp | 1;
+        return true;
+    }
+    switch (cp) {
+    case 0x102: case 0x103: base = 'a'; lower = 0x103; return true;    // ă
+    case 0x110: case 0x111: base = 'd'; lower = 0x111; return true;    // đ
+    case 0x128: case 0x129: base = 'i'; lower = 0x129; return true;    // ĩ
+    case 0x168: case 0x169: base = 'u'; lower = 0x169; return true;    // ũ
+    case 0x1A0: case 0x1A1: base = 'o'; lower = 0x1A1; return true;    // ơ
+    case 0x1AF: case 0x1B0: base = 'u'; lower = 0x1B0; return true;    // ư
+    default: return false;
+    }
+}
+
+// Decodes one UTF-8 sequence, invalid bytes come back as U+FFFD and fold to a space
+static uint32_t DecodeUtf8(std::string_view text, size_t& i) {
+    uint8_t c = text[i++];
+    if (c < 0x80) {
+        return c;
+    }
+    int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+    if (extra == 0 || i + extra > text.size()) {
+        return 0xFFFD;
+    }
+    uint32_t cp = c & (0x3F >> extra);
+    for (int k = 0; k < extra; k++) {
+        uint8_t next = text[i + k];
+        if ((next & 0xC0) != 0x80) {
+            return 0xFFFD;
+        }
+        cp = (cp << 6) | (next & 0x3F);
+    }
+    i += extra;
+    return cp;
+}
+
+void KeywordMatcher::Fold(std::string_view text, std::string& folded, std::vector<uint16_t>& marks) {
+    folded.clear();
+    marks.clear();
+    folded.reserve(text.size() + 2);
+    marks.reserve(text.size() + 2);
+    // Both ends count as word boundaries
+    folded.push_back(' ');
+    marks.push_back(0);
+    size_t i = 0;
+    while (i < text.size()) {
+        uint32_t cp = DecodeUtf8(text, i);
+        char base;
+        uint16_t lower = 0;
+        if ((cp >= 'a' && cp <= 'z') || (cp >= '0' && cp <= '9')) {
+            base = cp;
+        } else if (cp >= 'A' && cp <= 'Z') {
+            base = cp + ('a' - 'A');
+        } else if (cp >= 0x300 && cp <= 0x36F) {
+            // Combining marks of decomposed text are not composed back. The letter before them gets
+            // a mark no phrase has, so the text counts as accented and that letter matches nothing.
+            if (folded.back() != ' ') {
+                marks.back() = kUnknownMark;
+            }
+            continue;
+        } else if (!FoldCodepoint(cp, base, lower)) {
+            if (folded.back() != ' ') {
+                folded.push_back(' ');
+                marks.push_back(0);
+            }
+            continue;
+        }
+        folded.push_back(base);
+        marks.push_back(lower);
+    }
+    if (folded.back() != ' ') {
+        folded.push_back(' ');
+        marks.push_back(0);
+    }
+}
+
+void KeywordMatcher::Add(std::string_view phrase, uint8_t id) {
+    if (id >= 32) {
+        ESP_LOGW(TAG, "Phrase id %u is out of range", id);
+        return;
+    }
+    pending_.emplace_back(phrase);
+    pending_ids_.push_back(id);
+}
+
+void KeywordMatcher::Clear() {
+    nodes_.clear();
+    edge_symbols_.clear();
+    edge_targets_.clear();
+    patterns_.clear();
+    pattern_marks_.clear();
+    pending_.clear();
+    pending_ids_.clear();
+}
+
+void KeywordMatcher::Build() {
+    nodes_.assign(1, Node());
+    edge_symbols_.clear();
+    edge_targets_.clear();
+    patterns_.clear();
+    pattern_marks_.clear();
+
+    // Trie with per-node child lists, flattened below once the fail links are known
+    std::vector<std::vector<std::pair<char, uint16_t>>> children(1);
+    auto child = [&children](uint16_t state, char symbol) -> uint16_t {
+        for (auto& edge : children[state]) {
+            if (edge.first == symbol) {
+                return edge.second;
+            }
+        }
+        return 0;
+    };
+
+    std::string folded;
+    std::vector<uint16_t> marks;
+    for (size_t i = 0; i < pending_.size(); i++) {
+        Fold(pending_[i], folded, marks);
+        if (folded.size() <= 2) {
+            continue;
+        }
+        if (folded.size() > UINT8_MAX || nodes_.size() + folded.size() >= UINT16_MAX) {
+            ESP_LOGW(TAG, "Skipping phrase: %s", pending_[i].c_str());
+            continue;
+        }
+        uint16_t state = 0;
+        for (char symbol : folded) {
+            uint16_t next = child(state, symbol);
+            if (next == 0) {
+                next = nodes_.size();
+                nodes_.emplace_back();
+                children.emplace_back();
+                children[state].emplace_back(symbol, next);
+            }
+            state = next;
+        }
+        Pattern pattern;
+        pattern.id = pending_ids_[i];
+        pattern.length = folded.size();
+        pattern.marks_offset = pattern_marks_.size();
+        pattern.next = nodes_[state].pattern;
+        nodes_[state].pattern = patterns_.size();
+        patterns_.push_back(pattern);
+        pattern_marks_.insert(pattern_marks_.end(), marks.begin(), marks.end());
+    }
+
+    // Breadth first, so a state's fail target is always complete before its children are visited
+    std::vector<uint16_t> queue;
+    queue.reserve(nodes_.size());
+    for (auto& edge : children[0]) {
+        queue.push_back(edge.second);
+    }
+    for (size_t head = 0; head < queue.size(); head++) {
+        uint16_t state = queue[head];
+        for (auto& edge : children[state]) {
+            uint16_t target = edge.second;
+            uint16_t fail = nodes_[state].fail;
+            while (fail != 0 && child(fail, edge.first) == 0) {
+                fail = nodes_[fail].fail;
+            }
+            fail = child(fail, edge.first);
+            nodes_[target].fail = fail;
+            nodes_[target].output = nodes_[fail].pattern != kNoPattern ? fail : nodes_[fail].output;
+            queue.push_back(target);
+        }
+    }
+
+    edge_symbols_.reserve(nodes_.size());
+    edge_targets_.reserve(nodes_.size());
+    for (size_t state = 0; state < nodes_.size(); state++) {
+        auto& edges = children[state];
+        std::sort(edges.begin(), edges.end());
+        nodes_[state].first_edge = edge_symbols_.size();
+        nodes_[state].edge_count = edges.size();
+        for (auto& edge : edges) {
+            edge_symbols_.push_back(edge.first);
+            edge_targets_.push_back(edge.second);
+        }
+    }
+
+    pending_.clear();
+    pending_.shrink_to_fit();
+    pending_ids_.clear();
+    pending_ids_.shrink_to_fit();
+    ESP_LOGI(TAG, "Built %u phrases into %u states", patterns_.size(), nodes_.size());
+}
+
+uint16_t KeywordMatcher::Next(uint16_t state, char symbol) const {
+    while (true) {
+        auto& node = nodes_[state];
+        for (int i = node.first_edge; i < node.first_edge + node.edge_count; i++) {
+            if (edge_symbols_[i] == symbol) {
+                return edge_targets_[i];
+            }
+        }
+        if (state == 0) {
+            return 0;
+        }
+        state = node.fail;
+    }
+}
+
+bool KeywordMatcher::MarksMatch(const Pattern& pattern, const uint16_t* marks) const {
+    const uint16_t* expected = &pattern_marks_[pattern.marks_offset];
+    for (int i = 0; i < pattern.length; i++) {
+        if (expected[i] != marks[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint32_t KeywordMatcher::Match(std::string_view text) const {
+    if (patterns_.empty()) {
+        return 0;
+    }
+    std::string folded;
+    std::vector<uint16_t> marks;
+    Fold(text, folded, marks);
+    bool accented = std::any_of(marks.begin(), marks.end(), [](uint16_t mark) { return mark != 0; });
+
+    uint32_t result = 0;
+    uint16_t state = 0;
+    for (size_t i = 0; i < folded.size(); i++) {
+        state = Next(state, folded[i]);
+        for (uint16_t s = state; s != 0; s = nodes_[s].output) {
+            for (uint16_t p = nodes_[s].pattern; p != kNoPattern; p = patterns_[p].next) {
+                auto& pattern = patterns_[p];
+                if (!accented || MarksMatch(pattern, &marks[i + 1 - pattern.length])) {
+                    result |= 1u << pattern.id;
+                }
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,70 @@
+#ifndef KEYWORD_MATCHER_H
+#define KEYWORD_MATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Finds a set of phrases in a transcript with one pass of an Aho-Corasick automaton.
+ *
+ * Text and phrases are folded first: lowercase, Vietnamese diacritics removed (đ becomes d),
+ * anything that is not a letter or digit turned into a single space. Phrases only match whole
+ * words, so "bắn" is found in "bắn đi" but not in "bắnh".
+ *
+ * Folding alone would make "bắn" match "bạn", so the diacritics are compared again on each hit.
+ * A transcript with any accent in it is taken as written and has to carry exactly the marks of
+ * the phrase, so "mua" (buy) does not match "múa" (dance). Only a transcript without a single
+ * accent (typed without them, or an STT engine that drops them) falls back to the folded
+ * comparison, where "ban" matches "bắn".
+ */
+class KeywordMatcher {
+public:
+    // |id| is a bit position in the mask returned by Match(), so it must be below 32
+    void Add(std::string_view phrase, uint8_t id);
+    void Build();
+    void Clear();
+
+    // Returns the bits of the ids whose phrases occur in |text|. Safe to call from any task
+    // once Build() has returned.
+    uint32_t Match(std::string_view text) const;
+
+    size_t phrase_count() const { return patterns_.size(); }
+    size_t state_count() const { return nodes_.size(); }
+
+    // Folded text and, per folded character, the lowercase code point it came from (0 for plain ASCII)
+    static void Fold(std::string_view text, std::string& folded, std::vector<uint16_t>& marks);
+
+private:
+    static constexpr uint16_t kNoPattern = 0xFFFF;
+    static constexpr uint16_t kUnknownMark = 0xFFFF;
+
+    struct Node {
+        uint16_t fail = 0;
+        uint16_t output = 0;                // Nearest state on the fail chain that ends a phrase, 0 for none
+        uint16_t first_edge = 0;
+        uint8_t edge_count = 0;
+        uint16_t pattern = kNoPattern;      // First phrase ending here, the rest are chained by Pattern::next
+    };
+
+    struct Pattern {
+        uint8_t id;
+        uint8_t length;
+        uint16_t marks_offset;
+        uint16_t next;
+    };
+
+    std::vector<Node> nodes_;
+    std::vector<char> edge_symbols_;
+    std::vector<uint16_t> edge_targets_;
+    std::vector<Pattern> patterns_;
+    std::vector<uint16_t> pattern_marks_;
+    std::vector<std::string> pending_;
+    std::vector<uint8_t> pending_ids_;
+
+    uint16_t Next(uint16_t state, char symbol) const;
+    bool MarksMatch(const Pattern& pattern, const uint16_t* marks) const;
+};
+
+#endif // KEYWORD_MATCHER_H
@@ -0,0 +1,129 @@
+#include "mcp_benchmark.h"
+#include "mcp_server.h"
+#include "websocket_protocol.h"
+
+#include <algorithm>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/base64.h>
+#include <stdexcept>
+
+#define TAG "McpBenchmark"
+
+// Free heap now, lowest free heap since the monitor was started
+static size_t PeakHeapUse(size_t free_before) {
+    size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    return free_before > min_free ? free_before - min_free : 0;
+}
+
+static uint32_t Fnv1a(uint32_t hash, const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+cJSON* McpBenchmark::RunImage(int image_size) {
+    // Stands in for a JPEG, the content does not change the sizes
+    std::string data(image_size, 0);
+    uint32_t seed = 1;
+    for (auto& c : data) {
+        seed = seed * 1103515245u + 12345u;
+        c = seed >> 16;
+    }
+
+    if (heap_caps_monitor_local_minimum_free_size_start() != ESP_OK) {
+        throw std::runtime_error("Heap monitor is already running");
+    }
+
+    // Previous path: ImageContent, to_json(), McpTool::Call(), ReplyResult(), Protocol::SendMcpMessage()
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    int64_t start_time = esp_timer_get_time();
+    uint32_t legacy_hash = 2166136261u;
+    size_t legacy_size = 0;
+    {
+        size_t dlen = 0, olen = 0;
+        mbedtls_base64_encode(nullptr, 0, &dlen, (const unsigned char*)data.data(), data.size());
+        std::string encoded(dlen, 0);
+        mbedtls_base64_encode((unsigned char*)encoded.data(), encoded.size(), &olen, (const unsigned char*)data.data(), data.size());
+        encoded.resize(olen);
+        legacy_hash = Fnv1a(legacy_hash, encoded.data(), encoded.size());
+
+        cJSON* json = cJSON_CreateObject();
+        cJSON_AddStringToObject(json, "type", "image");
+        cJSON_AddStringToObject(json, "mimeType", "image/jpeg");
+        cJSON_AddStringToObject(json, "data", encoded.c_str());
+        char* json_str = cJSON_PrintUnformatted(json);
+        std::string image_json(json_str);
+        cJSON_free(json_str);
+        cJSON_Delete(json);
+
+        cJSON* result = cJSON_CreateObject();
+        cJSON* content = cJSON_CreateArray();
+        cJSON* image = cJSON_CreateObject();
+        cJSON_AddStringToObject(image, "type", "image");
+        cJSON_AddStringToObject(image, "image", image_json.c_str());
+        cJSON_AddItemToArray(content, image);
+        cJSON_AddItemToObject(result, "content", content);
+        cJSON_AddBoolToObject(result, "isError", false);
+        json_str = cJSON_PrintUnformatted(result);
+        std::string result_str(json_str);
+        cJSON_free(json_str);
+        cJSON_Delete(result);
+
+        std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":1,\"result\":" + result_str + "}";
+        std::string message = "{\"session_id\":\"00000000\",\"type\":\"mcp\",\"payload\":" + payload + "}";
+        legacy_size = message.size();
+    }
+    int64_t legacy_us = esp_timer_get_time() - start_time;
+    size_t legacy_peak = PeakHeapUse(free_before);
+    heap_caps_monitor_local_minimum_free_size_stop();
+
+    heap_caps_monitor_local_minimum_free_size_start();
+    free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    start_time = esp_timer_get_time();
+    uint32_t stream_hash = 2166136261u;
+    size_t stream_size = 0;
+    bool encoded = false;
+    {
+        ImageContent image("image/jpeg", std::move(data));
+        std::string fragment;
+        fragment.reserve(WEBSOCKET_TEXT_FRAGMENT_SIZE);
+        encoded = image.Encode([&](const char* chunk, size_t size) {
+            stream_hash = Fnv1a(stream_hash, chunk, size);
+            while (size > 0) {
+                if (fragment.size() == WEBSOCKET_TEXT_FRAGMENT_SIZE) {
+                    stream_size += fragment.size();
+                    fragment.clear();
+                }
+                size_t length = std::min(size, WEBSOCKET_TEXT_FRAGMENT_SIZE - fragment.size());
+                fragment.append(chunk, length);
+                chunk += length;
+                size -= length;
+            }
+            return true;
+        });
+        stream_size += fragment.size();
+    }
+    int64_t stream_us = esp_timer_get_time() - start_time;
+    // The image data itself is not counted, the tool already holds it in both paths
+    size_t stream_peak = PeakHeapUse(free_before);
+    heap_caps_monitor_local_minimum_free_size_stop();
+
+    bool match = encoded && stream_hash == legacy_hash;
+    ESP_LOGI(TAG, "%d byte image, %u byte message: peak heap %u -> %u bytes, %lu us -> %lu us, base64 %s",
+        image_size, legacy_size, legacy_peak, stream_peak, (uint32_t)legacy_us, (uint32_t)stream_us,
+        match ? "matches" : "differs");
+
+    auto root = cJSON_CreateObject();
+    cJSON_AddNumberToObject(root, "image_size", image_size);
+    cJSON_AddNumberToObject(root, "encoded_size", stream_size);
+    cJSON_AddNumberToObject(root, "legacy_message_size", legacy_size);
+    cJSON_AddNumberToObject(root, "legacy_peak_heap", legacy_peak);
+    cJSON_AddNumberToObject(root, "streaming_peak_heap", stream_peak);
+    cJSON_AddNumberToObject(root, "legacy_us", legacy_us);
+    cJSON_AddNumberToObject(root, "streaming_us", stream_us);
+    cJSON_AddBoolToObject(root, "base64_matches", match);
+    return root;
+}
@@ -0,0 +1,17 @@
+#ifndef MCP_BENCHMARK_H
+#define MCP_BENCHMARK_H
+
+#include <cJSON.h>
+
+/*
+ * Builds the tools/call reply for an image of the given size both ways: the previous
+ * base64 string, cJSON tree and concatenated payload, and ImageContent::Encode() into a writer
+ * that keeps one WebSocket fragment, as WebsocketProtocol does. Reports the peak heap use and
+ * time of each and whether the base64 text matches.
+ */
+class McpBenchmark {
+public:
+    static cJSON* RunImage(int image_size);
+};
+
+#endif // MCP_BENCHMARK_H
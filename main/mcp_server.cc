@@ -7,6 +7,8 @@
 #include "boards/otto-robot/otto_webserver.h"
 #include <esp_log.h>
 #include <esp_app_desc.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
 #include <algorithm>
 #include <cstring>
 #include <esp_pthread.h>
@@ -19,17 +21,23 @@
 #include "settings.h"
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
+#if CONFIG_USE_AUDIO_BENCHMARK
+#include "audio_benchmark.h"
+#endif
+#if CONFIG_USE_MCP_IMAGE_BENCHMARK
+#include "mcp_benchmark.h"
+#endif
 
 #define TAG "MCP"
 
+// Blocking tools/call requests waiting for a worker, beyond this the call is rejected
+#define MCP_TOOL_QUEUE_SIZE 4
+#define MCP_TOOL_WORKER_STACK_SIZE (2048 * 4)
+
 McpServer::McpServer() {
 }
 
 McpServer::~McpServer() {
-    for (auto tool : tools_) {
-        delete tool;
-    }
-    tools_.clear();
 }
 
 void McpServer::AddCommonTools() {
@@ -37,8 +45,8 @@ void McpServer::AddCommonTools() {
     // the tools list to utilize the prompt cache.
     // **重要** 为了提升响应速度，我们把常用的工具放在前面，利用 prompt cache 的特性。
 
-    // Backup the original tools list and restore it after adding the common tools.
-    auto original_tools = std::move(tools_);
+    // The common tools are appended and then moved in front of the tools added before.
+    size_t original_count = tools_.size();
     auto& board = Board::GetInstance();
 
     // Do not add custom tools here.
@@ -51,7 +59,21 @@ void McpServer::AddCommonTools() {
         "2. As the first step to control the device (e.g. turn up / down the volume of the audio speaker, etc.)",
         PropertyList(),
         [&board](const PropertyList& properties) -> ReturnValue {
-            return board.GetDeviceStatusJson();
+            auto root = cJSON_Parse(board.GetDeviceStatusJson().c_str());
+            if (root == nullptr) {
+                return board.GetDeviceStatusJson();
+            }
+            auto protocol = Application::GetInstance().GetProtocol();
+            if (protocol != nullptr) {
+                auto metrics = protocol->MetricsToJson();
+                cJSON_AddNumberToObject(metrics, "wake_to_listen_ms", Application::GetInstance().GetWakeToListenMs());
+                cJSON_AddItemToObject(root, "protocol", metrics);
+            }
+            cJSON_AddItemToObject(root, "audio_uplink", Application::GetInstance().GetAudioService().uplink_rate().ToJson());
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+            cJSON_AddItemToObject(root, "audio_latency", LatencyTrace::GetInstance().ToJson());
+#endif
+            return root;
         });
 
     AddTool("self.audio_speaker.set_volume", 
@@ -101,7 +123,7 @@ void McpServer::AddCommonTools() {
 
     auto camera = board.GetCamera();
     if (camera) {
-        AddTool("self.camera.take_photo",
+        AddBlockingTool("self.camera.take_photo",
             "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
             "Args:\n"
             "  `question`: The question that you want to ask about the photo.\n"
@@ -114,9 +136,17 @@ void McpServer::AddCommonTools() {
                 // Lower the priority to do the camera capture
                 TaskPriorityReset priority_reset(1);
 
+                // A cancelled call gives its worker back before the capture and before the upload
+                auto& server = McpServer::GetInstance();
+                if (server.IsCallCancelled()) {
+                    throw std::runtime_error("Cancelled");
+                }
                 if (!camera->Capture()) {
                     throw std::runtime_error("Failed to capture photo");
                 }
+                if (server.IsCallCancelled()) {
+                    throw std::runtime_error("Cancelled");
+                }
                 auto question = properties["question"].value<std::string>();
                 return camera->Explain(question);
             });
@@ -126,7 +156,7 @@ void McpServer::AddCommonTools() {
     // Music streaming tools
     auto music_player = board.GetMusicPlayer();
     if (music_player) {
-        AddTool("self.music.play",
+        AddBlockingTool("self.music.play",
             "Play music from an HTTP URL. Supports streaming MP3 format.\n"
             "Args:\n"
             "  `url`: The HTTP URL of the music file (MP3 format).\n"
@@ -140,6 +170,11 @@ void McpServer::AddCommonTools() {
                 ESP_LOGI(TAG, "Starting music playback: %s", url.c_str());
                 
                 bool success = music_player->StartStreaming(url);
+                // Stopping the old stream takes a while, a call cancelled meanwhile must not leave the new one playing
+                if (McpServer::GetInstance().IsCallCancelled()) {
+                    music_player->Stop();
+                    throw std::runtime_error("Cancelled");
+                }
                 if (success) {
                     return true;
                 } else {
@@ -190,8 +225,8 @@ void McpServer::AddCommonTools() {
             return json;
         });
 
-    // Restore the original tools list to the end of the tools list
-    tools_.insert(tools_.end(), original_tools.begin(), original_tools.end());
+    // Move the original tools list to the end of the tools list
+    tools_.MoveToFront(original_count);
 }
 
 void McpServer::AddUserOnlyTools() {
@@ -239,6 +274,34 @@ void McpServer::AddUserOnlyTools() {
             return true;
         });
 
+#if CONFIG_USE_AUDIO_BENCHMARK
+    // Takes seconds, so it runs on an MCP worker instead of the main event loop
+    auto audio_benchmark = new McpTool("self.audio.benchmark", "Run the audio pipeline benchmark on a dummy codec and return the measurements",
+        PropertyList({
+            Property("frames", kPropertyTypeInteger, 200, 10, 2000)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto codec = Board::GetInstance().GetAudioCodec();
+            AudioBenchmark benchmark(codec->input_sample_rate(), codec->output_sample_rate());
+            auto result = benchmark.Run(properties["frames"].value<int>());
+            AudioBenchmark::Log(result);
+            return AudioBenchmark::ToJson(result);
+        });
+    audio_benchmark->set_user_only(true);
+    audio_benchmark->set_blocking(1);
+    AddTool(audio_benchmark);
+#endif
+
+#if CONFIG_USE_MCP_IMAGE_BENCHMARK
+    AddUserOnlyTool("self.mcp.image_benchmark", "Compare the peak heap use of an image tools/call reply built in one string and streamed in chunks",
+        PropertyList({
+            Property("size", kPropertyTypeInteger, 61440, 1024, 262144)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return McpBenchmark::RunImage(properties["size"].value<int>());
+        });
+#endif
+
     // Display control
 #ifdef HAVE_LVGL
     auto display = dynamic_cast<LvglDisplay*>(Board::GetInstance().GetDisplay());
@@ -408,13 +471,11 @@ void McpServer::AddUserOnlyTools() {
 
 void McpServer::AddTool(McpTool* tool) {
     // Prevent adding duplicate tools
-    if (std::find_if(tools_.begin(), tools_.end(), [tool](const McpTool* t) { return t->name() == tool->name(); }) != tools_.end()) {
+    if (!tools_.Add(tool)) {
         ESP_LOGW(TAG, "Tool %s already added", tool->name().c_str());
         return;
     }
-
     ESP_LOGI(TAG, "Add tool: %s%s", tool->name().c_str(), tool->user_only() ? " [user]" : "");
-    tools_.push_back(tool);
 }
 
 void McpServer::AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback) {
@@ -427,6 +488,12 @@ void McpServer::AddUserOnlyTool(const std::string& name, const std::string& desc
     AddTool(tool);
 }
 
+void McpServer::AddBlockingTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback, int max_concurrency) {
+    auto tool = new McpTool(name, description, properties, callback);
+    tool->set_blocking(max_concurrency);
+    AddTool(tool);
+}
+
 void McpServer::ParseMessage(const std::string& message) {
     cJSON* json = cJSON_Parse(message.c_str());
     if (json == nullptr) {
@@ -473,6 +540,12 @@ void McpServer::ParseMessage(const cJSON* json) {
     
     auto method_str = std::string(method->valuestring);
     if (method_str.find("notifications") == 0) {
+        if (method_str == "notifications/cancelled") {
+            auto request_id = cJSON_GetObjectItem(cJSON_GetObjectItem(json, "params"), "requestId");
+            if (cJSON_IsNumber(request_id)) {
+                CancelToolCall(request_id->valueint);
+            }
+        }
         return;
     }
     
@@ -559,75 +632,52 @@ void McpServer::ReplyError(int id, const std::string& message) {
     Application::GetInstance().SendMcpMessage(payload);
 }
 
-void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
-    const int max_payload_size = 8000;
-    std::string json = "{\"tools\":[";
-    
-    bool found_cursor = cursor.empty();
-    auto it = tools_.begin();
-    std::string next_cursor = "";
-    
-    while (it != tools_.end()) {
-        // 如果我们还没有找到起始位置，继续搜索
-        if (!found_cursor) {
-            if ((*it)->name() == cursor) {
-                found_cursor = true;
-            } else {
-                ++it;
-                continue;
-            }
-        }
+// The base64 text is never held in full, each chunk is encoded while the message is being sent
+void McpServer::ReplyImageResult(int id, std::unique_ptr<ImageContent> image) {
+    std::shared_ptr<ImageContent> content(std::move(image));
+    std::string prefix = "{\"jsonrpc\":\"2.0\",\"id\":";
+    prefix += std::to_string(id) + ",\"result\":{\"content\":[{\"type\":\"image\",\"mimeType\":\"";
+    prefix += content->mime_type();
+    prefix += "\",\"data\":\"";
+    static const char suffix[] = "\"}],\"isError\":false}}";
+    size_t payload_size = prefix.size() + content->encoded_size() + strlen(suffix);
 
-        if (!list_user_only_tools && (*it)->user_only()) {
-            ++it;
-            continue;
-        }
-        
-        // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
-            // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
-            next_cursor = (*it)->name();
-            break;
+    auto& app = Application::GetInstance();
+    app.Schedule([&app, content, prefix = std::move(prefix), payload_size]() {
+        // Peak heap use while the reply is built and sent
+        size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        bool monitoring = heap_caps_monitor_local_minimum_free_size_start() == ESP_OK;
+        app.SendMcpMessage(payload_size, [&content, &prefix](const Protocol::TextWriter& write) {
+            return write(prefix.data(), prefix.size()) && content->Encode(write) && write(suffix, strlen(suffix));
+        });
+        if (monitoring) {
+            size_t min_free = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+            heap_caps_monitor_local_minimum_free_size_stop();
+            ESP_LOGI(TAG, "tools/call: Sent %u byte image as %u byte payload, peak heap use %u bytes",
+                content->size(), payload_size, free_before > min_free ? free_before - min_free : 0);
         }
-        
-        json += tool_json;
-        ++it;
-    }
-    
-    if (json.back() == ',') {
-        json.pop_back();
-    }
-    
-    if (json.back() == '[' && !tools_.empty()) {
-        // 如果没有添加任何tool，返回错误
-        ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
-        ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
-        return;
-    }
+    });
+}
 
-    if (next_cursor.empty()) {
-        json += "]}";
-    } else {
-        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
+    std::string page, error;
+    if (!tools_.GetPage(cursor, list_user_only_tools, page, error)) {
+        ESP_LOGE(TAG, "tools/list: %s", error.c_str());
+        ReplyError(id, error);
+        return;
     }
-    
-    ReplyResult(id, json);
+    ReplyResult(id, page);
 }
 
 void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments) {
-    auto tool_iter = std::find_if(tools_.begin(), tools_.end(), 
-                                 [&tool_name](const McpTool* tool) { 
-                                     return tool->name() == tool_name; 
-                                 });
-    
-    if (tool_iter == tools_.end()) {
+    auto tool = tools_.Find(tool_name);
+    if (tool == nullptr) {
         ESP_LOGE(TAG, "tools/call: Unknown tool: %s", tool_name.c_str());
         ReplyError(id, "Unknown tool: " + tool_name);
         return;
     }
 
-    PropertyList arguments = (*tool_iter)->properties();
+    PropertyList arguments = tool->properties();
     try {
         for (auto& argument : arguments) {
             bool found = false;
@@ -657,14 +707,146 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
         return;
     }
 
+    if (tool->blocking()) {
+        QueueBlockingCall(id, tool, std::move(arguments));
+        return;
+    }
+
     // Use main thread to call the tool
     auto& app = Application::GetInstance();
-    app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
+    app.Schedule([this, id, tool, arguments = std::move(arguments)]() {
         try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
+            std::unique_ptr<ImageContent> image;
+            auto result = tool->Call(arguments, image);
+            if (image) {
+                ReplyImageResult(id, std::move(image));
+            } else {
+                ReplyResult(id, result);
+            }
         } catch (const std::exception& e) {
             ESP_LOGE(TAG, "tools/call: %s", e.what());
             ReplyError(id, e.what());
         }
     });
 }
+
+void McpServer::QueueBlockingCall(int id, McpTool* tool, PropertyList&& arguments) {
+    auto call = std::make_shared<ToolCall>();
+    call->id = id;
+    call->tool = tool;
+    call->arguments = std::move(arguments);
+
+    std::unique_lock<std::mutex> lock(worker_mutex_);
+    if (pending_calls_.size() >= MCP_TOOL_QUEUE_SIZE) {
+        lock.unlock();
+        ESP_LOGE(TAG, "tools/call: Too many pending calls, rejecting %s", tool->name().c_str());
+        ReplyError(id, "Too many pending tool calls");
+        return;
+    }
+    pending_calls_.push_back(std::move(call));
+
+    // Workers are started on demand and then kept
+    if (idle_workers_ == 0 && worker_count_ < CONFIG_MCP_TOOL_WORKERS) {
+        char name[16];
+        snprintf(name, sizeof(name), "mcp_tool_%d", worker_count_);
+        if (xTaskCreate([](void* arg) {
+            static_cast<McpServer*>(arg)->ToolWorkerLoop();
+            vTaskDelete(NULL);
+        }, name, MCP_TOOL_WORKER_STACK_SIZE, this, 2, nullptr) == pdPASS) {
+            worker_count_++;
+        } else {
+            ESP_LOGE(TAG, "Failed to create MCP tool worker");
+        }
+    }
+    lock.unlock();
+    worker_cv_.notify_one();
+}
+
+// The first pending call whose tool is below its concurrency limit, worker_mutex_ must be held
+std::shared_ptr<McpServer::ToolCall> McpServer::TakeRunnableCall() {
+    for (auto it = pending_calls_.begin(); it != pending_calls_.end(); ++it) {
+        auto tool = (*it)->tool;
+        int running = std::count_if(running_calls_.begin(), running_calls_.end(),
+            [tool](const std::shared_ptr<ToolCall>& call) { return call->tool == tool; });
+        if (running < tool->max_concurrency()) {
+            auto call = std::move(*it);
+            pending_calls_.erase(it);
+            return call;
+        }
+    }
+    return nullptr;
+}
+
+void McpServer::ToolWorkerLoop() {
+    std::unique_lock<std::mutex> lock(worker_mutex_);
+    while (true) {
+        std::shared_ptr<ToolCall> call;
+        idle_workers_++;
+        worker_cv_.wait(lock, [this, &call]() {
+            call = TakeRunnableCall();
+            return call != nullptr;
+        });
+        idle_workers_--;
+        call->worker = xTaskGetCurrentTaskHandle();
+        running_calls_.push_back(call);
+        lock.unlock();
+
+        std::string result, error;
+        std::unique_ptr<ImageContent> image;
+        int64_t start_time = esp_timer_get_time();
+        try {
+            result = call->tool->Call(call->arguments, image);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        ESP_LOGI(TAG, "tools/call: %s took %lu ms", call->tool->name().c_str(), (uint32_t)((esp_timer_get_time() - start_time) / 1000));
+
+        lock.lock();
+        running_calls_.erase(std::find(running_calls_.begin(), running_calls_.end(), call));
+        // A call held back by the concurrency limit may be runnable now
+        worker_cv_.notify_all();
+        if (call->cancelled) {
+            ESP_LOGW(TAG, "tools/call: Dropping the result of cancelled call %d", call->id);
+            continue;
+        }
+        lock.unlock();
+        if (!error.empty()) {
+            ESP_LOGE(TAG, "tools/call: %s", error.c_str());
+            ReplyError(call->id, error);
+        } else if (image) {
+            ReplyImageResult(call->id, std::move(image));
+        } else {
+            ReplyResult(call->id, result);
+        }
+        lock.lock();
+    }
+}
+
+void McpServer::CancelToolCall(int id) {
+    std::lock_guard<std::mutex> lock(worker_mutex_);
+    auto pending = std::find_if(pending_calls_.begin(), pending_calls_.end(),
+        [id](const std::shared_ptr<ToolCall>& call) { return call->id == id; });
+    if (pending != pending_calls_.end()) {
+        ESP_LOGI(TAG, "tools/call: Cancelled call %d before it started", id);
+        pending_calls_.erase(pending);
+        return;
+    }
+    for (auto& call : running_calls_) {
+        if (call->id == id) {
+            ESP_LOGI(TAG, "tools/call: Cancelling running call %d", id);
+            call->cancelled = true;
+            return;
+        }
+    }
+}
+
+bool McpServer::IsCallCancelled() {
+    auto task = xTaskGetCurrentTaskHandle();
+    std::lock_guard<std::mutex> lock(worker_mutex_);
+    for (auto& call : running_calls_) {
+        if (call->worker == task) {
+            return call->cancelled;
+        }
+    }
+    return false;
+}
@@ -4,45 +4,61 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
 #include <functional>
 #include <variant>
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <algorithm>
 #include <mbedtls/base64.h>
 
 #include <cJSON.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 
+#include "mcp_tool_index.h"
+
+// Raw bytes base64 encoded at a time, a multiple of 3 so the chunks can simply be concatenated
+#define MCP_IMAGE_CHUNK_SIZE 3072
+
+/*
+ * An image returned by a tool. The data is kept as is and only encoded while the tools/call reply
+ * is sent, one MCP_IMAGE_CHUNK_SIZE chunk at a time (see McpServer::ReplyImageResult).
+ */
 class ImageContent {
 private:
-    std::string encoded_data_;
     std::string mime_type_;
-
-    static std::string Base64Encode(const std::string& data) {
-        size_t dlen = 0, olen = 0;
-        mbedtls_base64_encode((unsigned char*)nullptr, 0, &dlen, (const unsigned char*)data.data(), data.size());
-        std::string result(dlen, 0);
-        mbedtls_base64_encode((unsigned char*)result.data(), result.size(), &olen, (const unsigned char*)data.data(), data.size());
-        return result;
-    }
+    std::string data_;
 
 public:
-    ImageContent(const std::string& mime_type, const std::string& data) {
-        mime_type_ = mime_type;
-        // base64 encode data
-        encoded_data_ = Base64Encode(data);
+    ImageContent(const std::string& mime_type, std::string data) : mime_type_(mime_type), data_(std::move(data)) {
     }
 
-    std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "type", "image");
-        cJSON_AddStringToObject(json, "mimeType", mime_type_.c_str());
-        cJSON_AddStringToObject(json, "data", encoded_data_.c_str());
-        char* json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        return result;
+    const std::string& mime_type() const { return mime_type_; }
+    size_t size() const { return data_.size(); }
+    // Length of the base64 text, known before anything is encoded
+    size_t encoded_size() const { return (data_.size() + 2) / 3 * 4; }
+
+    // Passes the base64 text to |write| chunk by chunk, stops when it returns false
+    bool Encode(const std::function<bool(const char* data, size_t size)>& write) const {
+        std::vector<unsigned char> buffer(MCP_IMAGE_CHUNK_SIZE / 3 * 4 + 1);
+        for (size_t offset = 0; offset < data_.size(); offset += MCP_IMAGE_CHUNK_SIZE) {
+            size_t length = std::min<size_t>(MCP_IMAGE_CHUNK_SIZE, data_.size() - offset);
+            size_t olen = 0;
+            if (mbedtls_base64_encode(buffer.data(), buffer.size(), &olen, (const unsigned char*)data_.data() + offset, length) != 0) {
+                return false;
+            }
+            if (!write((const char*)buffer.data(), olen)) {
+                return false;
+            }
+        }
+        return true;
     }
 };
 
@@ -212,6 +228,7 @@ private:
     PropertyList properties_;
     std::function<ReturnValue(const PropertyList&)> callback_;
     bool user_only_ = false;
+    int max_concurrency_ = 0;   // 0 runs the tool on the main event loop
 
 public:
     McpTool(const std::string& name, 
@@ -224,10 +241,14 @@ public:
         callback_(callback) {}
 
     void set_user_only(bool user_only) { user_only_ = user_only; }
+    // Blocking tools run on the MCP worker tasks, at most |max_concurrency| calls at a time
+    void set_blocking(int max_concurrency) { max_concurrency_ = max_concurrency; }
     inline const std::string& name() const { return name_; }
     inline const std::string& description() const { return description_; }
     inline const PropertyList& properties() const { return properties_; }
     inline bool user_only() const { return user_only_; }
+    inline bool blocking() const { return max_concurrency_ > 0; }
+    inline int max_concurrency() const { return max_concurrency_; }
 
     std::string to_json() const {
         std::vector<std::string> required = properties_.GetRequired();
@@ -269,37 +290,33 @@ public:
         return result;
     }
 
-    std::string Call(const PropertyList& properties) {
+    // The tools/call result as JSON. An image is handed back in |image| instead, McpServer streams it
+    std::string Call(const PropertyList& properties, std::unique_ptr<ImageContent>& image) {
         ReturnValue return_value = callback_(properties);
+        if (std::holds_alternative<ImageContent*>(return_value)) {
+            image.reset(std::get<ImageContent*>(return_value));
+            return std::string();
+        }
+
         // 返回结果
         cJSON* result = cJSON_CreateObject();
         cJSON* content = cJSON_CreateArray();
-
-        if (std::holds_alternative<ImageContent*>(return_value)) {
-            auto image_content = std::get<ImageContent*>(return_value);
-            cJSON* image = cJSON_CreateObject();
-            cJSON_AddStringToObject(image, "type", "image");
-            cJSON_AddStringToObject(image, "image", image_content->to_json().c_str());
-            cJSON_AddItemToArray(content, image);
-            delete image_content;
-        } else {
-            cJSON* text = cJSON_CreateObject();
-            cJSON_AddStringToObject(text, "type", "text");
-            if (std::holds_alternative<std::string>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
-            } else if (std::holds_alternative<bool>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
-            } else if (std::holds_alternative<int>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
-            } else if (std::holds_alternative<cJSON*>(return_value)) {
-                cJSON* json = std::get<cJSON*>(return_value);
-                char* json_str = cJSON_PrintUnformatted(json);
-                cJSON_AddStringToObject(text, "text", json_str);
-                cJSON_free(json_str);
-                cJSON_Delete(json);
-            }
-            cJSON_AddItemToArray(content, text);
+        cJSON* text = cJSON_CreateObject();
+        cJSON_AddStringToObject(text, "type", "text");
+        if (std::holds_alternative<std::string>(return_value)) {
+            cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
+        } else if (std::holds_alternative<bool>(return_value)) {
+            cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
+        } else if (std::holds_alternative<int>(return_value)) {
+            cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
+        } else if (std::holds_alternative<cJSON*>(return_value)) {
+            cJSON* json = std::get<cJSON*>(return_value);
+            char* json_str = cJSON_PrintUnformatted(json);
+            cJSON_AddStringToObject(text, "text", json_str);
+            cJSON_free(json_str);
+            cJSON_Delete(json);
         }
+        cJSON_AddItemToArray(content, text);
         cJSON_AddItemToObject(result, "content", content);
         cJSON_AddBoolToObject(result, "isError", false);
 
@@ -323,8 +340,13 @@ public:
     void AddTool(McpTool* tool);
     void AddTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
     void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
+    // For tools that take seconds (capture, network), so they do not stall the main event loop
+    void AddBlockingTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback, int max_concurrency = 1);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+    // Called from a blocking tool: true once the client has cancelled the call, the result will be dropped.
+    // The worker stays busy until the tool returns, so tools check it between their long steps.
+    bool IsCallCancelled();
 
 private:
     McpServer();
@@ -334,11 +356,31 @@ private:
 
     void ReplyResult(int id, const std::string& result);
     void ReplyError(int id, const std::string& message);
+    void ReplyImageResult(int id, std::unique_ptr<ImageContent> image);
 
     void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools);
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
 
-    std::vector<McpTool*> tools_;
+    struct ToolCall {
+        int id;
+        McpTool* tool;
+        PropertyList arguments;
+        TaskHandle_t worker = nullptr;
+        std::atomic<bool> cancelled = false;
+    };
+    void QueueBlockingCall(int id, McpTool* tool, PropertyList&& arguments);
+    void CancelToolCall(int id);
+    std::shared_ptr<ToolCall> TakeRunnableCall();
+    void ToolWorkerLoop();
+
+    McpToolIndex<McpTool> tools_;
+
+    std::mutex worker_mutex_;
+    std::condition_variable worker_cv_;
+    std::deque<std::shared_ptr<ToolCall>> pending_calls_;
+    std::vector<std::shared_ptr<ToolCall>> running_calls_;
+    int worker_count_ = 0;
+    int idle_workers_ = 0;
 };
 
 #endif // MCP_SERVER_H
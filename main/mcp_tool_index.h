@@ -0,0 +1,151 @@
+#ifndef MCP_TOOL_INDEX_H
+#define MCP_TOOL_INDEX_H
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Largest tools/list result, a page ends before the tool that would not fit
+#define MCP_TOOLS_LIST_MAX_PAYLOAD_SIZE 8000
+
+/*
+ * The registered MCP tools in tools/list order, indexed by name for tools/call and for resuming
+ * tools/list at a cursor. Each tools/list page is serialized once and kept until a tool is added,
+ * the tools themselves keep no JSON.
+ *
+ * Tools are added from the main task while tools/list and tools/call are served from the main
+ * loop and the MCP workers, so every member goes through one mutex. Tools are never removed, a
+ * pointer returned by Find() stays valid.
+ *
+ * |Tool| needs name(), user_only() and to_json(). Owns the tools it holds.
+ */
+template <typename Tool>
+class McpToolIndex {
+public:
+    McpToolIndex() = default;
+    McpToolIndex(const McpToolIndex&) = delete;
+    McpToolIndex& operator=(const McpToolIndex&) = delete;
+
+    ~McpToolIndex() {
+        for (auto tool : tools_) {
+            delete tool;
+        }
+    }
+
+    // Returns false and leaves |tool| to the caller if one with the same name was added before
+    bool Add(Tool* tool) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (index_.find(tool->name()) != index_.end()) {
+            return false;
+        }
+        tools_.push_back(tool);
+        index_[tool->name()] = tools_.size() - 1;
+        ClearPages();
+        return true;
+    }
+
+    // Moves the tools from position |first| on in front of the others, keeping their order
+    void MoveToFront(size_t first) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::rotate(tools_.begin(), tools_.begin() + std::min(first, tools_.size()), tools_.end());
+        for (size_t i = 0; i < tools_.size(); i++) {
+            index_[tools_[i]->name()] = i;
+        }
+        ClearPages();
+    }
+
+    Tool* Find(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(name);
+        return it != index_.end() ? tools_[it->second] : nullptr;
+    }
+
+    size_t size() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tools_.size();
+    }
+
+    // Copies the tools/list result for the page starting at |cursor|, building it on first use
+    bool GetPage(const std::string& cursor, bool list_user_only_tools, std::string& result, std::string& error) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t start = 0;
+        if (!cursor.empty()) {
+            auto it = index_.find(cursor);
+            if (it == index_.end()) {
+                error = "Invalid cursor: " + cursor;
+                return false;
+            }
+            start = it->second;
+        }
+
+        auto& pages = pages_[list_user_only_tools ? 1 : 0];
+        auto page = pages.find(start);
+        if (page == pages.end()) {
+            std::string json;
+            if (!BuildPage(start, list_user_only_tools, json, error)) {
+                return false;
+            }
+            page = pages.emplace(start, std::move(json)).first;
+        }
+        result = page->second;
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<Tool*> tools_;
+    std::unordered_map<std::string, size_t> index_;
+    // Serialized pages by start position, one map without and one with user only tools
+    std::unordered_map<size_t, std::string> pages_[2];
+
+    void ClearPages() {
+        for (auto& pages : pages_) {
+            pages.clear();
+        }
+    }
+
+    bool BuildPage(size_t start, bool list_user_only_tools, std::string& json, std::string& error) {
+        json = "{\"tools\":[";
+        std::string next_cursor = "";
+
+        for (size_t i = start; i < tools_.size(); i++) {
+            auto tool = tools_[i];
+            if (!list_user_only_tools && tool->user_only()) {
+                continue;
+            }
+
+            // 添加tool前检查大小
+            std::string tool_json = tool->to_json();
+            if (json.length() + tool_json.length() + 1 + 30 > MCP_TOOLS_LIST_MAX_PAYLOAD_SIZE) {
+                // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
+                next_cursor = tool->name();
+                break;
+            }
+
+            json += tool_json;
+            json += ',';
+        }
+
+        if (json.back() == ',') {
+            json.pop_back();
+        }
+
+        if (json.back() == '[' && !tools_.empty()) {
+            // 如果没有添加任何tool，返回错误
+            error = "Failed to add tool " + next_cursor + " because of payload size limit";
+            return false;
+        }
+
+        if (next_cursor.empty()) {
+            json += "]}";
+        } else {
+            json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+        }
+        json.shrink_to_fit();
+        return true;
+    }
+};
+
+#endif // MCP_TOOL_INDEX_H
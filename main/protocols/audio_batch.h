@@ -0,0 +1,42 @@
+#ifndef AUDIO_BATCH_H
+#define AUDIO_BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+ * Payload of a batched binary audio message: |length 2u|opus length| per frame, the length in
+ * network byte order. Frames follow each other without padding, so after an odd sized frame the
+ * next length field is unaligned; it is always read and written one byte at a time.
+ */
+class AudioBatch {
+public:
+    static void Append(std::vector<uint8_t>& buffer, const uint8_t* data, size_t size) {
+        size_t offset = buffer.size();
+        buffer.resize(offset + 2 + size);
+        buffer[offset] = (uint8_t)(size >> 8);
+        buffer[offset + 1] = (uint8_t)size;
+        memcpy(&buffer[offset + 2], data, size);
+    }
+
+    // Calls on_frame(data, size) for each frame in order. Returns false if the payload is
+    // malformed, the frames before the bad length have been delivered by then.
+    template <typename F>
+    static bool ForEach(const uint8_t* data, size_t size, F&& on_frame) {
+        size_t offset = 0;
+        while (offset + 2 <= size) {
+            size_t frame_size = ((size_t)data[offset] << 8) | data[offset + 1];
+            offset += 2;
+            if (frame_size > size - offset) {
+                return false;
+            }
+            on_frame(data + offset, frame_size);
+            offset += frame_size;
+        }
+        return offset == size;
+    }
+};
+
+#endif // AUDIO_BATCH_H
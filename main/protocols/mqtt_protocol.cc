@@ -95,6 +95,10 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
+        if (DispatchServerMessage(payload.data(), payload.size())) {
+            last_incoming_time_ = std::chrono::steady_clock::now();
+            return;
+        }
         cJSON* root = cJSON_Parse(payload.c_str());
         if (root == nullptr) {
             ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
@@ -172,24 +176,16 @@ bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         return false;
     }
 
-    std::string nonce(aes_nonce_);
-    *(uint16_t*)&nonce[2] = htons(packet->payload.size());
-    *(uint32_t*)&nonce[8] = htonl(packet->timestamp);
-    *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
-
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet->payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
-
-    size_t nc_off = 0;
-    uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet->payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
+    if (!cipher_.Encrypt(packet->opus_data(), packet->opus_size(), packet->timestamp, ++local_sequence_, udp_send_buffer_)) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return false;
     }
 
-    return udp_->Send(encrypted) > 0;
+    if (udp_->Send(udp_send_buffer_) <= 0) {
+        return false;
+    }
+    RecordSentAudio(packet->opus_size());
+    return true;
 }
 
 void MqttProtocol::CloseAudioChannel() {
@@ -198,6 +194,10 @@ void MqttProtocol::CloseAudioChannel() {
         udp_.reset();
     }
 
+    auto& stats = downlink_window_.statistics();
+    ESP_LOGI(TAG, "UDP downlink: received %lu, reordered %lu, duplicate %lu, late %lu, lost %lu",
+        stats.received, stats.reordered, stats.duplicate, stats.late, stats.lost);
+
     std::string message = "{";
     message += "\"session_id\":\"" + session_id_ + "\",";
     message += "\"type\":\"goodbye\"";
@@ -210,6 +210,7 @@ void MqttProtocol::CloseAudioChannel() {
 }
 
 bool MqttProtocol::OpenAudioChannel() {
+    ResetMetrics();
     if (mqtt_ == nullptr || !mqtt_->IsConnected()) {
         ESP_LOGI(TAG, "MQTT is not connected, try to connect now");
         if (!StartMqttClient(true)) {
@@ -244,7 +245,7 @@ bool MqttProtocol::OpenAudioChannel() {
          * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
          * |payload payload_len|
          */
-        if (data.size() < sizeof(aes_nonce_)) {
+        if (data.size() < UDP_AUDIO_HEADER_SIZE) {
             ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
             return;
         }
@@ -254,37 +255,29 @@ bool MqttProtocol::OpenAudioChannel() {
         }
         uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
         uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
+        // Packets reordered inside the window are passed on, the audio service jitter buffer sorts them out
+        if (!downlink_window_.Accept(sequence)) {
             return;
         }
-        if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
-        }
 
-        size_t decrypted_size = data.size() - aes_nonce_.size();
-        size_t nc_off = 0;
-        uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
-        auto packet = std::make_unique<AudioStreamPacket>();
+        // Decrypted straight into the pooled packet's payload buffer
+        auto packet = AudioStreamPacket::Create();
         packet->sample_rate = server_sample_rate_;
         packet->frame_duration = server_frame_duration_;
         packet->timestamp = timestamp;
-        packet->payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet->payload.data());
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+        packet->sequence = sequence;
+        if (!cipher_.Decrypt((const uint8_t*)data.data(), data.size(), packet->payload)) {
+            ESP_LOGE(TAG, "Failed to decrypt audio data");
             return;
         }
         if (on_incoming_audio_ != nullptr) {
             on_incoming_audio_(std::move(packet));
         }
-        remote_sequence_ = sequence;
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
     udp_->Connect(udp_server_, udp_port_);
+    SetChannelOpened();
 
     if (on_audio_channel_opened_ != nullptr) {
         on_audio_channel_opened_();
@@ -355,11 +348,18 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
 
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
-    aes_nonce_ = DecodeHexString(nonce);
-    mbedtls_aes_init(&aes_ctx_);
-    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
+    if (!cipher_.SetKey(DecodeHexString(key), DecodeHexString(nonce))) {
+        ESP_LOGE(TAG, "Invalid UDP key or nonce");
+        return;
+    }
+    // Number of frames a packet may arrive behind a newer one and still be played
+    int reorder_window = SEQUENCE_WINDOW_DEFAULT_FRAMES;
+    auto reorder_window_item = cJSON_GetObjectItem(udp, "reorder_window");
+    if (cJSON_IsNumber(reorder_window_item)) {
+        reorder_window = reorder_window_item->valueint;
+    }
     local_sequence_ = 0;
-    remote_sequence_ = 0;
+    downlink_window_.SetFrames(reorder_window);
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
@@ -3,10 +3,11 @@
 
 
 #include "protocol.h"
+#include "udp_audio_cipher.h"
+#include "sequence_window.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
-#include <mbedtls/aes.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 #include <esp_timer.h>
@@ -40,12 +41,14 @@ private:
     std::mutex channel_mutex_;
     std::unique_ptr<Mqtt> mqtt_;
     std::unique_ptr<Udp> udp_;
-    mbedtls_aes_context aes_ctx_;
-    std::string aes_nonce_;
+    UdpAudioCipher cipher_;
+    // Datagram being sent, guarded by channel_mutex_. Keeps its capacity between packets.
+    std::string udp_send_buffer_;
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
-    uint32_t remote_sequence_;
+    // Touched by the UDP receive callback only, after the hello has configured it
+    SequenceWindow downlink_window_;
     esp_timer_handle_t reconnect_timer_;
     bool goodbye_action_queued_ = false;  // Track if goodbye sit action already queued
 
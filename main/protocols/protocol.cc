@@ -1,6 +1,7 @@
 #include "protocol.h"
 
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #define TAG "Protocol"
 
@@ -8,8 +9,28 @@ void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
 
+void Protocol::OnIncomingMessage(std::function<void(const ServerMessage& message)> callback) {
+    on_incoming_message_ = callback;
+}
+
 void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
-    on_incoming_audio_ = callback;
+    // Every transport delivers downlink audio through here, so it is counted once for all of them
+    on_incoming_audio_ = [this, callback](std::unique_ptr<AudioStreamPacket> packet) {
+        {
+            std::lock_guard<std::mutex> lock(metrics_mutex_);
+            metrics_.rx_packets++;
+            metrics_.rx_bytes += packet->payload.size();
+            if (metrics_.reply_pending) {
+                metrics_.reply_pending = false;
+                metrics_.replies++;
+                metrics_.first_audio_ms = (esp_timer_get_time() - metrics_.last_tx_time_us) / 1000;
+                if (metrics_.first_audio_ms > metrics_.first_audio_max_ms) {
+                    metrics_.first_audio_max_ms = metrics_.first_audio_ms;
+                }
+            }
+        }
+        callback(std::move(packet));
+    };
 }
 
 void Protocol::OnAudioChannelOpened(std::function<void()> callback) {
@@ -32,6 +53,53 @@ void Protocol::OnDisconnected(std::function<void()> callback) {
     on_disconnected_ = callback;
 }
 
+void Protocol::ResetMetrics() {
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    metrics_ = ProtocolMetrics();
+    metrics_.open_time_us = esp_timer_get_time();
+}
+
+void Protocol::SetChannelOpened() {
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    metrics_.connect_ms = (esp_timer_get_time() - metrics_.open_time_us) / 1000;
+}
+
+void Protocol::RecordSentAudio(size_t bytes, uint32_t packets) {
+    std::lock_guard<std::mutex> lock(metrics_mutex_);
+    metrics_.tx_packets += packets;
+    metrics_.tx_bytes += bytes;
+    metrics_.last_tx_time_us = esp_timer_get_time();
+    metrics_.reply_pending = true;
+}
+
+cJSON* Protocol::MetricsToJson() const {
+    auto m = metrics();
+    auto json = cJSON_CreateObject();
+    int64_t elapsed_ms = (esp_timer_get_time() - m.open_time_us) / 1000;
+    cJSON_AddNumberToObject(json, "connect_ms", m.connect_ms);
+    cJSON_AddNumberToObject(json, "first_audio_ms", m.first_audio_ms);
+    cJSON_AddNumberToObject(json, "first_audio_max_ms", m.first_audio_max_ms);
+    cJSON_AddNumberToObject(json, "replies", m.replies);
+    cJSON_AddNumberToObject(json, "tx_packets", m.tx_packets);
+    cJSON_AddNumberToObject(json, "tx_bytes", m.tx_bytes);
+    cJSON_AddNumberToObject(json, "rx_packets", m.rx_packets);
+    cJSON_AddNumberToObject(json, "rx_bytes", m.rx_bytes);
+    if (m.open_time_us != 0 && elapsed_ms > 0) {
+        cJSON_AddNumberToObject(json, "tx_kbps", m.tx_bytes * 8 / elapsed_ms);
+        cJSON_AddNumberToObject(json, "rx_kbps", m.rx_bytes * 8 / elapsed_ms);
+    }
+    return json;
+}
+
+void Protocol::LogMetrics() const {
+    auto m = metrics();
+    int elapsed_ms = (esp_timer_get_time() - m.open_time_us) / 1000;
+    ESP_LOGI(TAG, "Audio channel: connect %d ms, first audio %d ms (max %d ms, %lu replies), "
+        "tx %lu packets / %lu bytes, rx %lu packets / %lu bytes in %d ms",
+        m.connect_ms, m.first_audio_ms, m.first_audio_max_ms, m.replies,
+        m.tx_packets, m.tx_bytes, m.rx_packets, m.rx_bytes, elapsed_ms);
+}
+
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
     if (on_network_error_ != nullptr) {
@@ -78,6 +146,23 @@ void Protocol::SendMcpMessage(const std::string& payload) {
     SendText(message);
 }
 
+void Protocol::SendMcpMessage(size_t payload_size, const TextProducer& payload) {
+    std::string prefix = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":";
+    SendText(prefix.size() + payload_size + 1, [&prefix, &payload](const TextWriter& write) {
+        return write(prefix.data(), prefix.size()) && payload(write) && write("}", 1);
+    });
+}
+
+bool Protocol::SendText(size_t size, const TextProducer& producer) {
+    std::string text;
+    text.reserve(size);
+    bool produced = producer([&text](const char* data, size_t size) {
+        text.append(data, size);
+        return true;
+    });
+    return produced && SendText(text);
+}
+
 void Protocol::SendUserText(const std::string& text, bool is_chunk, int chunk_index) {
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"stt\"";
     if (is_chunk) {
@@ -97,3 +182,15 @@ bool Protocol::IsTimeout() const {
     }
     return timeout;
 }
+
+bool Protocol::DispatchServerMessage(const char* data, size_t len) {
+    if (on_incoming_message_ == nullptr) {
+        return false;
+    }
+    ServerMessage message;
+    if (!message_parser_.Parse(data, len, message)) {
+        return false;
+    }
+    on_incoming_message_(message);
+    return true;
+}
@@ -5,13 +5,34 @@
 #include <string>
 #include <functional>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "latency_trace.h"
+#include "server_message.h"
 #include <vector>
 
+// Room the encoder leaves in front of uplink opus data, enough for the largest header (BinaryProtocol2)
+#define AUDIO_PACKET_HEADROOM 16
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    uint32_t sequence = 0;  // Server sequence number (UDP), 0 when the transport is already in order (websocket, local sounds)
     std::vector<uint8_t> payload;
+    // Bytes at the front of |payload| kept free for a transport header, the opus data follows them
+    uint16_t headroom = 0;
+    LatencyStamps trace;
+
+    const uint8_t* opus_data() const { return payload.data() + headroom; }
+    size_t opus_size() const { return payload.size() - headroom; }
+
+    // Packets come from a fixed pool (see audio_packet_pool.cc). Deleting one returns it to the pool
+    // with its payload capacity intact, so steady-state frames do not allocate.
+    static std::unique_ptr<AudioStreamPacket> Create();
+    static void operator delete(AudioStreamPacket* packet, std::destroying_delete_t);
 };
 
 struct BinaryProtocol2 {
@@ -22,6 +43,7 @@ struct BinaryProtocol2 {
     uint32_t payload_size;  // Payload size in bytes
     uint8_t payload[];      // Payload data
 } __attribute__((packed));
+static_assert(sizeof(BinaryProtocol2) <= AUDIO_PACKET_HEADROOM);
 
 struct BinaryProtocol3 {
     uint8_t type;
@@ -30,6 +52,21 @@ struct BinaryProtocol3 {
     uint8_t payload[];
 } __attribute__((packed));
 
+// Statistics of the current audio channel, for the device status and the close log
+struct ProtocolMetrics {
+    int connect_ms = -1;            // OpenAudioChannel(): connection and hello exchange
+    int first_audio_ms = -1;        // Last uplink frame to the first downlink frame of the latest reply
+    int first_audio_max_ms = -1;
+    uint32_t replies = 0;
+    uint32_t tx_packets = 0;
+    uint32_t tx_bytes = 0;
+    uint32_t rx_packets = 0;
+    uint32_t rx_bytes = 0;
+    int64_t open_time_us = 0;
+    int64_t last_tx_time_us = 0;
+    bool reply_pending = false;
+};
+
 enum AbortReason {
     kAbortReasonNone,
     kAbortReasonWakeWordDetected
@@ -43,6 +80,11 @@ enum ListeningMode {
 
 class Protocol {
 public:
+    // Takes the next piece of a text message, returns false if it could not be sent
+    typedef std::function<bool(const char* data, size_t size)> TextWriter;
+    // Passes a whole text message to the writer piece by piece, in order
+    typedef std::function<bool(const TextWriter& write)> TextProducer;
+
     virtual ~Protocol() = default;
 
     inline int server_sample_rate() const {
@@ -54,9 +96,17 @@ public:
     inline const std::string& session_id() const {
         return session_id_;
     }
+    inline ProtocolMetrics metrics() const {
+        std::lock_guard<std::mutex> lock(metrics_mutex_);
+        return metrics_;
+    }
+    cJSON* MetricsToJson() const;
+    void LogMetrics() const;
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
     void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    // tts / stt / llm messages, parsed without cJSON. Other messages still go to OnIncomingJson.
+    void OnIncomingMessage(std::function<void(const ServerMessage& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -73,10 +123,13 @@ public:
     virtual void SendStopListening();
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    // For payloads too large to build in one string, |payload| must produce exactly |payload_size| bytes
+    virtual void SendMcpMessage(size_t payload_size, const TextProducer& payload);
     virtual void SendUserText(const std::string& text, bool is_chunk, int chunk_index);
 
 protected:
     std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const ServerMessage& message)> on_incoming_message_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
@@ -89,8 +142,23 @@ protected:
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+    // Used only by the transport's receive callback
+    ServerMessageParser message_parser_;
+    // Written by the sending task and the transport's receive task, read by the MCP status tool
+    mutable std::mutex metrics_mutex_;
+    ProtocolMetrics metrics_;
 
     virtual bool SendText(const std::string& text) = 0;
+    // Transports that can send a message in parts override this, by default it is collected and
+    // passed to SendText()
+    virtual bool SendText(size_t size, const TextProducer& producer);
+    // Returns true if the frame was a hot message and has been passed to OnIncomingMessage
+    bool DispatchServerMessage(const char* data, size_t len);
+    // Called by the transports: at the start of OpenAudioChannel(), once it succeeded, and once
+    // uplink frames have actually been sent
+    void ResetMetrics();
+    void SetChannelOpened();
+    void RecordSentAudio(size_t bytes, uint32_t packets = 1);
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
 };
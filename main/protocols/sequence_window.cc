@@ -0,0 +1,69 @@
+#include "sequence_window.h"
+
+// A jump back further than this is a sender that started counting again, not a late packet
+#define SEQUENCE_WINDOW_RESTART_DISTANCE 1000
+
+SequenceWindow::SequenceWindow(int frames) {
+    SetFrames(frames);
+}
+
+void SequenceWindow::SetFrames(int frames) {
+    if (frames < 1) {
+        frames = 1;
+    } else if (frames > SEQUENCE_WINDOW_MAX_FRAMES) {
+        frames = SEQUENCE_WINDOW_MAX_FRAMES;
+    }
+    frames_ = frames;
+    Reset();
+}
+
+void SequenceWindow::Reset() {
+    started_ = false;
+    highest_ = 0;
+    seen_ = 0;
+    statistics_ = SequenceWindowStatistics();
+}
+
+uint64_t SequenceWindow::mask() const {
+    return frames_ >= 64 ? ~0ULL : (1ULL << frames_) - 1;
+}
+
+bool SequenceWindow::Accept(uint32_t sequence) {
+    statistics_.received++;
+    if (!started_ || (sequence < highest_ && highest_ - sequence > SEQUENCE_WINDOW_RESTART_DISTANCE)) {
+        // Count everything before the first packet as seen, so it is not reported as lost
+        started_ = true;
+        highest_ = sequence;
+        seen_ = mask();
+        return true;
+    }
+
+    if (sequence > highest_) {
+        uint32_t shift = sequence - highest_;
+        if (shift >= (uint32_t)frames_) {
+            statistics_.lost += __builtin_popcountll(~seen_ & mask()) + (shift - frames_);
+            seen_ = 1;
+        } else {
+            // Bits pushed out of the window belong to sequences that never arrived
+            uint64_t leaving = seen_ >> (frames_ - shift);
+            statistics_.lost += shift - __builtin_popcountll(leaving);
+            seen_ = ((seen_ << shift) | 1) & mask();
+        }
+        highest_ = sequence;
+        return true;
+    }
+
+    uint32_t age = highest_ - sequence;
+    if (age >= (uint32_t)frames_) {
+        statistics_.late++;
+        return false;
+    }
+    uint64_t bit = 1ULL << age;
+    if (seen_ & bit) {
+        statistics_.duplicate++;
+        return false;
+    }
+    seen_ |= bit;
+    statistics_.reordered++;
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef SEQUENCE_WINDOW_H
+#define SEQUENCE_WINDOW_H
+
+#include <cstdint>
+
+#define SEQUENCE_WINDOW_DEFAULT_FRAMES 8
+#define SEQUENCE_WINDOW_MAX_FRAMES 64
+
+struct SequenceWindowStatistics {
+    uint32_t received = 0;
+    uint32_t reordered = 0;     // Arrived after a higher sequence, but inside the window
+    uint32_t duplicate = 0;
+    uint32_t late = 0;          // Older than the window, dropped
+    uint32_t lost = 0;          // Left the window without arriving
+};
+
+/*
+ * Duplicate and replay filter for the UDP downlink sequence numbers.
+ *
+ * Remembers which of the last |frames| sequence numbers have arrived in a bitmap. A packet is
+ * accepted if it is new and not older than the window, so packets reordered by a few frames
+ * are still played; putting them back in order is left to the audio service jitter buffer,
+ * which also knows when a frame is due. Duplicates and packets older than the window are dropped.
+ */
+class SequenceWindow {
+public:
+    explicit SequenceWindow(int frames = SEQUENCE_WINDOW_DEFAULT_FRAMES);
+
+    void SetFrames(int frames);
+    int frames() const { return frames_; }
+    void Reset();
+
+    // Returns false if the packet should be dropped
+    bool Accept(uint32_t sequence);
+
+    const SequenceWindowStatistics& statistics() const { return statistics_; }
+
+private:
+    int frames_;
+    bool started_ = false;
+    uint32_t highest_ = 0;
+    uint64_t seen_ = 0;         // Bit i: highest_ - i has arrived
+    SequenceWindowStatistics statistics_;
+
+    uint64_t mask() const;
+};
+
+#endif // SEQUENCE_WINDOW_H
@@ -0,0 +1,248 @@
+#include "server_message.h"
+
+#include <cstdint>
+
+void ServerMessageParser::SkipWhitespace() {
+    while (cursor_ < end_ && (*cursor_ == ' ' || *cursor_ == '\t' || *cursor_ == '\n' || *cursor_ == '\r')) {
+        cursor_++;
+    }
+}
+
+bool ServerMessageParser::ReadRawString(std::string_view& value) {
+    // Strings with escapes are left to cJSON, they never occur in keys or in type / state / emotion
+    if (cursor_ >= end_ || *cursor_ != '"') {
+        return false;
+    }
+    const char* start = ++cursor_;
+    while (cursor_ < end_ && *cursor_ != '"') {
+        if (*cursor_ == '\\') {
+            return false;
+        }
+        cursor_++;
+    }
+    if (cursor_ >= end_) {
+        return false;
+    }
+    value = std::string_view(start, cursor_ - start);
+    cursor_++;
+    return true;
+}
+
+static int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool ReadHex4(const char* p, const char* end, uint32_t& value) {
+    if (end - p < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        int digit = HexValue(p[i]);
+        if (digit < 0) {
+            return false;
+        }
+        value = (value << 4) | digit;
+    }
+    return true;
+}
+
+bool ServerMessageParser::ReadText() {
+    text_.clear();
+    cursor_++;  // Opening quote
+    while (cursor_ < end_) {
+        // Copy the run up to the next quote or escape in one go
+        const char* run = cursor_;
+        while (cursor_ < end_ && *cursor_ != '"' && *cursor_ != '\\') {
+            cursor_++;
+        }
+        text_.append(run, cursor_ - run);
+        if (cursor_ >= end_) {
+            return false;
+        }
+        if (*cursor_ == '"') {
+            cursor_++;
+            return true;
+        }
+
+        if (++cursor_ >= end_) {
+            return false;
+        }
+        char escape = *cursor_++;
+        switch (escape) {
+        case '"': text_ += '"'; break;
+        case '\\': text_ += '\\'; break;
+        case '/': text_ += '/'; break;
+        case 'b': text_ += '\b'; break;
+        case 'f': text_ += '\f'; break;
+        case 'n': text_ += '\n'; break;
+        case 'r': text_ += '\r'; break;
+        case 't': text_ += '\t'; break;
+        case 'u': {
+            uint32_t code;
+            if (!ReadHex4(cursor_, end_, code)) {
+                return false;
+            }
+            cursor_ += 4;
+            if (code >= 0xD800 && code <= 0xDBFF) {
+                // Surrogate pair, the low half must follow as another \u escape
+                uint32_t low;
+                if (end_ - cursor_ < 6 || cursor_[0] != '\\' || cursor_[1] != 'u' ||
+                    !ReadHex4(cursor_ + 2, end_, low) || low < 0xDC00 || low > 0xDFFF) {
+                    return false;
+                }
+                cursor_ += 6;
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+            } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                return false;
+            }
+            if (code == 0) {
+                return false;
+            }
+            if (code < 0x80) {
+                text_ += (char)code;
+            } else if (code < 0x800) {
+                text_ += (char)(0xC0 | (code >> 6));
+                text_ += (char)(0x80 | (code & 0x3F));
+            } else if (code < 0x10000) {
+                text_ += (char)(0xE0 | (code >> 12));
+                text_ += (char)(0x80 | ((code >> 6) & 0x3F));
+                text_ += (char)(0x80 | (code & 0x3F));
+            } else {
+                text_ += (char)(0xF0 | (code >> 18));
+                text_ += (char)(0x80 | ((code >> 12) & 0x3F));
+                text_ += (char)(0x80 | ((code >> 6) & 0x3F));
+                text_ += (char)(0x80 | (code & 0x3F));
+            }
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+bool ServerMessageParser::SkipValue() {
+    if (cursor_ >= end_) {
+        return false;
+    }
+    if (*cursor_ != '{' && *cursor_ != '[' && *cursor_ != '"') {
+        // Number, true, false or null
+        const char* start = cursor_;
+        while (cursor_ < end_ && *cursor_ != ',' && *cursor_ != '}' && *cursor_ != ']' &&
+               *cursor_ != ' ' && *cursor_ != '\t' && *cursor_ != '\n' && *cursor_ != '\r') {
+            cursor_++;
+        }
+        return cursor_ > start;
+    }
+
+    // Strings, objects and arrays: track nesting, skipping over string contents
+    int depth = 0;
+    do {
+        char c = *cursor_++;
+        if (c == '"') {
+            while (cursor_ < end_ && *cursor_ != '"') {
+                if (*cursor_ == '\\') {
+                    cursor_++;
+                }
+                cursor_++;
+            }
+            if (cursor_ >= end_) {
+                return false;
+            }
+            cursor_++;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+    } while (depth > 0 && cursor_ < end_);
+    return depth == 0;
+}
+
+bool ServerMessageParser::Parse(const char* data, size_t len, ServerMessage& message) {
+    message = ServerMessage();
+    cursor_ = data;
+    end_ = data + len;
+    bool has_text = false;
+
+    SkipWhitespace();
+    if (cursor_ >= end_ || *cursor_ != '{') {
+        return false;
+    }
+    cursor_++;
+    SkipWhitespace();
+    if (cursor_ < end_ && *cursor_ == '}') {
+        return false;
+    }
+
+    while (true) {
+        std::string_view key;
+        SkipWhitespace();
+        if (!ReadRawString(key)) {
+            return false;
+        }
+        SkipWhitespace();
+        if (cursor_ >= end_ || *cursor_ != ':') {
+            return false;
+        }
+        cursor_++;
+        SkipWhitespace();
+        if (cursor_ >= end_) {
+            return false;
+        }
+
+        bool is_string = *cursor_ == '"';
+        if (key == "type") {
+            if (!ReadRawString(message.type)) {
+                return false;
+            }
+        } else if (key == "state" && is_string) {
+            if (!ReadRawString(message.state)) {
+                return false;
+            }
+        } else if (key == "emotion" && is_string) {
+            if (!ReadRawString(message.emotion)) {
+                return false;
+            }
+        } else if (key == "text" && is_string) {
+            if (!ReadText()) {
+                return false;
+            }
+            has_text = true;
+        } else if (!SkipValue()) {
+            return false;
+        }
+
+        SkipWhitespace();
+        if (cursor_ >= end_) {
+            return false;
+        }
+        if (*cursor_ == '}') {
+            cursor_++;
+            break;
+        }
+        if (*cursor_ != ',') {
+            return false;
+        }
+        cursor_++;
+    }
+
+    // Only trailing whitespace (or the terminator of a C string) may follow the object
+    SkipWhitespace();
+    if (cursor_ < end_ && *cursor_ != '\0') {
+        return false;
+    }
+
+    if (message.type != "tts" && message.type != "stt" && message.type != "llm") {
+        return false;
+    }
+    if (has_text) {
+        message.text = text_.c_str();
+    }
+    return true;
+}
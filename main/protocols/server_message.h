@@ -0,0 +1,42 @@
+#ifndef SERVER_MESSAGE_H
+#define SERVER_MESSAGE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/*
+ * The fields of the frequent server messages (tts / stt / llm) that the application acts on.
+ * The views point into the received frame and are only valid during the callback.
+ */
+struct ServerMessage {
+    std::string_view type;
+    std::string_view state;
+    std::string_view emotion;
+    const char* text = nullptr;     // Unescaped and null-terminated, nullptr when absent
+};
+
+/*
+ * Single pass tokenizer for flat JSON server messages. It reads "type", "state", "emotion" and
+ * "text" and skips every other value, without building a cJSON tree. The text is unescaped into a
+ * buffer that keeps its capacity, so a warmed-up parser does not allocate.
+ *
+ * Parse() accepts only the hot message types. Anything else (hello, mcp, system, escaped keys,
+ * malformed input) returns false, and the caller parses the frame with cJSON as before.
+ */
+class ServerMessageParser {
+public:
+    bool Parse(const char* data, size_t len, ServerMessage& message);
+
+private:
+    std::string text_;
+    const char* cursor_ = nullptr;
+    const char* end_ = nullptr;
+
+    void SkipWhitespace();
+    bool ReadRawString(std::string_view& value);
+    bool ReadText();
+    bool SkipValue();
+};
+
+#endif // SERVER_MESSAGE_H
@@ -0,0 +1,55 @@
+#include "udp_audio_cipher.h"
+
+#include <cstring>
+#include <esp_log.h>
+#include <arpa/inet.h>
+
+#define TAG "UdpAudioCipher"
+
+UdpAudioCipher::UdpAudioCipher() {
+    mbedtls_aes_init(&aes_ctx_);
+}
+
+UdpAudioCipher::~UdpAudioCipher() {
+    mbedtls_aes_free(&aes_ctx_);
+}
+
+bool UdpAudioCipher::SetKey(const std::string& key, const std::string& nonce) {
+    if (key.size() != 16 || nonce.size() != UDP_AUDIO_HEADER_SIZE) {
+        ESP_LOGE(TAG, "Invalid key (%u bytes) or nonce (%u bytes)", key.size(), nonce.size());
+        return false;
+    }
+    memcpy(nonce_, nonce.data(), UDP_AUDIO_HEADER_SIZE);
+    return mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)key.data(), 128) == 0;
+}
+
+bool UdpAudioCipher::Encrypt(const uint8_t* payload, size_t size, uint32_t timestamp, uint32_t sequence, std::string& datagram) {
+    datagram.resize(UDP_AUDIO_HEADER_SIZE + size);
+    auto header = (uint8_t*)datagram.data();
+    memcpy(header, nonce_, UDP_AUDIO_HEADER_SIZE);
+    *(uint16_t*)&header[2] = htons(size);
+    *(uint32_t*)&header[8] = htonl(timestamp);
+    *(uint32_t*)&header[12] = htonl(sequence);
+
+    // The counter block is advanced by mbedtls, so it must not be the header in the datagram
+    uint8_t counter[UDP_AUDIO_HEADER_SIZE];
+    memcpy(counter, header, UDP_AUDIO_HEADER_SIZE);
+    size_t nc_off = 0;
+    uint8_t stream_block[16];
+    return mbedtls_aes_crypt_ctr(&aes_ctx_, size, &nc_off, counter, stream_block,
+        payload, header + UDP_AUDIO_HEADER_SIZE) == 0;
+}
+
+bool UdpAudioCipher::Decrypt(const uint8_t* datagram, size_t size, std::vector<uint8_t>& payload) {
+    if (size < UDP_AUDIO_HEADER_SIZE) {
+        return false;
+    }
+    uint8_t counter[UDP_AUDIO_HEADER_SIZE];
+    memcpy(counter, datagram, UDP_AUDIO_HEADER_SIZE);
+    size_t payload_size = size - UDP_AUDIO_HEADER_SIZE;
+    payload.resize(payload_size);
+    size_t nc_off = 0;
+    uint8_t stream_block[16];
+    return mbedtls_aes_crypt_ctr(&aes_ctx_, payload_size, &nc_off, counter, stream_block,
+        datagram + UDP_AUDIO_HEADER_SIZE, payload.data()) == 0;
+}
@@ -0,0 +1,40 @@
+#ifndef UDP_AUDIO_CIPHER_H
+#define UDP_AUDIO_CIPHER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <mbedtls/aes.h>
+
+#define UDP_AUDIO_HEADER_SIZE 16
+
+/*
+ * AES-128-CTR framing of the MQTT+UDP audio datagrams:
+ * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|payload payload_len|
+ * The 16 byte header is also the initial counter block.
+ *
+ * Encrypt() writes the header and cipher text straight into a caller owned datagram buffer and
+ * Decrypt() writes the plain text straight into the packet payload. Both reuse the capacity of
+ * those buffers, and the counter block lives on the stack, so steady-state packets do not allocate.
+ * mbedtls_aes_crypt_ctr runs on the AES peripheral (with DMA on targets that have it) when
+ * CONFIG_MBEDTLS_HARDWARE_AES is enabled, which is the IDF default.
+ */
+class UdpAudioCipher {
+public:
+    UdpAudioCipher();
+    ~UdpAudioCipher();
+
+    // |key| and |nonce| are the raw bytes from the server hello
+    bool SetKey(const std::string& key, const std::string& nonce);
+
+    bool Encrypt(const uint8_t* payload, size_t size, uint32_t timestamp, uint32_t sequence, std::string& datagram);
+    bool Decrypt(const uint8_t* datagram, size_t size, std::vector<uint8_t>& payload);
+
+private:
+    mbedtls_aes_context aes_ctx_;
+    uint8_t nonce_[UDP_AUDIO_HEADER_SIZE] = {0};
+};
+
+#endif // UDP_AUDIO_CIPHER_H
@@ -1,9 +1,11 @@
 #include "websocket_protocol.h"
+#include "audio_batch.h"
 #include "board.h"
 #include "system_info.h"
 #include "application.h"
 #include "settings.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cJSON.h>
 #include <esp_log.h>
@@ -25,36 +27,119 @@ bool WebsocketProtocol::Start() {
     return true;
 }
 
-bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
-    if (websocket_ == nullptr || !websocket_->IsConnected()) {
-        return false;
+int WebsocketProtocol::GetBatchFrames() const {
+    // Realtime conversations need every frame as soon as it is encoded
+    if (max_batch_frames_ <= 1 || listening_mode_ == kListeningModeRealtime) {
+        return 1;
     }
+    // Nothing happens on the server until the button is released, so batch as much as allowed
+    if (listening_mode_ == kListeningModeManualStop) {
+        return max_batch_frames_;
+    }
+    // Otherwise delay the server VAD by at most about one round trip
+    return std::clamp(hello_rtt_ms_ / OPUS_FRAME_DURATION_MS, 1, max_batch_frames_);
+}
 
+bool WebsocketProtocol::FlushAudioBatch() {
+    if (batch_frames_pending_ == 0) {
+        return true;
+    }
+    size_t payload_size = batch_buffer_.size() - (version_ == 2 ? sizeof(BinaryProtocol2) : sizeof(BinaryProtocol3));
     if (version_ == 2) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol2) + packet->payload.size());
-        auto bp2 = (BinaryProtocol2*)serialized.data();
+        auto bp2 = (BinaryProtocol2*)batch_buffer_.data();
         bp2->version = htons(version_);
-        bp2->type = 0;
+        bp2->type = htons(WEBSOCKET_BINARY_TYPE_OPUS_BATCH);
         bp2->reserved = 0;
-        bp2->timestamp = htonl(packet->timestamp);
-        bp2->payload_size = htonl(packet->payload.size());
-        memcpy(bp2->payload, packet->payload.data(), packet->payload.size());
-
-        return websocket_->Send(serialized.data(), serialized.size(), true);
-    } else if (version_ == 3) {
-        std::string serialized;
-        serialized.resize(sizeof(BinaryProtocol3) + packet->payload.size());
-        auto bp3 = (BinaryProtocol3*)serialized.data();
-        bp3->type = 0;
+        bp2->timestamp = htonl(batch_timestamp_);
+        bp2->payload_size = htonl(payload_size);
+    } else {
+        auto bp3 = (BinaryProtocol3*)batch_buffer_.data();
+        bp3->type = WEBSOCKET_BINARY_TYPE_OPUS_BATCH;
         bp3->reserved = 0;
-        bp3->payload_size = htons(packet->payload.size());
-        memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
+        bp3->payload_size = htons(payload_size);
+    }
+    int frames = batch_frames_pending_;
+    batch_frames_pending_ = 0;
+    if (!websocket_->Send(batch_buffer_.data(), batch_buffer_.size(), true)) {
+        return false;
+    }
+    RecordSentAudio(batch_audio_bytes_, frames);
+    return true;
+}
+
+bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return false;
+    }
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    int batch_frames = GetBatchFrames();
+    if (batch_frames > 1) {
+        /*
+         * Batched frames: one header, then |length 2u|opus length| per frame. A v2 header carries
+         * the timestamp of the first frame and the receiver puts the following ones one frame
+         * duration apart, or leaves them all 0. A frame whose own timestamp does not fit that
+         * (e.g. after the send queue dropped frames) starts a new batch.
+         */
+        if (batch_frames_pending_ > 0 && version_ == 2) {
+            uint32_t expected = batch_timestamp_ == 0 ? 0 : batch_timestamp_ + batch_frames_pending_ * packet->frame_duration;
+            if (packet->timestamp != expected && !FlushAudioBatch()) {
+                return false;
+            }
+        }
+        if (batch_frames_pending_ == 0) {
+            batch_buffer_.resize(version_ == 2 ? sizeof(BinaryProtocol2) : sizeof(BinaryProtocol3));
+            batch_timestamp_ = packet->timestamp;
+            batch_audio_bytes_ = 0;
+        }
+        AudioBatch::Append(batch_buffer_, packet->opus_data(), packet->opus_size());
+        batch_audio_bytes_ += packet->opus_size();
+        if (++batch_frames_pending_ >= batch_frames) {
+            return FlushAudioBatch();
+        }
+        return true;
+    }
+    // Switched to per frame sending (e.g. realtime mode) with frames still waiting
+    if (!FlushAudioBatch()) {
+        return false;
+    }
+
+    bool sent;
+    if (version_ == 2) {
+        BinaryProtocol2 bp2;
+        bp2.version = htons(version_);
+        bp2.type = 0;
+        bp2.reserved = 0;
+        bp2.timestamp = htonl(packet->timestamp);
+        bp2.payload_size = htonl(packet->opus_size());
+        sent = SendAudioFrame(*packet, &bp2, sizeof(bp2));
+    } else if (version_ == 3) {
+        BinaryProtocol3 bp3;
+        bp3.type = 0;
+        bp3.reserved = 0;
+        bp3.payload_size = htons(packet->opus_size());
+        sent = SendAudioFrame(*packet, &bp3, sizeof(bp3));
     } else {
-        return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
+        sent = websocket_->Send(packet->opus_data(), packet->opus_size(), true);
+    }
+    // Counted once on the wire, like MqttProtocol
+    if (sent) {
+        RecordSentAudio(packet->opus_size());
     }
+    return sent;
+}
+
+bool WebsocketProtocol::SendAudioFrame(AudioStreamPacket& packet, const void* header, size_t header_size) {
+    // Uplink packets have room for the header in front of the opus data, others (the wake word) are copied
+    if (packet.headroom >= header_size) {
+        uint8_t* frame = packet.payload.data() + packet.headroom - header_size;
+        memcpy(frame, header, header_size);
+        return websocket_->Send(frame, header_size + packet.opus_size(), true);
+    }
+    send_buffer_.resize(header_size + packet.opus_size());
+    memcpy(send_buffer_.data(), header, header_size);
+    memcpy(send_buffer_.data() + header_size, packet.opus_data(), packet.opus_size());
+    return websocket_->Send(send_buffer_.data(), send_buffer_.size(), true);
 }
 
 bool WebsocketProtocol::SendText(const std::string& text) {
@@ -62,6 +147,12 @@ bool WebsocketProtocol::SendText(const std::string& text) {
         return false;
     }
 
+    {
+        // Audio captured before this message (e.g. before a stop listening) must reach the server first
+        std::lock_guard<std::mutex> lock(batch_mutex_);
+        FlushAudioBatch();
+    }
+
     if (!websocket_->Send(text)) {
         ESP_LOGE(TAG, "Failed to send text: %s", text.c_str());
         SetError(Lang::Strings::SERVER_ERROR);
@@ -71,10 +162,74 @@ bool WebsocketProtocol::SendText(const std::string& text) {
     return true;
 }
 
+bool WebsocketProtocol::SendText(size_t size, const TextProducer& producer) {
+    if (size <= WEBSOCKET_TEXT_FRAGMENT_SIZE) {
+        return Protocol::SendText(size, producer);
+    }
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return false;
+    }
+
+    // Held until the last fragment, no audio frame may be sent in the middle of the message
+    std::lock_guard<std::mutex> lock(batch_mutex_);
+    FlushAudioBatch();
+
+    // A full fragment is only sent once more data follows, so the final frame is never empty
+    std::string fragment;
+    fragment.reserve(WEBSOCKET_TEXT_FRAGMENT_SIZE);
+    size_t fragments = 0;
+    bool produced = producer([this, &fragment, &fragments](const char* data, size_t size) {
+        while (size > 0) {
+            if (fragment.size() == WEBSOCKET_TEXT_FRAGMENT_SIZE) {
+                if (!websocket_->Send(fragment.data(), fragment.size(), false, false)) {
+                    return false;
+                }
+                fragment.clear();
+                fragments++;
+            }
+            size_t length = std::min(size, WEBSOCKET_TEXT_FRAGMENT_SIZE - fragment.size());
+            fragment.append(data, length);
+            data += length;
+            size -= length;
+        }
+        return true;
+    });
+    if (!produced || !websocket_->Send(fragment.data(), fragment.size(), false, true)) {
+        ESP_LOGE(TAG, "Failed to send text of %u bytes after %u fragments", size, fragments);
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+    return true;
+}
+
 bool WebsocketProtocol::IsAudioChannelOpened() const {
     return websocket_ != nullptr && websocket_->IsConnected() && !error_occurred_ && !IsTimeout();
 }
 
+void WebsocketProtocol::ParseAudioBatch(const uint8_t* data, size_t size, uint32_t timestamp) {
+    int index = 0;
+    bool valid = AudioBatch::ForEach(data, size, [this, timestamp, &index](const uint8_t* frame, size_t frame_size) {
+        auto packet = AudioStreamPacket::Create();
+        packet->sample_rate = server_sample_rate_;
+        packet->frame_duration = server_frame_duration_;
+        packet->timestamp = timestamp != 0 ? timestamp + index * server_frame_duration_ : 0;
+        packet->payload.assign(frame, frame + frame_size);
+        on_incoming_audio_(std::move(packet));
+        index++;
+    });
+    if (!valid) {
+        ESP_LOGE(TAG, "Invalid audio batch of %u bytes, frame %d exceeds the message", size, index);
+    }
+}
+
+void WebsocketProtocol::SendStartListening(ListeningMode mode) {
+    {
+        std::lock_guard<std::mutex> lock(batch_mutex_);
+        listening_mode_ = mode;
+    }
+    Protocol::SendStartListening(mode);
+}
+
 void WebsocketProtocol::CloseAudioChannel() {
     websocket_.reset();
 }
@@ -88,7 +243,10 @@ bool WebsocketProtocol::OpenAudioChannel() {
         version_ = version;
     }
 
+    ResetMetrics();
     error_occurred_ = false;
+    max_batch_frames_ = 1;
+    batch_frames_pending_ = 0;
 
     auto network = Board::GetInstance().GetNetwork();
     websocket_ = network->CreateWebSocket(1);
@@ -111,40 +269,60 @@ bool WebsocketProtocol::OpenAudioChannel() {
     websocket_->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
             if (on_incoming_audio_ != nullptr) {
+                // The websocket reuses |data| after this callback returns, so the payload is copied
+                // once into a pooled packet, whose buffer keeps its capacity between frames
                 if (version_ == 2) {
-                    BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
-                    bp2->version = ntohs(bp2->version);
-                    bp2->type = ntohs(bp2->type);
-                    bp2->timestamp = ntohl(bp2->timestamp);
-                    bp2->payload_size = ntohl(bp2->payload_size);
-                    auto payload = (uint8_t*)bp2->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = bp2->timestamp,
-                        .payload = std::vector<uint8_t>(payload, payload + bp2->payload_size)
-                    }));
+                    // The header is only read once the frame is known to hold it
+                    if (len < sizeof(BinaryProtocol2)) {
+                        ESP_LOGE(TAG, "Invalid audio frame, len: %u", len);
+                        return;
+                    }
+                    auto bp2 = (const BinaryProtocol2*)data;
+                    size_t payload_size = ntohl(bp2->payload_size);
+                    if (payload_size > len - sizeof(BinaryProtocol2)) {
+                        ESP_LOGE(TAG, "Invalid audio frame, len: %u, payload size: %u", len, payload_size);
+                        return;
+                    }
+                    if (ntohs(bp2->type) == WEBSOCKET_BINARY_TYPE_OPUS_BATCH) {
+                        ParseAudioBatch(bp2->payload, payload_size, ntohl(bp2->timestamp));
+                    } else {
+                        auto packet = AudioStreamPacket::Create();
+                        packet->sample_rate = server_sample_rate_;
+                        packet->frame_duration = server_frame_duration_;
+                        packet->timestamp = ntohl(bp2->timestamp);
+                        packet->payload.assign(bp2->payload, bp2->payload + payload_size);
+                        on_incoming_audio_(std::move(packet));
+                    }
                 } else if (version_ == 3) {
-                    BinaryProtocol3* bp3 = (BinaryProtocol3*)data;
-                    bp3->type = bp3->type;
-                    bp3->payload_size = ntohs(bp3->payload_size);
-                    auto payload = (uint8_t*)bp3->payload;
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>(payload, payload + bp3->payload_size)
-                    }));
+                    // The header is only read once the frame is known to hold it
+                    if (len < sizeof(BinaryProtocol3)) {
+                        ESP_LOGE(TAG, "Invalid audio frame, len: %u", len);
+                        return;
+                    }
+                    auto bp3 = (const BinaryProtocol3*)data;
+                    size_t payload_size = ntohs(bp3->payload_size);
+                    if (payload_size > len - sizeof(BinaryProtocol3)) {
+                        ESP_LOGE(TAG, "Invalid audio frame, len: %u, payload size: %u", len, payload_size);
+                        return;
+                    }
+                    if (bp3->type == WEBSOCKET_BINARY_TYPE_OPUS_BATCH) {
+                        ParseAudioBatch(bp3->payload, payload_size, 0);
+                    } else {
+                        auto packet = AudioStreamPacket::Create();
+                        packet->sample_rate = server_sample_rate_;
+                        packet->frame_duration = server_frame_duration_;
+                        packet->payload.assign(bp3->payload, bp3->payload + payload_size);
+                        on_incoming_audio_(std::move(packet));
+                    }
                 } else {
-                    on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
-                        .sample_rate = server_sample_rate_,
-                        .frame_duration = server_frame_duration_,
-                        .timestamp = 0,
-                        .payload = std::vector<uint8_t>((uint8_t*)data, (uint8_t*)data + len)
-                    }));
+                    auto packet = AudioStreamPacket::Create();
+                    packet->sample_rate = server_sample_rate_;
+                    packet->frame_duration = server_frame_duration_;
+                    packet->payload.assign((uint8_t*)data, (uint8_t*)data + len);
+                    on_incoming_audio_(std::move(packet));
                 }
             }
-        } else {
+        } else if (!DispatchServerMessage(data, len)) {
             // Parse JSON data
             auto root = cJSON_Parse(data);
             auto type = cJSON_GetObjectItem(root, "type");
@@ -180,6 +358,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
 
     // Send hello message to describe the client
     auto message = GetHelloMessage();
+    int64_t hello_time = esp_timer_get_time();
     if (!SendText(message)) {
         return false;
     }
@@ -191,6 +370,12 @@ bool WebsocketProtocol::OpenAudioChannel() {
         SetError(Lang::Strings::SERVER_TIMEOUT);
         return false;
     }
+    // The hello exchange is the round trip the audio batch size is based on
+    hello_rtt_ms_ = (esp_timer_get_time() - hello_time) / 1000;
+    if (max_batch_frames_ > 1) {
+        ESP_LOGI(TAG, "Audio batching up to %d frames, hello round trip %d ms", max_batch_frames_, hello_rtt_ms_);
+    }
+    SetChannelOpened();
 
     if (on_audio_channel_opened_ != nullptr) {
         on_audio_channel_opened_();
@@ -209,6 +394,10 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddBoolToObject(features, "aec", true);
 #endif
     cJSON_AddBoolToObject(features, "mcp", true);
+    if (version_ >= 2) {
+        // Batched frames are marked in the binary header, which version 1 does not have
+        cJSON_AddNumberToObject(features, "audio_batch", WEBSOCKET_AUDIO_BATCH_MAX_FRAMES);
+    }
     cJSON_AddItemToObject(root, "features", features);
     cJSON_AddStringToObject(root, "transport", "websocket");
     cJSON* audio_params = cJSON_CreateObject();
@@ -249,5 +438,11 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         }
     }
 
+    auto features = cJSON_GetObjectItem(root, "features");
+    auto audio_batch = cJSON_GetObjectItem(features, "audio_batch");
+    if (version_ >= 2 && cJSON_IsNumber(audio_batch)) {
+        max_batch_frames_ = std::clamp(audio_batch->valueint, 1, WEBSOCKET_AUDIO_BATCH_MAX_FRAMES);
+    }
+
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
 }
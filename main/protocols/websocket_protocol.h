@@ -5,10 +5,19 @@
 #include "protocol.h"
 
 #include <web_socket.h>
+#include <mutex>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
+// Large text messages are sent as continuation frames of this size
+#define WEBSOCKET_TEXT_FRAGMENT_SIZE 4096
+
+// Binary message types in the BinaryProtocol2 / BinaryProtocol3 header
+#define WEBSOCKET_BINARY_TYPE_OPUS 0
+#define WEBSOCKET_BINARY_TYPE_OPUS_BATCH 2
+// Most opus frames packed into one binary message, offered to the server in the hello
+#define WEBSOCKET_AUDIO_BATCH_MAX_FRAMES 5
 
 class WebsocketProtocol : public Protocol {
 public:
@@ -20,14 +29,36 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void SendStartListening(ListeningMode mode) override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
+    // Only used by SendAudio(), which is called from the send loop alone, for packets without
+    // header headroom. Keeps its capacity, so framing them does not allocate.
+    std::vector<uint8_t> send_buffer_;
+
+    // Audio batching, negotiated in the hello. Frames wait in batch_buffer_ until the batch is full
+    // or a text message is sent, so audio and control messages keep their order.
+    std::mutex batch_mutex_;
+    std::vector<uint8_t> batch_buffer_;
+    int batch_frames_pending_ = 0;
+    uint32_t batch_audio_bytes_ = 0;  // Opus bytes of the pending frames, for the metrics
+    uint32_t batch_timestamp_ = 0;
+    int max_batch_frames_ = 1;
+    int hello_rtt_ms_ = 0;
+    ListeningMode listening_mode_ = kListeningModeAutoStop;
+
+    int GetBatchFrames() const;
+    bool FlushAudioBatch();
+    // Writes |header| in front of the opus data and sends the frame
+    bool SendAudioFrame(AudioStreamPacket& packet, const void* header, size_t header_size);
+    void ParseAudioBatch(const uint8_t* data, size_t size, uint32_t timestamp);
 
     void ParseServerHello(const cJSON* root);
     bool SendText(const std::string& text) override;
+    bool SendText(size_t size, const TextProducer& producer) override;
     std::string GetHelloMessage();
 };
 
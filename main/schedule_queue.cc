@@ -0,0 +1,91 @@
+#include "schedule_queue.h"
+
+#include <esp_log.h>
+
+#define TAG "Schedule"
+
+bool ScheduleQueue::PopTask(SchedulePriority priority, Task& task) {
+    if (PopFromRing(priority, task)) {
+        return true;
+    }
+    // The ring is drained, so everything left in the overflow list is next in line
+    Lane& lane = lanes_[priority];
+    if (!lane.overflow_pending.load(std::memory_order_acquire)) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(lane.overflow_mutex);
+    if (lane.overflow.empty()) {
+        lane.overflow_pending.store(false, std::memory_order_release);
+        return false;
+    }
+    task = std::move(lane.overflow.front());
+    lane.overflow.pop_front();
+    if (lane.overflow.empty()) {
+        lane.overflow_pending.store(false, std::memory_order_release);
+    }
+    return true;
+}
+
+size_t ScheduleQueue::PendingCount(SchedulePriority priority) {
+    size_t count = RingSize(priority);
+    Lane& lane = lanes_[priority];
+    if (lane.overflow_pending.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(lane.overflow_mutex);
+        count += lane.overflow.size();
+    }
+    if (count > lane.statistics.peak) {
+        lane.statistics.peak = count;
+    }
+    return count;
+}
+
+void ScheduleQueue::Run(SchedulePriority priority, Task& task) {
+    auto& statistics = lanes_[priority].statistics;
+    int64_t start_time = esp_timer_get_time();
+    uint32_t wait_us = start_time - task.time_us;
+    if (task.callback.on_heap()) {
+        statistics.heap_callables++;
+    }
+    task.callback();
+    // Release the captures now rather than when the slot is reused
+    task.callback.Reset();
+    uint32_t run_us = esp_timer_get_time() - start_time;
+
+    statistics.executed++;
+    statistics.total_wait_us += wait_us;
+    if (wait_us > statistics.max_wait_us) {
+        statistics.max_wait_us = wait_us;
+    }
+    if (run_us > statistics.max_run_us) {
+        statistics.max_run_us = run_us;
+    }
+}
+
+void ScheduleQueue::RunHighLane() {
+    Task task;
+    for (size_t count = PendingCount(kSchedulePriorityHigh); count > 0 && PopTask(kSchedulePriorityHigh, task); count--) {
+        Run(kSchedulePriorityHigh, task);
+    }
+}
+
+void ScheduleQueue::RunPending() {
+    RunHighLane();
+    // Tasks scheduled while these run are left for the next wake up, so a task that schedules
+    // itself cannot starve the other main loop events
+    Task task;
+    for (size_t count = PendingCount(kSchedulePriorityNormal); count > 0 && PopTask(kSchedulePriorityNormal, task); count--) {
+        Run(kSchedulePriorityNormal, task);
+        RunHighLane();
+    }
+}
+
+void ScheduleQueue::PrintStatistics() {
+    static const char* const kLaneNames[] = {"high", "normal"};
+    for (int i = 0; i < kSchedulePriorityCount; i++) {
+        auto& statistics = lanes_[i].statistics;
+        uint32_t average_wait_us = statistics.executed > 0 ? statistics.total_wait_us / statistics.executed : 0;
+        ESP_LOGI(TAG, "%s lane: %lu tasks, wait avg %lu us max %lu us, run max %lu us, peak %u, heap %lu, overflows %lu",
+            kLaneNames[i], statistics.executed, average_wait_us, statistics.max_wait_us, statistics.max_run_us,
+            statistics.peak, statistics.heap_callables, statistics.overflows);
+    }
+}
@@ -0,0 +1,271 @@
+#ifndef SCHEDULE_QUEUE_H
+#define SCHEDULE_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <esp_timer.h>
+
+// Captures up to this size (e.g. this + a pointer + a std::string) are stored without allocating
+#define SCHEDULE_INLINE_SIZE 40
+#define SCHEDULE_HIGH_LANE_CAPACITY 16
+#define SCHEDULE_NORMAL_LANE_CAPACITY 32
+
+/*
+ * Move-only void() callable with a small inline buffer. Callables that fit SCHEDULE_INLINE_SIZE are
+ * constructed in place; larger ones fall back to the heap, which on_heap() reports.
+ */
+class SmallFunction {
+public:
+    SmallFunction() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, SmallFunction>>>
+    SmallFunction(F&& callable) {
+        using Callable = std::decay_t<F>;
+        if constexpr (sizeof(Callable) <= SCHEDULE_INLINE_SIZE && alignof(Callable) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<Callable>) {
+            new (storage_) Callable(std::forward<F>(callable));
+            ops_ = &kInlineOps<Callable>;
+        } else {
+            *reinterpret_cast<Callable**>(storage_) = new Callable(std::forward<F>(callable));
+            ops_ = &kHeapOps<Callable>;
+        }
+    }
+
+    SmallFunction(SmallFunction&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    SmallFunction& operator=(SmallFunction&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    SmallFunction(const SmallFunction&) = delete;
+    SmallFunction& operator=(const SmallFunction&) = delete;
+
+    ~SmallFunction() {
+        Reset();
+    }
+
+    explicit operator bool() const { return ops_ != nullptr; }
+    bool on_heap() const { return ops_ != nullptr && ops_->on_heap; }
+
+    void operator()() {
+        ops_->invoke(storage_);
+    }
+
+    void Reset() {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* from, void* to);
+        void (*destroy)(void* storage);
+        bool on_heap;
+    };
+
+    template <typename Callable>
+    static constexpr Ops kInlineOps = {
+        [](void* storage) { (*static_cast<Callable*>(storage))(); },
+        [](void* from, void* to) {
+            new (to) Callable(std::move(*static_cast<Callable*>(from)));
+            static_cast<Callable*>(from)->~Callable();
+        },
+        [](void* storage) { static_cast<Callable*>(storage)->~Callable(); },
+        false,
+    };
+
+    template <typename Callable>
+    static constexpr Ops kHeapOps = {
+        [](void* storage) { (**static_cast<Callable**>(storage))(); },
+        [](void* from, void* to) { *static_cast<Callable**>(to) = *static_cast<Callable**>(from); },
+        [](void* storage) { delete *static_cast<Callable**>(storage); },
+        true,
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[SCHEDULE_INLINE_SIZE];
+    const Ops* ops_ = nullptr;
+
+    void MoveFrom(SmallFunction& other) {
+        if (other.ops_ != nullptr) {
+            other.ops_->move(other.storage_, storage_);
+            ops_ = other.ops_;
+            other.ops_ = nullptr;
+        }
+    }
+};
+
+/*
+ * Bounded multi-producer / single-consumer ring (Vyukov's sequence-per-cell queue).
+ *
+ * Producers claim a cell with a compare-and-swap on the write position and publish it by
+ * advancing the cell's sequence, so Push() never blocks on another task. A producer preempted
+ * between the two steps only hides its own cell (and the ones after it) from the consumer until
+ * it resumes. Pop() must only be called from one task. Storage is preallocated.
+ */
+template <typename T, size_t Capacity>
+class MpscRing {
+public:
+    MpscRing() {
+        for (uint32_t i = 0; i < kCapacity; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false if the ring is full
+    bool Push(T&& item) {
+        uint32_t position = enqueue_position_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[position & kMask];
+            uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+            int32_t diff = static_cast<int32_t>(sequence - position);
+            if (diff == 0) {
+                if (enqueue_position_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = enqueue_position_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(item);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(T& item) {
+        uint32_t position = dequeue_position_.load(std::memory_order_relaxed);
+        Cell& cell = cells_[position & kMask];
+        uint32_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<int32_t>(sequence - (position + 1)) < 0) {
+            return false;
+        }
+        item = std::move(cell.value);
+        cell.value = T();
+        cell.sequence.store(position + kCapacity, std::memory_order_release);
+        dequeue_position_.store(position + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Approximate when producers are active
+    size_t size() const {
+        return enqueue_position_.load(std::memory_order_relaxed) - dequeue_position_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr uint32_t RoundUp(uint32_t n) {
+        uint32_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+    static constexpr uint32_t kCapacity = RoundUp(Capacity);
+    static constexpr uint32_t kMask = kCapacity - 1;
+
+    struct Cell {
+        std::atomic<uint32_t> sequence;
+        T value;
+    };
+
+    std::array<Cell, kCapacity> cells_;
+    std::atomic<uint32_t> enqueue_position_ = 0;
+    std::atomic<uint32_t> dequeue_position_ = 0;
+};
+
+enum SchedulePriority {
+    kSchedulePriorityHigh,      // State changes and other short tasks that must not wait behind slow ones
+    kSchedulePriorityNormal,
+    kSchedulePriorityCount
+};
+
+struct ScheduleLaneStatistics {
+    uint32_t executed = 0;
+    uint32_t heap_callables = 0;    // Captures too large for the inline buffer
+    uint32_t overflows = 0;         // Lane was full, the task went through the locked overflow list
+    uint32_t max_wait_us = 0;       // Schedule() to start of execution
+    uint32_t max_run_us = 0;
+    uint64_t total_wait_us = 0;
+    size_t peak = 0;
+};
+
+/*
+ * The main event loop's task queue. Any task may push, only the main loop runs tasks.
+ *
+ * Each priority has its own lock-free lane. RunPending() drains the high lane first and checks it
+ * again before every normal task, so a state change scheduled behind a slow tool call runs as soon
+ * as that call returns. A full lane spills into a mutex protected list, which keeps the order of
+ * each producer's tasks and is only used under bursts.
+ */
+class ScheduleQueue {
+public:
+    template <typename F>
+    void Push(F&& callback, SchedulePriority priority) {
+        Task task;
+        task.callback = SmallFunction(std::forward<F>(callback));
+        task.time_us = esp_timer_get_time();
+        Lane& lane = lanes_[priority];
+        if (lane.overflow_pending.load(std::memory_order_acquire) || !PushToRing(priority, std::move(task))) {
+            std::lock_guard<std::mutex> lock(lane.overflow_mutex);
+            lane.statistics.overflows++;
+            lane.overflow.push_back(std::move(task));
+            lane.overflow_pending.store(true, std::memory_order_release);
+        }
+    }
+
+    // Main loop only
+    void RunPending();
+    void PrintStatistics();
+    const ScheduleLaneStatistics& statistics(SchedulePriority priority) const { return lanes_[priority].statistics; }
+
+private:
+    struct Task {
+        SmallFunction callback;
+        int64_t time_us = 0;
+    };
+
+    struct Lane {
+        std::mutex overflow_mutex;
+        std::deque<Task> overflow;
+        std::atomic<bool> overflow_pending = false;
+        ScheduleLaneStatistics statistics;
+    };
+
+    MpscRing<Task, SCHEDULE_HIGH_LANE_CAPACITY> high_ring_;
+    MpscRing<Task, SCHEDULE_NORMAL_LANE_CAPACITY> normal_ring_;
+    std::array<Lane, kSchedulePriorityCount> lanes_;
+
+    bool PushToRing(SchedulePriority priority, Task&& task) {
+        return priority == kSchedulePriorityHigh ? high_ring_.Push(std::move(task)) : normal_ring_.Push(std::move(task));
+    }
+    bool PopFromRing(SchedulePriority priority, Task& task) {
+        return priority == kSchedulePriorityHigh ? high_ring_.Pop(task) : normal_ring_.Pop(task);
+    }
+    size_t RingSize(SchedulePriority priority) const {
+        return priority == kSchedulePriorityHigh ? high_ring_.size() : normal_ring_.size();
+    }
+    bool PopTask(SchedulePriority priority, Task& task);
+    size_t PendingCount(SchedulePriority priority);
+    void RunHighLane();
+    void Run(SchedulePriority priority, Task& task);
+};
+
+#endif // SCHEDULE_QUEUE_H
@@ -0,0 +1,128 @@
+#include "timer_service.h"
+
+#include <algorithm>
+#include <esp_log.h>
+
+#define TAG "TimerService"
+// Stack of the per-delay FreeRTOS tasks the service replaced, for the comparison in PrintStatistics()
+#define DELAY_TASK_STACK_SIZE 2048
+
+TimerService::TimerService(std::function<void(SmallFunction&&)> dispatcher) : dispatcher_(std::move(dispatcher)) {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<TimerService*>(arg)->OnTimer();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "timer_service",
+        .skip_unhandled_events = true
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_handle_));
+}
+
+TimerService::~TimerService() {
+    if (timer_handle_ != nullptr) {
+        esp_timer_stop(timer_handle_);
+        esp_timer_delete(timer_handle_);
+    }
+}
+
+TimerService::Handle TimerService::Add(uint32_t delay_ms, SmallFunction&& callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = esp_timer_get_time();
+    Entry entry;
+    entry.deadline_us = now + (int64_t)delay_ms * 1000;
+    entry.handle = next_handle_++;
+    if (next_handle_ == 0) {
+        next_handle_ = 1;
+    }
+    entry.callback = std::move(callback);
+    Handle handle = entry.handle;
+
+    // Equal deadlines keep the order they were added in
+    auto position = std::upper_bound(entries_.begin(), entries_.end(), entry.deadline_us,
+        [](int64_t deadline_us, const Entry& e) { return deadline_us < e.deadline_us; });
+    bool earliest = position == entries_.begin();
+    entries_.insert(position, std::move(entry));
+    peak_entries_ = std::max(peak_entries_, entries_.size() + dispatched_entries_.size());
+    if (earliest) {
+        Arm(now);
+    }
+    return handle;
+}
+
+bool TimerService::Cancel(Handle handle) {
+    if (handle == 0) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto matches = [handle](const Entry& e) { return e.handle == handle; };
+    auto it = std::find_if(entries_.begin(), entries_.end(), matches);
+    if (it != entries_.end()) {
+        // The timer stays armed for the removed deadline at worst, OnTimer() then finds nothing due and re-arms
+        entries_.erase(it);
+        cancelled_++;
+        return true;
+    }
+    // Already dispatched, Run() finds nothing when the main loop gets to it
+    it = std::find_if(dispatched_entries_.begin(), dispatched_entries_.end(), matches);
+    if (it != dispatched_entries_.end()) {
+        dispatched_entries_.erase(it);
+        cancelled_++;
+        return true;
+    }
+    return false;
+}
+
+void TimerService::Arm(int64_t now_us) {
+    esp_timer_stop(timer_handle_);
+    if (!entries_.empty()) {
+        int64_t delay_us = std::max<int64_t>(entries_.front().deadline_us - now_us, 0);
+        esp_timer_start_once(timer_handle_, delay_us);
+    }
+}
+
+void TimerService::OnTimer() {
+    std::vector<Handle> due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now = esp_timer_get_time();
+        auto it = entries_.begin();
+        while (it != entries_.end() && it->deadline_us <= now) {
+            max_late_us_ = std::max<uint32_t>(max_late_us_, now - it->deadline_us);
+            due.push_back(it->handle);
+            dispatched_entries_.push_back(std::move(*it));
+            ++it;
+        }
+        entries_.erase(entries_.begin(), it);
+        dispatched_ += due.size();
+        Arm(now);
+    }
+    // Only the handle goes through the dispatcher, the callback is taken out when it runs
+    for (auto handle : due) {
+        dispatcher_([this, handle]() { Run(handle); });
+    }
+}
+
+void TimerService::Run(Handle handle) {
+    SmallFunction callback;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = std::find_if(dispatched_entries_.begin(), dispatched_entries_.end(),
+            [handle](const Entry& e) { return e.handle == handle; });
+        if (it == dispatched_entries_.end()) {
+            return;
+        }
+        callback = std::move(it->callback);
+        dispatched_entries_.erase(it);
+    }
+    callback();
+}
+
+void TimerService::PrintStatistics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // With a task per delay, the peak would have been as many extra tasks and their stacks on the heap
+    ESP_LOGI(TAG, "%u pending (peak %u, %u tasks / %u bytes of stack as delay tasks), %lu dispatched, %lu cancelled, max late %lu us",
+        entries_.size() + dispatched_entries_.size(), peak_entries_, peak_entries_, peak_entries_ * DELAY_TASK_STACK_SIZE,
+        dispatched_, cancelled_, max_late_us_);
+}
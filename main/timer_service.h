@@ -0,0 +1,58 @@
+#ifndef TIMER_SERVICE_H
+#define TIMER_SERVICE_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include <esp_timer.h>
+
+#include "schedule_queue.h"
+
+/*
+ * Delayed callbacks on a single one-shot esp_timer.
+ *
+ * Pending callbacks are kept sorted by deadline and the timer is armed for the earliest one.
+ * When it fires, every callback that is due is handed to the dispatcher (the main loop's
+ * Schedule()), so callbacks never run in the esp_timer task. A dispatched callback stays here
+ * until the dispatcher runs it, so Cancel() still stops it while it waits in the main loop's
+ * queue. Add() and Cancel() may be called from any task.
+ */
+class TimerService {
+public:
+    typedef uint32_t Handle;    // 0 is never returned, so it can mean "no timer"
+
+    explicit TimerService(std::function<void(SmallFunction&&)> dispatcher);
+    ~TimerService();
+
+    Handle Add(uint32_t delay_ms, SmallFunction&& callback);
+    // Returns false if the callback already ran or the handle is unknown
+    bool Cancel(Handle handle);
+    void PrintStatistics();
+
+private:
+    struct Entry {
+        int64_t deadline_us;
+        Handle handle;
+        SmallFunction callback;
+    };
+
+    std::function<void(SmallFunction&&)> dispatcher_;
+    esp_timer_handle_t timer_handle_ = nullptr;
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+    // Handed to the dispatcher but not run yet, in dispatch order
+    std::vector<Entry> dispatched_entries_;
+    Handle next_handle_ = 1;
+    size_t peak_entries_ = 0;     // Pending and dispatched, each of them used to be a delay task
+    uint32_t dispatched_ = 0;
+    uint32_t cancelled_ = 0;
+    uint32_t max_late_us_ = 0;
+
+    void OnTimer();
+    void Run(Handle handle);
+    void Arm(int64_t now_us);
+};
+
+#endif // TIMER_SERVICE_H
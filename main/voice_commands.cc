@@ -0,0 +1,88 @@
+#include "voice_commands.h"
+#include "assets.h"
+#include "settings.h"
+
+#include <cstring>
+#include <string>
+#include <cJSON.h>
+#include <esp_log.h>
+
+#define TAG "VoiceCommands"
+
+const char* VoiceCommands::GetName(VoiceCommand command) {
+    return command < kVoiceCommandCount ? kVoiceCommandTable[command].name : "unknown";
+}
+
+bool VoiceCommands::LoadTable(const char* json, size_t length, const char* source) {
+    cJSON* root = cJSON_ParseWithLength(json, length);
+    if (!cJSON_IsObject(root)) {
+        ESP_LOGE(TAG, "The voice command table from %s is not valid", source);
+        cJSON_Delete(root);
+        return false;
+    }
+
+    matcher_.Clear();
+    int phrases = 0;
+    cJSON* item = nullptr;
+    cJSON_ArrayForEach(item, root) {
+        int command = 0;
+        while (command < kVoiceCommandCount && strcmp(kVoiceCommandTable[command].name, item->string) != 0) {
+            command++;
+        }
+        if (command == kVoiceCommandCount || !cJSON_IsArray(item)) {
+            ESP_LOGW(TAG, "Ignoring voice command entry: %s", item->string);
+            continue;
+        }
+        cJSON* phrase = nullptr;
+        cJSON_ArrayForEach(phrase, item) {
+            if (cJSON_IsString(phrase)) {
+                matcher_.Add(phrase->valuestring, command);
+                phrases++;
+            }
+        }
+    }
+    cJSON_Delete(root);
+
+    if (phrases == 0) {
+        ESP_LOGE(TAG, "The voice command table from %s has no phrases", source);
+        matcher_.Clear();
+        return false;
+    }
+    matcher_.Build();
+    ESP_LOGI(TAG, "Loaded %d phrases from %s", phrases, source);
+    return true;
+}
+
+void VoiceCommands::LoadDefaults() {
+    matcher_.Clear();
+    int phrases = 0;
+    for (int command = 0; command < kVoiceCommandCount; command++) {
+        for (auto phrase : kVoiceCommandTable[command].phrases) {
+            if (phrase != nullptr) {
+                matcher_.Add(phrase, command);
+                phrases++;
+            }
+        }
+    }
+    matcher_.Build();
+    ESP_LOGI(TAG, "Loaded %d phrases from the built-in table", phrases);
+}
+
+void VoiceCommands::Load() {
+    auto& assets = Assets::GetInstance();
+    void* ptr = nullptr;
+    size_t size = 0;
+    if (assets.partition_valid() && assets.GetAssetData("voice_commands.json", ptr, size)) {
+        if (LoadTable(static_cast<const char*>(ptr), size, "assets")) {
+            return;
+        }
+    }
+
+    Settings settings("voice_commands", false);
+    std::string table = settings.GetString("table");
+    if (!table.empty() && LoadTable(table.c_str(), table.size(), "nvs")) {
+        return;
+    }
+
+    LoadDefaults();
+}
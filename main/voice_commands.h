@@ -0,0 +1,84 @@
+#ifndef VOICE_COMMANDS_H
+#define VOICE_COMMANDS_H
+
+#include <cstdint>
+#include <string_view>
+
+#include "keyword_matcher.h"
+
+// Bit positions in the mask returned by VoiceCommands::Match()
+enum VoiceCommand {
+    kVoiceCommandShoot,
+    kVoiceCommandShowQr,
+    kVoiceCommandPushup,
+    kVoiceCommandToilet,
+    kVoiceCommandBirthday,
+    kVoiceCommandCongratulate,      // Broader birthday phrases, only used for typed text
+    kVoiceCommandWalkForward,
+    kVoiceCommandWalkBack,
+    kVoiceCommandTurnLeft,
+    kVoiceCommandTurnRight,
+    kVoiceCommandSitDown,
+    kVoiceCommandDance,
+    kVoiceCommandBow,
+    kVoiceCommandShowIp,
+    kVoiceCommandOpenPanel,
+    kVoiceCommandEmojiOtto,
+    kVoiceCommandEmojiDefault,
+    kVoiceCommandCount
+};
+
+struct VoiceCommandPhrases {
+    const char* name;
+    const char* phrases[4];
+};
+
+// Names and built-in phrases of the commands, indexed by VoiceCommand
+inline constexpr VoiceCommandPhrases kVoiceCommandTable[kVoiceCommandCount] = {
+    { "shoot", { "súng nè", "bắn", "bang bang", "bùm" } },
+    { "show_qr", { "mở qr", "mở mã qr", "hiển thị qr", "mở mạng qr" } },
+    { "pushup", { "chống đẩy", "tập thể dục", "hít đất" } },
+    { "toilet", { "đi vệ sinh", "đi toilet" } },
+    { "birthday", { "chúc mừng sinh nhật", "happy birthday", "sinh nhật vui vẻ" } },
+    { "congratulate", { "sinh nhật", "chúc mừng" } },
+    { "walk_forward", { "đi tới", "tiến lên" } },
+    { "walk_back", { "lùi lại", "đi lùi" } },
+    { "turn_left", { "quẹo trái", "rẽ trái" } },
+    { "turn_right", { "quẹo phải", "rẽ phải" } },
+    { "sit_down", { "ngồi" } },
+    { "dance", { "nhảy", "múa" } },
+    { "bow", { "chào" } },
+    { "show_ip", { "192168", "một chín hai", "ip address" } },
+    { "open_panel", { "bảng điều khiển", "mở trang điều khiển", "mở web" } },
+    { "emoji_otto", { "emoji chính" } },
+    { "emoji_default", { "emoji mặc định" } },
+};
+
+/*
+ * The phrase to command table for STT transcripts and typed text.
+ *
+ * The table is a JSON object mapping command names to phrase lists, e.g.
+ *   {"walk_forward": ["đi tới", "tiến lên"], "bow": ["chào"]}
+ * Each phrase is written once with its accents. A transcript without any accent also matches it
+ * unaccented, see KeywordMatcher.
+ * Load() takes voice_commands.json from the assets partition, then the "table" key of the
+ * "voice_commands" NVS namespace, then the built-in kVoiceCommandTable. Unknown names are ignored.
+ */
+class VoiceCommands {
+public:
+    void Load();
+    void LoadDefaults();
+    uint32_t Match(std::string_view text) const { return matcher_.Match(text); }
+
+    static bool Has(uint32_t commands, VoiceCommand command) {
+        return (commands & (1u << command)) != 0;
+    }
+    static const char* GetName(VoiceCommand command);
+
+private:
+    KeywordMatcher matcher_;
+
+    bool LoadTable(const char* json, size_t length, const char* source);
+};
+
+#endif // VOICE_COMMANDS_H
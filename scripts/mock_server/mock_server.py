@@ -0,0 +1,971 @@
+#!/usr/bin/env python3
+'''
+  Local mock of the voice server, for testing the firmware and the protocols without a cloud backend.
+
+  serve   Speaks hello / listen / abort / stt / tts / llm / mcp over websocket (binary protocol
+          v1, v2, v3, including multi-frame audio batches) and over MQTT + UDP with AES-CTR.
+          Every turn replays a canned OGG Opus file as TTS, optionally followed by the echoed
+          uplink audio. A minimal MQTT 3.1.1 broker and an /ota/ endpoint are built in.
+
+  client  Connects to a server like the device does and measures the connect time, the first
+          audio latency (listen stop to the first TTS frame) and the sustained throughput.
+'''
+import argparse
+import asyncio
+import glob
+import json
+import os
+import secrets
+import socket
+import struct
+import time
+import uuid
+
+import aiohttp
+from aiohttp import web
+from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+
+
+REPO_ROOT = os.path.abspath(os.path.join(os.path.dirname(__file__), '..', '..'))
+
+BINARY_TYPE_OPUS = 0
+BINARY_TYPE_JSON = 1
+BINARY_TYPE_OPUS_BATCH = 2
+AUDIO_BATCH_MAX_FRAMES = 5
+UDP_HEADER_SIZE = 16
+
+
+def log(tag, message):
+    print(f"{time.strftime('%H:%M:%S')} [{tag}] {message}", flush=True)
+
+
+# ---------------------------------------------------------------------------
+# Opus helpers
+# ---------------------------------------------------------------------------
+
+def read_ogg_opus(path):
+    '''Returns the Opus packets of an OGG file, without the OpusHead / OpusTags headers.'''
+    with open(path, 'rb') as f:
+        data = f.read()
+    packets = []
+    partial = b''
+    offset = 0
+    while offset + 27 <= len(data):
+        if data[offset:offset + 4] != b'OggS':
+            raise ValueError(f'{path}: bad OGG page at {offset}')
+        segment_count = data[offset + 26]
+        table = data[offset + 27:offset + 27 + segment_count]
+        offset += 27 + segment_count
+        for lacing in table:
+            partial += data[offset:offset + lacing]
+            offset += lacing
+            if lacing < 255:
+                packets.append(partial)
+                partial = b''
+    return [p for p in packets if not p.startswith(b'OpusHead') and not p.startswith(b'OpusTags')]
+
+
+def opus_packet_duration_ms(packet):
+    '''Duration from the TOC byte (RFC 6716 section 3.1).'''
+    if not packet:
+        return 0
+    toc = packet[0]
+    config = toc >> 3
+    if config < 12:
+        frame_ms = (10, 20, 40, 60)[config % 4]
+    elif config < 16:
+        frame_ms = (10, 20)[config % 2]
+    else:
+        frame_ms = (2.5, 5, 10, 20)[config % 4]
+    code = toc & 0x03
+    if code == 0:
+        frames = 1
+    elif code in (1, 2):
+        frames = 2
+    else:
+        frames = packet[1] & 0x3F if len(packet) > 1 else 1
+    return frame_ms * frames
+
+
+def default_tts_file():
+    files = sorted(glob.glob(os.path.join(REPO_ROOT, 'main', 'assets', 'locales', 'en-US', '*.ogg')))
+    if not files:
+        files = sorted(glob.glob(os.path.join(REPO_ROOT, 'main', 'assets', '**', '*.ogg'), recursive=True))
+    return files[0] if files else None
+
+
+# ---------------------------------------------------------------------------
+# Websocket binary framing
+# ---------------------------------------------------------------------------
+
+def pack_binary(version, message_type, payload, timestamp=0):
+    if version == 2:
+        return struct.pack('>HHIII', 2, message_type, 0, timestamp, len(payload)) + payload
+    if version == 3:
+        return struct.pack('>BBH', message_type, 0, len(payload)) + payload
+    return payload
+
+
+def unpack_binary(version, data):
+    '''Returns (type, timestamp, payload) or None for a malformed frame.'''
+    if version == 2:
+        if len(data) < 16:
+            return None
+        _, message_type, _, timestamp, size = struct.unpack('>HHIII', data[:16])
+        payload = data[16:16 + size]
+    elif version == 3:
+        if len(data) < 4:
+            return None
+        message_type, _, size = struct.unpack('>BBH', data[:4])
+        timestamp = 0
+        payload = data[4:4 + size]
+    else:
+        return BINARY_TYPE_OPUS, 0, data
+    if len(payload) != size:
+        return None
+    return message_type, timestamp, payload
+
+
+def pack_batch(frames):
+    return b''.join(struct.pack('>H', len(frame)) + frame for frame in frames)
+
+
+def unpack_batch(payload):
+    frames = []
+    offset = 0
+    while offset + 2 <= len(payload):
+        size, = struct.unpack('>H', payload[offset:offset + 2])
+        offset += 2
+        if size == 0 or offset + size > len(payload):
+            return None
+        frames.append(payload[offset:offset + size])
+        offset += size
+    return frames if offset == len(payload) else None
+
+
+# ---------------------------------------------------------------------------
+# UDP audio (AES-CTR, the counter block is the 16 byte packet header)
+# ---------------------------------------------------------------------------
+
+class UdpCipher:
+    def __init__(self, key, nonce):
+        self.key = key
+        self.nonce = nonce
+
+    def encrypt(self, payload, timestamp, sequence):
+        header = bytearray(self.nonce)
+        struct.pack_into('>H', header, 2, len(payload))
+        struct.pack_into('>II', header, 8, timestamp, sequence)
+        encryptor = Cipher(algorithms.AES(self.key), modes.CTR(bytes(header))).encryptor()
+        return bytes(header) + encryptor.update(payload) + encryptor.finalize()
+
+    def decrypt(self, datagram):
+        '''Returns (timestamp, sequence, payload) or None.'''
+        if len(datagram) < UDP_HEADER_SIZE or datagram[0] != 0x01:
+            return None
+        header = datagram[:UDP_HEADER_SIZE]
+        timestamp, sequence = struct.unpack('>II', header[8:16])
+        decryptor = Cipher(algorithms.AES(self.key), modes.CTR(header)).decryptor()
+        return timestamp, sequence, decryptor.update(datagram[UDP_HEADER_SIZE:]) + decryptor.finalize()
+
+
+# ---------------------------------------------------------------------------
+# Minimal MQTT 3.1.1 framing (QoS 0 / 1 publish, no retained messages, no sessions)
+# ---------------------------------------------------------------------------
+
+def mqtt_encode_length(length):
+    encoded = bytearray()
+    while True:
+        byte = length % 128
+        length //= 128
+        encoded.append(byte | 0x80 if length else byte)
+        if not length:
+            return bytes(encoded)
+
+
+def mqtt_string(value):
+    data = value.encode()
+    return struct.pack('>H', len(data)) + data
+
+
+def mqtt_packet(header, body=b''):
+    return bytes([header]) + mqtt_encode_length(len(body)) + body
+
+
+def mqtt_publish(topic, payload):
+    return mqtt_packet(0x30, mqtt_string(topic) + payload)
+
+
+async def mqtt_read_packet(reader):
+    header = (await reader.readexactly(1))[0]
+    length = 0
+    multiplier = 1
+    while True:
+        byte = (await reader.readexactly(1))[0]
+        length += (byte & 0x7F) * multiplier
+        if not byte & 0x80:
+            break
+        multiplier *= 128
+    body = await reader.readexactly(length) if length else b''
+    return header, body
+
+
+def mqtt_parse_publish(header, body):
+    '''Returns (topic, packet_id, payload).'''
+    topic_length, = struct.unpack('>H', body[:2])
+    topic = body[2:2 + topic_length].decode(errors='replace')
+    offset = 2 + topic_length
+    packet_id = None
+    if (header >> 1) & 0x03:
+        packet_id, = struct.unpack('>H', body[offset:offset + 2])
+        offset += 2
+    return topic, packet_id, body[offset:]
+
+
+# ---------------------------------------------------------------------------
+# Server
+# ---------------------------------------------------------------------------
+
+class Session:
+    '''Conversation logic shared by both transports. Subclasses implement the send methods.'''
+
+    def __init__(self, server, tag):
+        self.server = server
+        self.tag = tag
+        self.session_id = str(uuid.uuid4())
+        self.listening = False
+        self.listen_mode = 'auto'
+        self.uplink_frames = []
+        self.uplink_started = 0
+        self.turn_task = None
+        # Downlink audio clock of the session, it keeps running across turns so a client can tell
+        # late frames of an earlier turn by their timestamp
+        self.downlink_timestamp = 0
+        self.turn_frames = 0
+        self.mcp_id = 0
+        self.closed = False
+        self.stats = {'rx_frames': 0, 'rx_bytes': 0, 'tx_frames': 0, 'tx_bytes': 0, 'turns': 0}
+
+    async def send_json(self, message):
+        raise NotImplementedError
+
+    async def send_audio(self, frames, timestamp):
+        raise NotImplementedError
+
+    def audio_batch_frames(self):
+        return 1
+
+    async def on_json(self, message):
+        message_type = message.get('type')
+        if message_type == 'listen':
+            state = message.get('state')
+            if state == 'start':
+                self.cancel_turn()
+                self.listening = True
+                self.listen_mode = message.get('mode', 'auto')
+                self.uplink_frames = []
+                self.uplink_started = 0
+                log(self.tag, f'listen start ({self.listen_mode})')
+            elif state == 'stop':
+                log(self.tag, f'listen stop after {len(self.uplink_frames)} frames')
+                self.end_listening()
+            elif state == 'detect':
+                log(self.tag, f'wake word: {message.get("text")}')
+                await self.send_json({'session_id': self.session_id, 'type': 'stt', 'text': message.get('text', '')})
+        elif message_type == 'abort':
+            log(self.tag, f'abort ({message.get("reason", "")})')
+            if self.cancel_turn():
+                await self.send_json({'session_id': self.session_id, 'type': 'tts', 'state': 'stop'})
+        elif message_type == 'mcp':
+            payload = message.get('payload', {})
+            result = payload.get('result')
+            if isinstance(result, dict) and 'tools' in result:
+                names = [tool.get('name') for tool in result['tools']]
+                log(self.tag, f'mcp tools: {", ".join(names)}')
+                if result.get('nextCursor'):
+                    await self.send_mcp('tools/list', {'cursor': result['nextCursor']})
+            elif 'error' in payload:
+                log(self.tag, f'mcp error: {payload["error"]}')
+            else:
+                log(self.tag, f'mcp: {json.dumps(payload)[:200]}')
+        elif message_type == 'goodbye':
+            log(self.tag, 'goodbye')
+            self.close()
+        else:
+            log(self.tag, f'unhandled message: {json.dumps(message)[:200]}')
+
+    async def on_hello(self, hello):
+        features = hello.get('features', {})
+        if features.get('mcp'):
+            await self.send_mcp('initialize', {'capabilities': {}})
+            await self.send_mcp('tools/list', {})
+
+    async def send_mcp(self, method, params):
+        self.mcp_id += 1
+        await self.send_json({'session_id': self.session_id, 'type': 'mcp',
+                              'payload': {'jsonrpc': '2.0', 'id': self.mcp_id, 'method': method, 'params': params}})
+
+    def on_audio(self, frame):
+        self.stats['rx_frames'] += 1
+        self.stats['rx_bytes'] += len(frame)
+        if not self.listening:
+            return
+        if not self.uplink_started:
+            self.uplink_started = time.monotonic()
+        self.uplink_frames.append(frame)
+        # Stands in for server side VAD: auto and realtime turns end after a fixed duration
+        if self.listen_mode != 'manual' and time.monotonic() - self.uplink_started >= self.server.args.turn_ms / 1000:
+            log(self.tag, f'end of speech after {len(self.uplink_frames)} frames')
+            self.end_listening()
+
+    def end_listening(self):
+        if not self.listening:
+            return
+        self.listening = False
+        uplink = self.uplink_frames
+        self.uplink_frames = []
+        self.cancel_turn()
+        self.turn_task = asyncio.ensure_future(self.speak(uplink))
+
+    def cancel_turn(self):
+        if self.turn_task is not None and not self.turn_task.done():
+            self.turn_task.cancel()
+            return True
+        return False
+
+    async def speak(self, uplink):
+        args = self.server.args
+        self.stats['turns'] += 1
+        sid = self.session_id
+        try:
+            if args.delay_ms:
+                await asyncio.sleep(args.delay_ms / 1000)
+            await self.send_json({'session_id': sid, 'type': 'stt', 'text': f'mock turn {self.stats["turns"]}, {len(uplink)} frames'})
+            await self.send_json({'session_id': sid, 'type': 'llm', 'text': '😊', 'emotion': 'happy'})
+            await self.send_json({'session_id': sid, 'type': 'tts', 'state': 'start'})
+
+            sentences = []
+            if self.server.tts_frames:
+                sentences.append(('This is the canned reply.', self.server.tts_frames))
+            if args.echo and uplink:
+                sentences.append(('Echo of what you said.', uplink))
+            self.turn_frames = 0
+            for text, frames in sentences:
+                await self.send_json({'session_id': sid, 'type': 'tts', 'state': 'sentence_start', 'text': text})
+                await self.stream(frames)
+                await self.send_json({'session_id': sid, 'type': 'tts', 'state': 'sentence_end', 'text': text})
+            # frames and end_timestamp are only sent by the mock, the client drains the turn with them
+            await self.send_json({'session_id': sid, 'type': 'tts', 'state': 'stop',
+                                  'frames': self.turn_frames, 'end_timestamp': self.downlink_timestamp})
+        except asyncio.CancelledError:
+            log(self.tag, 'tts cancelled')
+            raise
+        except (ConnectionError, aiohttp.ClientError) as e:
+            log(self.tag, f'tts aborted: {e}')
+
+    async def stream(self, frames):
+        '''Sends |frames| in real time after a short prebuffer, the way a streaming TTS would.'''
+        args = self.server.args
+        start = time.monotonic()
+        sent_ms = 0
+        batch = self.audio_batch_frames()
+        for i in range(0, len(frames), batch):
+            chunk = frames[i:i + batch]
+            await self.send_audio(chunk, self.downlink_timestamp)
+            self.stats['tx_frames'] += len(chunk)
+            self.stats['tx_bytes'] += sum(len(frame) for frame in chunk)
+            self.turn_frames += len(chunk)
+            duration = sum(opus_packet_duration_ms(frame) for frame in chunk)
+            # Per frame, the way MqttSession.send_audio() stamps the frames of a chunk
+            self.downlink_timestamp += sum(int(opus_packet_duration_ms(frame)) for frame in chunk)
+            sent_ms += duration
+            if args.pace:
+                wait = (sent_ms - args.prebuffer_ms) / 1000 - (time.monotonic() - start)
+                if wait > 0:
+                    await asyncio.sleep(wait)
+
+    def close(self):
+        if self.closed:
+            return
+        self.closed = True
+        self.cancel_turn()
+        log(self.tag, 'closed, uplink {rx_frames} frames / {rx_bytes} bytes, downlink {tx_frames} frames / '
+            '{tx_bytes} bytes, {turns} turns'.format(**self.stats))
+
+
+class WebsocketSession(Session):
+    def __init__(self, server, ws, version):
+        super().__init__(server, f'ws v{version}')
+        self.ws = ws
+        self.version = version
+        self.batch_frames = 1
+
+    async def send_json(self, message):
+        await self.ws.send_str(json.dumps(message, ensure_ascii=False))
+
+    async def send_audio(self, frames, timestamp):
+        if len(frames) > 1:
+            await self.ws.send_bytes(pack_binary(self.version, BINARY_TYPE_OPUS_BATCH, pack_batch(frames), timestamp))
+        else:
+            await self.ws.send_bytes(pack_binary(self.version, BINARY_TYPE_OPUS, frames[0], timestamp))
+
+    def audio_batch_frames(self):
+        return self.batch_frames
+
+    async def handle_hello(self, hello):
+        features = {}
+        requested = hello.get('features', {}).get('audio_batch', 0)
+        if self.version >= 2 and requested and self.server.args.batch > 1:
+            self.batch_frames = min(int(requested), self.server.args.batch, AUDIO_BATCH_MAX_FRAMES)
+            features['audio_batch'] = self.batch_frames
+        reply = {
+            'type': 'hello',
+            'transport': 'websocket',
+            'session_id': self.session_id,
+            'audio_params': {
+                'format': 'opus',
+                'sample_rate': self.server.args.sample_rate,
+                'channels': 1,
+                'frame_duration': self.server.frame_duration,
+            },
+        }
+        if features:
+            reply['features'] = features
+        await self.send_json(reply)
+        log(self.tag, f'hello, audio batch {self.batch_frames}')
+        await self.on_hello(hello)
+
+    def on_binary(self, data):
+        unpacked = unpack_binary(self.version, data)
+        if unpacked is None:
+            log(self.tag, f'malformed binary frame ({len(data)} bytes)')
+            return
+        message_type, _, payload = unpacked
+        if message_type == BINARY_TYPE_OPUS:
+            self.on_audio(payload)
+        elif message_type == BINARY_TYPE_OPUS_BATCH:
+            frames = unpack_batch(payload)
+            if frames is None:
+                log(self.tag, 'malformed audio batch')
+                return
+            for frame in frames:
+                self.on_audio(frame)
+        else:
+            log(self.tag, f'unknown binary type {message_type}')
+
+
+class MqttSession(Session):
+    def __init__(self, server, client_id, writer):
+        super().__init__(server, f'mqtt {client_id}')
+        self.client_id = client_id
+        self.writer = writer
+        self.cipher = None
+        self.ssrc = None
+        self.udp_address = None
+        self.sequence = 0
+
+    async def send_json(self, message):
+        self.writer.write(mqtt_publish(f'devices/{self.client_id}', json.dumps(message, ensure_ascii=False).encode()))
+        await self.writer.drain()
+
+    async def send_audio(self, frames, timestamp):
+        if self.udp_address is None or self.cipher is None:
+            return
+        for frame in frames:
+            self.sequence += 1
+            self.server.udp.sendto(self.cipher.encrypt(frame, timestamp, self.sequence), self.udp_address)
+            timestamp += int(opus_packet_duration_ms(frame))
+
+    async def handle_hello(self, hello):
+        self.server.forget_udp(self)
+        key = secrets.token_bytes(16)
+        self.ssrc = secrets.token_bytes(4)
+        nonce = b'\x01\x00\x00\x00' + self.ssrc + b'\x00' * 8
+        self.cipher = UdpCipher(key, nonce)
+        self.sequence = 0
+        self.udp_address = None
+        self.server.udp_sessions[self.ssrc] = self
+        await self.send_json({
+            'type': 'hello',
+            'transport': 'udp',
+            'session_id': self.session_id,
+            'audio_params': {
+                'format': 'opus',
+                'sample_rate': self.server.args.sample_rate,
+                'channels': 1,
+                'frame_duration': self.server.frame_duration,
+            },
+            'udp': {
+                'server': self.server.public_host,
+                'port': self.server.args.udp_port,
+                'key': key.hex().upper(),
+                'nonce': nonce.hex().upper(),
+                'reorder_window': 8,
+            },
+        })
+        log(self.tag, f'hello, udp {self.server.public_host}:{self.server.args.udp_port}')
+        await self.on_hello(hello)
+
+    def on_datagram(self, datagram, address):
+        decrypted = self.cipher.decrypt(datagram)
+        if decrypted is None:
+            return
+        self.udp_address = address
+        self.on_audio(decrypted[2])
+
+    def close(self):
+        self.server.forget_udp(self)
+        super().close()
+
+
+class UdpAudioEndpoint(asyncio.DatagramProtocol):
+    def __init__(self, server):
+        self.server = server
+
+    def datagram_received(self, data, address):
+        # The SSRC in the header identifies the session until the first packet reveals the device address
+        session = self.server.udp_sessions.get(data[4:8]) if len(data) >= UDP_HEADER_SIZE else None
+        if session is not None:
+            session.on_datagram(data, address)
+
+
+class MockServer:
+    def __init__(self, args):
+        self.args = args
+        self.public_host = args.public_host or self.guess_host()
+        self.tts_frames = []
+        self.frame_duration = 60
+        if args.tts:
+            self.tts_frames = read_ogg_opus(args.tts)
+            if self.tts_frames:
+                self.frame_duration = int(opus_packet_duration_ms(self.tts_frames[0]))
+            log('server', f'TTS: {args.tts}, {len(self.tts_frames)} frames of {self.frame_duration} ms')
+        self.udp = None
+        self.udp_sessions = {}
+
+    @staticmethod
+    def guess_host():
+        try:
+            with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+                s.connect(('10.255.255.255', 1))
+                return s.getsockname()[0]
+        except OSError:
+            return '127.0.0.1'
+
+    def forget_udp(self, session):
+        if session.ssrc is not None and self.udp_sessions.get(session.ssrc) is session:
+            del self.udp_sessions[session.ssrc]
+
+    async def handle_websocket(self, request):
+        version = int(request.headers.get('Protocol-Version', '1'))
+        ws = web.WebSocketResponse(max_msg_size=0)
+        await ws.prepare(request)
+        session = WebsocketSession(self, ws, version)
+        log(session.tag, f'connected from {request.remote}, device {request.headers.get("Device-Id", "?")}')
+        try:
+            async for msg in ws:
+                if msg.type == aiohttp.WSMsgType.TEXT:
+                    message = json.loads(msg.data)
+                    if message.get('type') == 'hello':
+                        await session.handle_hello(message)
+                    else:
+                        await session.on_json(message)
+                elif msg.type == aiohttp.WSMsgType.BINARY:
+                    session.on_binary(msg.data)
+        finally:
+            session.close()
+        return ws
+
+    async def handle_ota(self, request):
+        '''Points the device at this server. The firmware stores every field of these sections in its settings.'''
+        host = request.host.split(':')[0]
+        if host in ('', 'localhost', '127.0.0.1'):
+            host = self.public_host
+        response = {
+            'server_time': {'timestamp': int(time.time() * 1000), 'timezone_offset': 0},
+            'firmware': {'version': '0.0.0', 'url': ''},
+        }
+        if self.args.ota_transport == 'mqtt':
+            response['mqtt'] = {
+                'endpoint': f'{host}:{self.args.mqtt_port}',
+                'client_id': request.headers.get('Client-Id', 'mock-device'),
+                'username': 'mock',
+                'password': 'mock',
+                'publish_topic': 'device-server',
+                'keepalive': 240,
+            }
+        else:
+            response['websocket'] = {
+                'url': f'ws://{host}:{self.args.port}/xiaozhi/v1/',
+                'token': 'mock',
+                'version': self.args.ota_version,
+            }
+        return web.json_response(response)
+
+    async def handle_mqtt(self, reader, writer):
+        session = None
+        try:
+            while True:
+                header, body = await mqtt_read_packet(reader)
+                packet_type = header >> 4
+                if packet_type == 1:    # CONNECT
+                    protocol_length, = struct.unpack('>H', body[:2])
+                    offset = 2 + protocol_length + 4
+                    client_id_length, = struct.unpack('>H', body[offset:offset + 2])
+                    client_id = body[offset + 2:offset + 2 + client_id_length].decode(errors='replace')
+                    session = MqttSession(self, client_id or 'anonymous', writer)
+                    writer.write(mqtt_packet(0x20, b'\x00\x00'))
+                    log(session.tag, f'connected from {writer.get_extra_info("peername")}')
+                elif packet_type == 3 and session is not None:     # PUBLISH
+                    _, packet_id, payload = mqtt_parse_publish(header, body)
+                    if packet_id is not None:
+                        writer.write(mqtt_packet(0x40, struct.pack('>H', packet_id)))
+                    message = json.loads(payload)
+                    if message.get('type') == 'hello':
+                        await session.handle_hello(message)
+                    else:
+                        await session.on_json(message)
+                elif packet_type == 8:  # SUBSCRIBE
+                    packet_id = body[:2]
+                    topic_count = 0
+                    offset = 2
+                    while offset < len(body):
+                        length, = struct.unpack('>H', body[offset:offset + 2])
+                        offset += 2 + length + 1
+                        topic_count += 1
+                    writer.write(mqtt_packet(0x90, packet_id + b'\x00' * topic_count))
+                elif packet_type == 12:     # PINGREQ
+                    writer.write(mqtt_packet(0xD0))
+                elif packet_type == 14:     # DISCONNECT
+                    break
+                await writer.drain()
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            if session is not None:
+                session.close()
+            writer.close()
+
+    async def run(self):
+        app = web.Application()
+        app.router.add_route('*', '/ota/', self.handle_ota)
+        app.router.add_get('/{tail:.*}', self.handle_websocket)
+        runner = web.AppRunner(app)
+        await runner.setup()
+        await web.TCPSite(runner, self.args.host, self.args.port).start()
+        mqtt_server = await asyncio.start_server(self.handle_mqtt, self.args.host, self.args.mqtt_port)
+        loop = asyncio.get_running_loop()
+        self.udp, _ = await loop.create_datagram_endpoint(lambda: UdpAudioEndpoint(self),
+                                                          local_addr=(self.args.host, self.args.udp_port))
+        log('server', f'websocket ws://{self.public_host}:{self.args.port}/xiaozhi/v1/, '
+            f'OTA http://{self.public_host}:{self.args.port}/ota/, '
+            f'MQTT {self.public_host}:{self.args.mqtt_port}, UDP {self.args.udp_port}')
+        async with mqtt_server:
+            await asyncio.Event().wait()
+
+
+# ---------------------------------------------------------------------------
+# Client
+# ---------------------------------------------------------------------------
+
+class ClientTurn:
+    def __init__(self):
+        self.stop_sent = 0
+        self.first_audio = 0
+        self.last_audio = 0
+        self.frames = 0
+        self.bytes = 0
+        self.ignored = 0
+        # From the mock server's tts stop, None when the server does not send them
+        self.expected_frames = None
+        self.end_timestamp = None
+        self.done = asyncio.Event()
+
+    def on_audio(self, frame):
+        # The reply to a manual turn only starts after listen stop, anything earlier is left over
+        if not self.stop_sent:
+            self.ignored += 1
+            return
+        now = time.monotonic()
+        if not self.first_audio:
+            self.first_audio = now
+        self.last_audio = now
+        self.frames += 1
+        self.bytes += len(frame)
+
+
+class MockClient:
+    '''Behaves like the firmware: hello, then manual listen turns with uplink audio.'''
+
+    def __init__(self, args):
+        self.args = args
+        self.frames = read_ogg_opus(args.uplink) if args.uplink else []
+        if not self.frames:
+            raise SystemExit('No uplink audio, pass --uplink with an OGG Opus file')
+        self.session_id = ''
+        self.turn = None
+        # Downlink timestamps below this belong to an earlier turn
+        self.timestamp_floor = 0
+        self.results = []
+
+    def on_json(self, message):
+        if message.get('type') == 'tts' and message.get('state') == 'stop' and self.turn is not None:
+            self.turn.expected_frames = message.get('frames')
+            self.turn.end_timestamp = message.get('end_timestamp')
+            self.turn.done.set()
+
+    def on_audio(self, frame, timestamp=None):
+        '''|timestamp| is None for transports that do not carry one (websocket v1 and v3).'''
+        if self.turn is None:
+            return
+        if timestamp is not None and timestamp < self.timestamp_floor:
+            self.turn.ignored += 1
+            return
+        self.turn.on_audio(frame)
+
+    async def drain(self, turn):
+        '''UDP audio can still be on its way after tts stop, which came over MQTT.'''
+        if turn.expected_frames is None:
+            return
+        deadline = time.monotonic() + 1
+        while turn.frames < turn.expected_frames and time.monotonic() < deadline:
+            await asyncio.sleep(0.01)
+        if turn.end_timestamp is not None:
+            self.timestamp_floor = turn.end_timestamp
+
+    async def run_turns(self, send_json, send_audio):
+        uplink_ms = sum(opus_packet_duration_ms(frame) for frame in self.frames)
+        for round_index in range(self.args.rounds):
+            self.turn = ClientTurn()
+            await send_json({'session_id': self.session_id, 'type': 'listen', 'state': 'start', 'mode': 'manual'})
+            start = time.monotonic()
+            sent_bytes = 0
+            for i, frame in enumerate(self.frames):
+                await send_audio(frame, i * 60)
+                sent_bytes += len(frame)
+                if self.args.pace:
+                    wait = (i + 1) * opus_packet_duration_ms(frame) / 1000 - (time.monotonic() - start)
+                    if wait > 0:
+                        await asyncio.sleep(wait)
+            uplink_seconds = max(time.monotonic() - start, 1e-6)
+            self.turn.stop_sent = time.monotonic()
+            await send_json({'session_id': self.session_id, 'type': 'listen', 'state': 'stop'})
+            try:
+                await asyncio.wait_for(self.turn.done.wait(), timeout=30 + uplink_ms / 1000)
+            except asyncio.TimeoutError:
+                print(f'round {round_index + 1}: no tts stop within the timeout')
+            turn = self.turn
+            await self.drain(turn)
+            first_ms = (turn.first_audio - turn.stop_sent) * 1000 if turn.first_audio else float('nan')
+            downlink_seconds = max(turn.last_audio - turn.first_audio, 1e-6) if turn.first_audio else 1e-6
+            result = {
+                'first_audio_ms': first_ms,
+                'uplink_kbps': sent_bytes * 8 / uplink_seconds / 1000,
+                'uplink_fps': len(self.frames) / uplink_seconds,
+                'downlink_kbps': turn.bytes * 8 / downlink_seconds / 1000,
+                'downlink_frames': turn.frames,
+            }
+            self.results.append(result)
+            print(f'round {round_index + 1}: first audio {first_ms:.0f} ms, uplink {result["uplink_kbps"]:.1f} kbps '
+                  f'({result["uplink_fps"]:.1f} frames/s), downlink {turn.frames} frames, '
+                  f'{result["downlink_kbps"]:.1f} kbps')
+            if turn.ignored:
+                print(f'round {round_index + 1}: ignored {turn.ignored} frames of an earlier turn')
+            if turn.expected_frames is not None and turn.frames < turn.expected_frames:
+                print(f'round {round_index + 1}: {turn.expected_frames - turn.frames} downlink frames lost')
+
+    def report(self, connect_ms, hello_ms):
+        print(f'connect {connect_ms:.0f} ms, hello round trip {hello_ms:.0f} ms')
+        latencies = sorted(r['first_audio_ms'] for r in self.results if r['first_audio_ms'] == r['first_audio_ms'])
+        if latencies:
+            print(f'first audio: min {latencies[0]:.0f} ms, median {latencies[len(latencies) // 2]:.0f} ms, '
+                  f'max {latencies[-1]:.0f} ms over {len(latencies)} rounds')
+        if self.results:
+            uplink = sum(r['uplink_kbps'] for r in self.results) / len(self.results)
+            downlink = sum(r['downlink_kbps'] for r in self.results) / len(self.results)
+            print(f'throughput: uplink {uplink:.1f} kbps, downlink {downlink:.1f} kbps (averages)')
+
+    def hello(self, transport):
+        hello = {
+            'type': 'hello',
+            'version': self.args.version,
+            'transport': transport,
+            'features': {'mcp': False},
+            'audio_params': {'format': 'opus', 'sample_rate': 16000, 'channels': 1, 'frame_duration': 60},
+        }
+        if transport == 'websocket' and self.args.version >= 2 and self.args.batch > 1:
+            hello['features']['audio_batch'] = self.args.batch
+        return hello
+
+    async def run_websocket(self):
+        args = self.args
+        headers = {'Authorization': 'Bearer mock', 'Protocol-Version': str(args.version),
+                   'Device-Id': 'mock-client', 'Client-Id': str(uuid.uuid4())}
+        batch_frames = 1
+        hello_event = asyncio.Event()
+        async with aiohttp.ClientSession() as http:
+            start = time.monotonic()
+            async with http.ws_connect(args.url, headers=headers, max_msg_size=0) as ws:
+                connect_ms = (time.monotonic() - start) * 1000
+
+                async def receive():
+                    nonlocal batch_frames
+                    async for msg in ws:
+                        if msg.type == aiohttp.WSMsgType.TEXT:
+                            message = json.loads(msg.data)
+                            if message.get('type') == 'hello':
+                                self.session_id = message.get('session_id', '')
+                                batch_frames = message.get('features', {}).get('audio_batch', 1)
+                                hello_event.set()
+                            else:
+                                self.on_json(message)
+                        elif msg.type == aiohttp.WSMsgType.BINARY:
+                            unpacked = unpack_binary(args.version, msg.data)
+                            if unpacked is None:
+                                continue
+                            message_type, timestamp, payload = unpacked
+                            frames = unpack_batch(payload) if message_type == BINARY_TYPE_OPUS_BATCH else [payload]
+                            for frame in frames or []:
+                                self.on_audio(frame, timestamp if args.version == 2 else None)
+
+                receiver = asyncio.ensure_future(receive())
+                hello_start = time.monotonic()
+                await ws.send_str(json.dumps(self.hello('websocket')))
+                await asyncio.wait_for(hello_event.wait(), timeout=10)
+                hello_ms = (time.monotonic() - hello_start) * 1000
+                pending = []
+
+                async def send_json(message):
+                    if pending:
+                        await flush()
+                    await ws.send_str(json.dumps(message))
+
+                async def flush():
+                    if len(pending) == 1:
+                        await ws.send_bytes(pack_binary(args.version, BINARY_TYPE_OPUS, pending[0]))
+                    else:
+                        await ws.send_bytes(pack_binary(args.version, BINARY_TYPE_OPUS_BATCH, pack_batch(pending)))
+                    pending.clear()
+
+                async def send_audio(frame, timestamp):
+                    pending.append(frame)
+                    if len(pending) >= batch_frames:
+                        await flush()
+
+                await self.run_turns(send_json, send_audio)
+                await ws.send_str(json.dumps({'session_id': self.session_id, 'type': 'goodbye'}))
+                receiver.cancel()
+        self.report(connect_ms, hello_ms)
+
+    async def run_mqtt(self):
+        args = self.args
+        host, _, port = args.mqtt.partition(':')
+        start = time.monotonic()
+        reader, writer = await asyncio.open_connection(host, int(port or 1883))
+        client_id = f'mock-client-{os.getpid()}'
+        connect = mqtt_string('MQTT') + bytes([4, 0x02]) + struct.pack('>H', 60) + mqtt_string(client_id)
+        writer.write(mqtt_packet(0x10, connect))
+        await writer.drain()
+        header, _ = await mqtt_read_packet(reader)
+        if header >> 4 != 2:
+            raise SystemExit('MQTT connect failed')
+        connect_ms = (time.monotonic() - start) * 1000
+
+        hello_future = asyncio.get_running_loop().create_future()
+
+        async def receive():
+            while True:
+                header, body = await mqtt_read_packet(reader)
+                if header >> 4 != 3:
+                    continue
+                _, _, payload = mqtt_parse_publish(header, body)
+                message = json.loads(payload)
+                if message.get('type') == 'hello' and not hello_future.done():
+                    hello_future.set_result(message)
+                else:
+                    self.on_json(message)
+
+        async def send_json(message):
+            writer.write(mqtt_publish('device-server', json.dumps(message).encode()))
+            await writer.drain()
+
+        receiver = asyncio.ensure_future(receive())
+        hello_start = time.monotonic()
+        await send_json(self.hello('udp'))
+        server_hello = await asyncio.wait_for(hello_future, timeout=10)
+        hello_ms = (time.monotonic() - hello_start) * 1000
+        self.session_id = server_hello.get('session_id', '')
+        udp_info = server_hello['udp']
+        cipher = UdpCipher(bytes.fromhex(udp_info['key']), bytes.fromhex(udp_info['nonce']))
+
+        client = self
+
+        class Downlink(asyncio.DatagramProtocol):
+            def datagram_received(self, data, address):
+                decrypted = cipher.decrypt(data)
+                if decrypted is not None:
+                    client.on_audio(decrypted[2], decrypted[0])
+
+        loop = asyncio.get_running_loop()
+        transport, _ = await loop.create_datagram_endpoint(Downlink, remote_addr=(udp_info['server'], udp_info['port']))
+        sequence = 0
+
+        async def send_audio(frame, timestamp):
+            nonlocal sequence
+            sequence += 1
+            transport.sendto(cipher.encrypt(frame, timestamp, sequence))
+
+        await self.run_turns(send_json, send_audio)
+        await send_json({'session_id': self.session_id, 'type': 'goodbye'})
+        writer.write(mqtt_packet(0xE0))
+        await writer.drain()
+        receiver.cancel()
+        transport.close()
+        writer.close()
+        self.report(connect_ms, hello_ms)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Mock voice server and benchmark client')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+
+    serve = subparsers.add_parser('serve', help='run the mock server')
+    serve.add_argument('--host', default='0.0.0.0', help='listen address')
+    serve.add_argument('--public-host', default='', help='address announced to devices (default: the LAN address)')
+    serve.add_argument('--port', type=int, default=8000, help='websocket and OTA port')
+    serve.add_argument('--mqtt-port', type=int, default=1883, help='MQTT broker port')
+    serve.add_argument('--udp-port', type=int, default=8884, help='UDP audio port')
+    serve.add_argument('--tts', default=default_tts_file(), help='OGG Opus file replayed as TTS')
+    serve.add_argument('--echo', action='store_true', help='play the uplink audio back after the canned TTS')
+    serve.add_argument('--sample-rate', type=int, default=24000, help='server sample rate announced in hello')
+    serve.add_argument('--batch', type=int, default=AUDIO_BATCH_MAX_FRAMES, help='max frames per audio batch, 1 disables batching')
+    serve.add_argument('--delay-ms', type=int, default=0, help='simulated STT + LLM latency before the reply')
+    serve.add_argument('--turn-ms', type=int, default=3000, help='auto / realtime turns end after this much uplink audio')
+    serve.add_argument('--prebuffer-ms', type=int, default=180, help='TTS sent ahead of real time')
+    serve.add_argument('--no-pace', dest='pace', action='store_false', help='send TTS as fast as possible')
+    serve.add_argument('--ota-transport', choices=('websocket', 'mqtt'), default='websocket', help='transport returned by /ota/')
+    serve.add_argument('--ota-version', type=int, default=3, help='websocket protocol version returned by /ota/')
+
+    client = subparsers.add_parser('client', help='measure connect time, first audio latency and throughput')
+    target = client.add_mutually_exclusive_group()
+    target.add_argument('--url', default='ws://127.0.0.1:8000/xiaozhi/v1/', help='websocket server')
+    target.add_argument('--mqtt', help='MQTT broker host:port, audio goes over UDP')
+    client.add_argument('--version', type=int, default=3, choices=(1, 2, 3), help='websocket binary protocol version')
+    client.add_argument('--batch', type=int, default=AUDIO_BATCH_MAX_FRAMES, help='frames per uplink batch to request')
+    client.add_argument('--uplink', default=default_tts_file(), help='OGG Opus file sent as microphone audio')
+    client.add_argument('--rounds', type=int, default=5, help='listen turns')
+    client.add_argument('--no-pace', dest='pace', action='store_false', help='send uplink audio as fast as possible')
+
+    args = parser.parse_args()
+    try:
+        if args.command == 'serve':
+            asyncio.run(MockServer(args).run())
+        else:
+            mock_client = MockClient(args)
+            asyncio.run(mock_client.run_mqtt() if args.mqtt else mock_client.run_websocket())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
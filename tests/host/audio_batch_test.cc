@@ -0,0 +1,51 @@
+#include "host_test.h"
+#include "protocols/audio_batch.h"
+
+#include <vector>
+
+// Frames of odd sizes put every other length field at an odd offset
+int main() {
+    const size_t sizes[] = {1, 3, 0, 255, 256, 77, 1021, 2};
+    std::vector<std::vector<uint8_t>> frames;
+    // Start at an odd offset too, as after a BinaryProtocol3 header plus an odd frame
+    std::vector<uint8_t> buffer(1, 0xee);
+    for (size_t size : sizes) {
+        std::vector<uint8_t> frame(size);
+        for (size_t i = 0; i < size; i++) {
+            frame[i] = (uint8_t)(size * 31 + i);
+        }
+        AudioBatch::Append(buffer, frame.data(), frame.size());
+        frames.push_back(frame);
+    }
+
+    // The length is big endian whatever the offset
+    CHECK(buffer[1] == 0 && buffer[2] == 1);
+    CHECK(buffer[4] == 0 && buffer[5] == 3);
+
+    size_t index = 0;
+    bool valid = AudioBatch::ForEach(buffer.data() + 1, buffer.size() - 1, [&](const uint8_t* data, size_t size) {
+        CHECK(index < frames.size());
+        CHECK(std::vector<uint8_t>(data, data + size) == frames[index]);
+        index++;
+    });
+    CHECK(valid);
+    CHECK(index == frames.size());
+
+    // A length running past the end stops after the frames before it
+    buffer.pop_back();
+    index = 0;
+    valid = AudioBatch::ForEach(buffer.data() + 1, buffer.size() - 1, [&](const uint8_t*, size_t) { index++; });
+    CHECK(!valid);
+    CHECK(index == frames.size() - 1);
+
+    // So does a single stray byte after the last frame
+    std::vector<uint8_t> stray;
+    AudioBatch::Append(stray, frames[0].data(), frames[0].size());
+    stray.push_back(0);
+    index = 0;
+    CHECK(!AudioBatch::ForEach(stray.data(), stray.size(), [&](const uint8_t*, size_t) { index++; }));
+    CHECK(index == 1);
+
+    printf("audio_batch_test passed\n");
+    return 0;
+}
@@ -0,0 +1,158 @@
+#include "host_test.h"
+#include "audio_mixer.h"
+
+#include <cmath>
+#include <vector>
+
+/*
+ * AudioMixer sources: the data callback survives the mixer's own copy, a partial frame waits for
+ * the rest of its data on underrun and is only played short after EndOfStream(), a write that
+ * times out on a full buffer or a flush leaves the resampler ready for the next write, and
+ * downsampled content above the output Nyquist is filtered out before the interpolator.
+ */
+
+#define OUTPUT_RATE 24000
+#define FRAME_SAMPLES 240
+
+static std::vector<int16_t> Ramp(int16_t first, size_t samples) {
+    std::vector<int16_t> pcm(samples);
+    for (size_t i = 0; i < samples; i++) {
+        pcm[i] = first + (int16_t)i;
+    }
+    return pcm;
+}
+
+static void TestCallback() {
+    int calls = 0;
+    AudioMixer mixer(OUTPUT_RATE);
+    mixer.OnData([&calls]() { calls++; });
+    auto source = mixer.AddSource("music", 1.0f, false);
+    // Replacing the mixer's callback leaves the one the source was created with
+    mixer.OnData(nullptr);
+    auto pcm = Ramp(0, 10);
+    CHECK(source->Write(pcm.data(), pcm.size(), OUTPUT_RATE, 1));
+    source->EndOfStream();
+    CHECK(calls == 2);
+}
+
+static void TestUnderrun() {
+    AudioMixer mixer(OUTPUT_RATE);
+    auto source = mixer.AddSource("music", 1.0f, false);
+
+    // Less than a frame: nothing is pending and a frame mixed for TTS leaves the data alone
+    auto first = Ramp(1, 100);
+    CHECK(source->Write(first.data(), first.size(), OUTPUT_RATE, 1));
+    CHECK(!mixer.HasPendingAudio(FRAME_SAMPLES));
+    std::vector<int16_t> pcm;
+    mixer.Mix(pcm, FRAME_SAMPLES, true);
+    CHECK(pcm.size() == FRAME_SAMPLES);
+    for (auto sample : pcm) {
+        CHECK(sample == 0);
+    }
+    CHECK(source->available() == 100);
+
+    // The rest of the frame arrives and it plays without a gap
+    auto second = Ramp(101, 200);
+    CHECK(source->Write(second.data(), second.size(), OUTPUT_RATE, 1));
+    CHECK(mixer.HasPendingAudio(FRAME_SAMPLES));
+    pcm.clear();
+    mixer.Mix(pcm, FRAME_SAMPLES, false);
+    for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+        // The interpolator starts from the zero it was created with, one sample behind
+        CHECK(pcm[i] == (int16_t)i);
+    }
+    CHECK(source->available() == 60);
+
+    // The tail of the stream is only played short once the producer says it is done
+    CHECK(!mixer.HasPendingAudio(FRAME_SAMPLES));
+    source->EndOfStream();
+    CHECK(mixer.HasPendingAudio(FRAME_SAMPLES));
+    pcm.clear();
+    mixer.Mix(pcm, FRAME_SAMPLES, false);
+    CHECK(pcm[0] == FRAME_SAMPLES && pcm[59] == FRAME_SAMPLES + 59 && pcm[60] == 0);
+    CHECK(!mixer.HasPendingAudio(FRAME_SAMPLES));
+
+    // A new write clears the end of stream
+    CHECK(source->Write(first.data(), first.size(), OUTPUT_RATE, 1));
+    CHECK(!mixer.HasPendingAudio(FRAME_SAMPLES));
+}
+
+static void TestTimeoutAndFlush() {
+    AudioMixer mixer(OUTPUT_RATE);
+    auto source = mixer.AddSource("music", 1.0f, false);
+
+    // 44.1 kHz MP3 frames until the buffer is full and a write times out
+    auto mp3_frame = Ramp(0, 1152);
+    while (source->Write(mp3_frame.data(), mp3_frame.size(), 44100, 1, 0)) {
+    }
+    CHECK(source->available() == MIXER_SOURCE_BUFFER_SAMPLES);
+
+    // Once the output task makes room, every write buffers its share of output samples again
+    std::vector<int16_t> pcm;
+    for (int i = 0; i < 20; i++) {
+        pcm.clear();
+        mixer.Mix(pcm, FRAME_SAMPLES, false);
+    }
+    size_t before = source->available();
+    CHECK(source->Write(mp3_frame.data(), mp3_frame.size(), 44100, 1, 0));
+    size_t added = source->available() - before;
+    CHECK(added >= 1152 * OUTPUT_RATE / 44100 - 1 && added <= 1152 * OUTPUT_RATE / 44100 + 1);
+
+    // A flushed source starts its next stream from silence, not from the old stream's last sample
+    auto last = Ramp(20000, 100);
+    CHECK(source->Write(last.data(), last.size(), OUTPUT_RATE, 1));
+    source->Flush();
+    pcm.clear();
+    mixer.Mix(pcm, FRAME_SAMPLES, false);
+    CHECK(source->available() == 0);
+    auto next = Ramp(1, FRAME_SAMPLES);
+    CHECK(source->Write(next.data(), next.size(), OUTPUT_RATE, 1));
+    pcm.clear();
+    mixer.Mix(pcm, FRAME_SAMPLES, false);
+    for (size_t i = 0; i < FRAME_SAMPLES; i++) {
+        CHECK(pcm[i] == (int16_t)i);
+    }
+}
+
+// RMS of a tone at |frequency| written at 48 kHz and read back at the output rate
+static double ToneLevel(double frequency) {
+    const int source_rate = 48000;
+    const int source_samples = source_rate / 10;
+    AudioMixer mixer(OUTPUT_RATE);
+    auto source = mixer.AddSource("music", 1.0f, false);
+    std::vector<int16_t> tone(source_samples);
+    for (int i = 0; i < source_samples; i++) {
+        tone[i] = (int16_t)(10000 * sin(2 * M_PI * frequency * i / source_rate));
+    }
+    CHECK(source->Write(tone.data(), tone.size(), source_rate, 1));
+
+    double sum = 0;
+    int count = 0;
+    std::vector<int16_t> pcm;
+    while (mixer.HasPendingAudio(FRAME_SAMPLES)) {
+        pcm.clear();
+        mixer.Mix(pcm, FRAME_SAMPLES, false);
+        // Skip the filter's settling time
+        if (count >= FRAME_SAMPLES) {
+            for (auto sample : pcm) {
+                sum += (double)sample * sample;
+            }
+        }
+        count += FRAME_SAMPLES;
+    }
+    return sqrt(sum / (count - 2 * FRAME_SAMPLES)) / (10000 / M_SQRT2);
+}
+
+static void TestAntiAlias() {
+    CHECK(ToneLevel(1000) > 0.9);
+    // 20 kHz would fold back to 4 kHz at a 24 kHz output rate
+    CHECK(ToneLevel(20000) < 0.1);
+}
+
+int main() {
+    TestCallback();
+    TestUnderrun();
+    TestTimeoutAndFlush();
+    TestAntiAlias();
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "host_benchmark.h"
+#include "host_test.h"
+#include "audio/audio_service.h"
+#include "audio/codecs/dummy_audio_codec.h"
+
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * The whole AudioService on the host: its input, output and opus tasks run as threads on the
+ * FreeRTOS stubs, a DummyAudioCodec feeds the capture path and counts what reaches the speaker,
+ * and every uplink packet is looped back into the decode queue like a server echoing the user.
+ *
+ *   audio_service_benchmark [input.wav] [frames]
+ *
+ * The WAV must be 16-bit PCM, stereo is downmixed and its sample rate becomes the codec input rate.
+ * Without one a second of a voice-like signal at 16 kHz is used. Opus comes from the host libopus,
+ * the resampler in stubs/ is linear, so compare runs with each other and not with the device.
+ */
+
+#define DEFAULT_FRAMES 500
+#define OUTPUT_SAMPLE_RATE 24000
+#define DRAIN_TIMEOUT_MS 5000
+
+static uint16_t ReadU16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t ReadU32(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+static bool LoadWav(const char* path, std::vector<int16_t>& pcm, int& sample_rate) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (data.size() < 12 || memcmp(data.data(), "RIFF", 4) != 0 || memcmp(data.data() + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    int channels = 0;
+    size_t offset = 12;
+    while (offset + 8 <= data.size()) {
+        const uint8_t* chunk = data.data() + offset;
+        uint32_t size = ReadU32(chunk + 4);
+        size = std::min<size_t>(size, data.size() - offset - 8);
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+            if (ReadU16(chunk + 8) != 1 || ReadU16(chunk + 22) != 16) {
+                return false;
+            }
+            channels = ReadU16(chunk + 10);
+            sample_rate = ReadU32(chunk + 12);
+        } else if (memcmp(chunk, "data", 4) == 0 && channels > 0) {
+            size_t frames = size / (2 * channels);
+            pcm.resize(frames);
+            for (size_t i = 0; i < frames; i++) {
+                int32_t sum = 0;
+                for (int c = 0; c < channels; c++) {
+                    sum += (int16_t)ReadU16(chunk + 8 + (i * channels + c) * 2);
+                }
+                pcm[i] = sum / channels;
+            }
+            return frames > 0;
+        }
+        offset += 8 + size + (size & 1);
+    }
+    return false;
+}
+
+// Syllable-length bursts of a few harmonics, so the encoder does not see pure silence or a tone
+static void GenerateVoice(std::vector<int16_t>& pcm, int sample_rate) {
+    pcm.resize(sample_rate);
+    for (size_t i = 0; i < pcm.size(); i++) {
+        double t = (double)i / sample_rate;
+        double envelope = std::max(0.0, std::sin(2 * M_PI * 3 * t));
+        double pitch = 140 + 30 * std::sin(2 * M_PI * 0.7 * t);
+        double voice = std::sin(2 * M_PI * pitch * t) + 0.5 * std::sin(4 * M_PI * pitch * t) +
+            0.25 * std::sin(6 * M_PI * pitch * t);
+        pcm[i] = (int16_t)(6000 * envelope * voice);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<int16_t> input;
+    int input_sample_rate = 16000;
+    if (argc > 1 && !LoadWav(argv[1], input, input_sample_rate)) {
+        fprintf(stderr, "Cannot read %s, a 16-bit PCM WAV is needed\n", argv[1]);
+        return 1;
+    }
+    if (input.empty()) {
+        GenerateVoice(input, input_sample_rate);
+    }
+    int frames = argc > 2 ? atoi(argv[2]) : DEFAULT_FRAMES;
+    CHECK(frames > 0);
+
+    DummyAudioCodec codec(input_sample_rate, OUTPUT_SAMPLE_RATE);
+    codec.SetInputSource(input.data(), input.size());
+
+    std::mutex mutex;
+    std::condition_variable send_queue_available;
+    AudioService audio_service;
+    AudioServiceCallbacks callbacks;
+    callbacks.on_send_queue_available = [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        send_queue_available.notify_one();
+    };
+    audio_service.SetCallbacks(callbacks);
+    audio_service.Initialize(&codec);
+    audio_service.Start();
+
+    BenchmarkScope scope;
+    audio_service.EnableVoiceProcessing(true);
+    int sent = 0;
+    while (sent < frames) {
+        auto packet = audio_service.PopPacketFromSendQueue();
+        if (!packet) {
+            std::unique_lock<std::mutex> lock(mutex);
+            send_queue_available.wait_for(lock, std::chrono::milliseconds(10));
+            continue;
+        }
+        // The server sends the opus data without the uplink headroom
+        auto echo = AudioStreamPacket::Create();
+        echo->sample_rate = 16000;
+        echo->frame_duration = OPUS_FRAME_DURATION_MS;
+        echo->payload.assign(packet->opus_data(), packet->opus_data() + packet->opus_size());
+        packet.reset();
+        CHECK(audio_service.PushPacketToDecodeQueue(std::move(echo), true));
+        audio_service.OnPacketSent(true);
+        sent++;
+    }
+    audio_service.EnableVoiceProcessing(false);
+
+    size_t expected = (size_t)frames * OUTPUT_SAMPLE_RATE * OPUS_FRAME_DURATION_MS / 1000;
+    int64_t deadline_ns = BenchmarkNowNs() + (int64_t)DRAIN_TIMEOUT_MS * 1000000;
+    while (codec.samples_written() < expected && BenchmarkNowNs() < deadline_ns) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    scope.Stop();
+    size_t played = codec.samples_written();
+
+    audio_service.Stop();
+    host_join_tasks();
+
+    double audio_ms = (double)frames * OPUS_FRAME_DURATION_MS;
+    double elapsed_ms = scope.elapsed_ns / 1e6;
+    printf("%d frames at %d Hz in, %d Hz out: %.1f ms for %.0f ms of audio, %.1fx realtime\n",
+        frames, input_sample_rate, OUTPUT_SAMPLE_RATE, elapsed_ms, audio_ms, audio_ms / elapsed_ms);
+    printf("played %zu of %zu samples, %.2f allocations and %.0f bytes per frame\n",
+        played, expected, (double)scope.allocations / frames, (double)scope.bytes / frames);
+    fflush(stdout);
+    audio_service.PrintDebugStatistics();
+    return played >= expected ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#include "host_benchmark.h"
+
+#include <cstdlib>
+#include <new>
+
+std::atomic<size_t> g_allocation_count = 0;
+std::atomic<size_t> g_allocation_bytes = 0;
+
+void* operator new(size_t size) {
+    g_allocation_count++;
+    g_allocation_bytes += size;
+    if (void* pointer = malloc(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
@@ -0,0 +1,39 @@
+#ifndef HOST_BENCHMARK_H
+#define HOST_BENCHMARK_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Heap allocations made through operator new, counted by host_benchmark.cc (from any thread)
+extern std::atomic<size_t> g_allocation_count;
+extern std::atomic<size_t> g_allocation_bytes;
+
+inline int64_t BenchmarkNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Allocations and time of everything between construction and Stop()
+class BenchmarkScope {
+public:
+    BenchmarkScope() : allocations_(g_allocation_count), bytes_(g_allocation_bytes), start_ns_(BenchmarkNowNs()) {}
+
+    void Stop() {
+        elapsed_ns = BenchmarkNowNs() - start_ns_;
+        allocations = g_allocation_count - allocations_;
+        bytes = g_allocation_bytes - bytes_;
+    }
+
+    int64_t elapsed_ns = 0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+
+private:
+    size_t allocations_;
+    size_t bytes_;
+    int64_t start_ns_;
+};
+
+#endif // HOST_BENCHMARK_H
@@ -0,0 +1,16 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <cstdio>
+#include <cstdlib>
+
+// Host tests are plain executables, a failed check prints where and exits with an error for ctest
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            exit(1); \
+        } \
+    } while (0)
+
+#endif // HOST_TEST_H
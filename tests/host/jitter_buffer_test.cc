@@ -0,0 +1,186 @@
+#include "host_test.h"
+#include "jitter_buffer.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#define FRAME_MS 60
+#define PLAYED_LOST -1
+
+static std::unique_ptr<AudioStreamPacket> Packet(uint32_t sequence) {
+    auto packet = AudioStreamPacket::Create();
+    packet->sequence = sequence;
+    packet->frame_duration = FRAME_MS;
+    return packet;
+}
+
+// Pops like the decode task: the sequence played, PLAYED_LOST for a concealed frame, nothing when idle
+static void Drain(JitterBuffer& buffer, int64_t now_ms, std::vector<int>& played) {
+    while (true) {
+        std::unique_ptr<AudioStreamPacket> packet;
+        auto result = buffer.Pop(packet, now_ms);
+        if (result == JitterBuffer::kPopNone) {
+            return;
+        }
+        played.push_back(result == JitterBuffer::kPopPacket ? (int)packet->sequence : PLAYED_LOST);
+    }
+}
+
+static void TestReorderLossAndDuplicates() {
+    JitterBuffer buffer;
+    std::vector<int> played;
+    int64_t now_ms = 1000;
+    // 2 and 3 swapped, 5 lost, 6 duplicated, 2 again after it was played
+    for (uint32_t sequence : {1, 3, 2, 4, 6, 6, 7, 2}) {
+        buffer.Push(Packet(sequence), now_ms);
+        now_ms += FRAME_MS;
+        Drain(buffer, now_ms, played);
+    }
+    for (int i = 0; i < 10; i++) {
+        now_ms += FRAME_MS;
+        Drain(buffer, now_ms, played);
+    }
+    CHECK((played == std::vector<int>{1, 2, 3, 4, PLAYED_LOST, 6, 7}));
+    auto& statistics = buffer.statistics();
+    CHECK(statistics.received == 6);
+    CHECK(statistics.duplicate == 1);
+    CHECK(statistics.late == 1);
+    CHECK(statistics.lost == 1 && statistics.concealed == 1);
+    CHECK(buffer.empty());
+}
+
+static void TestOldPacketBeforePlayout() {
+    // Nothing has played yet, a packet a full buffer below the first one must not take its slot
+    JitterBuffer buffer;
+    int64_t now_ms = 1000;
+    CHECK(buffer.Push(Packet(40), now_ms));
+    CHECK(buffer.Push(Packet(41), now_ms));
+    CHECK(!buffer.Push(Packet(40 - JITTER_BUFFER_CAPACITY), now_ms));
+    CHECK(!buffer.Push(Packet(41 - JITTER_BUFFER_CAPACITY - 5), now_ms));
+    CHECK(buffer.statistics().late == 2);
+    // One that still fits becomes the new start of playout
+    CHECK(buffer.Push(Packet(41 - JITTER_BUFFER_CAPACITY + 1), now_ms));
+
+    std::vector<int> played;
+    Drain(buffer, now_ms + 10 * FRAME_MS, played);
+    CHECK(!played.empty() && played.front() == 41 - JITTER_BUFFER_CAPACITY + 1);
+    CHECK(std::find(played.begin(), played.end(), 40) != played.end());
+    CHECK(std::find(played.begin(), played.end(), 41) != played.end());
+    CHECK(buffer.empty());
+}
+
+static void TestRestartAfterSilence() {
+    JitterBuffer buffer;
+    std::vector<int> played;
+    int64_t now_ms = 1000;
+    for (uint32_t sequence = 100; sequence < 105; sequence++) {
+        buffer.Push(Packet(sequence), now_ms);
+        now_ms += FRAME_MS;
+        Drain(buffer, now_ms, played);
+    }
+    Drain(buffer, now_ms + 10 * FRAME_MS, played);
+    // The channel was reopened and the server counts from 1 again
+    now_ms += 5000;
+    played.clear();
+    CHECK(buffer.Push(Packet(1), now_ms));
+    CHECK(buffer.Push(Packet(2), now_ms + FRAME_MS));
+    Drain(buffer, now_ms + 10 * FRAME_MS, played);
+    CHECK((played == std::vector<int>{1, 2}));
+}
+
+static void TestPauseBetweenReplies() {
+    JitterBuffer buffer;
+    std::vector<int> played;
+    int64_t now_ms = 1000;
+    uint32_t sequence = 1;
+    for (int i = 0; i < 20; i++) {
+        buffer.Push(Packet(sequence++), now_ms);
+        now_ms += FRAME_MS;
+        Drain(buffer, now_ms, played);
+    }
+    CHECK(buffer.jitter_ms() == 0);
+    CHECK(buffer.target_delay_frames() == JITTER_BUFFER_MIN_DELAY_FRAMES);
+
+    // The next reply continues the sequence after 5 s of silence
+    now_ms += 5000;
+    for (int i = 0; i < 20; i++) {
+        buffer.Push(Packet(sequence++), now_ms);
+        now_ms += FRAME_MS;
+        Drain(buffer, now_ms, played);
+    }
+    CHECK(buffer.jitter_ms() == 0);
+    CHECK(buffer.target_delay_frames() == JITTER_BUFFER_MIN_DELAY_FRAMES);
+}
+
+// Replays a jittery, lossy, reordering network trace against a decode task popping once per frame
+static void TestTraceReplay() {
+    struct Arrival {
+        int64_t time_ms;
+        uint32_t sequence;
+    };
+    std::mt19937 random(1234);
+    std::uniform_int_distribution<int> delay(0, 2 * FRAME_MS);
+    std::uniform_int_distribution<int> percent(0, 99);
+    const uint32_t frames = 2000;
+    std::vector<Arrival> trace;
+    for (uint32_t sequence = 1; sequence <= frames; sequence++) {
+        if (percent(random) < 3) {
+            continue;
+        }
+        trace.push_back({sequence * FRAME_MS + delay(random), sequence});
+        if (percent(random) < 1) {
+            trace.push_back({sequence * FRAME_MS + delay(random), sequence});
+        }
+    }
+    std::stable_sort(trace.begin(), trace.end(), [](const Arrival& a, const Arrival& b) {
+        return a.time_ms < b.time_ms;
+    });
+
+    JitterBuffer buffer;
+    std::vector<int> played;
+    size_t next = 0;
+    for (int64_t now_ms = 0; now_ms < (frames + 20) * FRAME_MS; now_ms += 10) {
+        while (next < trace.size() && trace[next].time_ms <= now_ms) {
+            buffer.Push(Packet(trace[next].sequence), now_ms);
+            next++;
+        }
+        if (now_ms % FRAME_MS == 0) {
+            std::unique_ptr<AudioStreamPacket> packet;
+            auto result = buffer.Pop(packet, now_ms);
+            if (result != JitterBuffer::kPopNone) {
+                played.push_back(result == JitterBuffer::kPopPacket ? (int)packet->sequence : PLAYED_LOST);
+            }
+        }
+    }
+    Drain(buffer, INT64_MAX / 2, played);
+
+    // Frames come out in order, each at most once, and every frame is accounted for
+    int last = 0;
+    uint32_t packets = 0;
+    for (int sequence : played) {
+        if (sequence != PLAYED_LOST) {
+            CHECK(sequence > last);
+            last = sequence;
+            packets++;
+        }
+    }
+    auto& statistics = buffer.statistics();
+    CHECK(statistics.received == packets);
+    CHECK(statistics.received + statistics.lost + statistics.late >= frames - 1);
+    CHECK(statistics.concealed <= statistics.lost);
+    CHECK(buffer.target_delay_frames() >= JITTER_BUFFER_MIN_DELAY_FRAMES &&
+          buffer.target_delay_frames() <= JITTER_BUFFER_MAX_DELAY_FRAMES);
+    printf("trace: %u frames, %u played, %u late, %u lost, %u concealed, target %d frames, jitter %d ms\n",
+        frames, statistics.received, statistics.late, statistics.lost, statistics.concealed,
+        buffer.target_delay_frames(), buffer.jitter_ms());
+}
+
+int main() {
+    TestReorderLossAndDuplicates();
+    TestOldPacketBeforePlayout();
+    TestRestartAfterSilence();
+    TestPauseBetweenReplies();
+    TestTraceReplay();
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include "host_test.h"
+#include "keyword_matcher.h"
+
+int main() {
+    KeywordMatcher matcher;
+    matcher.Add("bắn", 0);
+    matcher.Add("múa", 1);
+    matcher.Add("chào", 2);
+    matcher.Add("đi tới", 3);
+    matcher.Add("happy birthday", 4);
+    matcher.Build();
+
+    // Accented transcripts need the exact marks
+    CHECK(matcher.Match("Bắn đi") == 1u << 0);
+    CHECK(matcher.Match("BẮN") == 1u << 0);
+    CHECK(matcher.Match("bạn ơi") == 0);
+    CHECK(matcher.Match("Mẹ mua cho mình cái bánh") == 0);
+    CHECK(matcher.Match("Cho mình xem múa đi") == 1u << 1);
+    CHECK(matcher.Match("Xin chào, bạn tên là gì?") == 1u << 2);
+    CHECK(matcher.Match("Otto ơi Đi Tới") == 1u << 3);
+    // An unaccented word in an accented transcript is a different word
+    CHECK(matcher.Match("mình chao ôi") == 0);
+
+    // Transcripts without any accent fall back to the folded comparison
+    CHECK(matcher.Match("ban di") == 1u << 0);
+    CHECK(matcher.Match("xin chao ban") == ((1u << 0) | (1u << 2)));
+    CHECK(matcher.Match("di toi") == 1u << 3);
+    CHECK(matcher.Match("Happy Birthday Otto") == 1u << 4);
+
+    // Whole words only
+    CHECK(matcher.Match("banh mi") == 0);
+    CHECK(matcher.Match("di toii") == 0);
+
+    // Decomposed accents count as accented and never match an accented letter
+    CHECK(matcher.Match("ba\xcc\x81n") == 0);
+
+    printf("keyword_matcher_test passed\n");
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "host_benchmark.h"
+#include "mcp_tool_index.h"
+
+#include <algorithm>
+#include <cstdio>
+
+/*
+ * Times tools/list and tools/call dispatch over a tool set the size of the firmware's, with the
+ * previous linear scans (to_json() of every listed tool per request, find_if by name) and with
+ * McpToolIndex. Every page is walked through its nextCursor chain, with and without user only
+ * tools, and the pages of both are compared.
+ *
+ * to_json() here only concatenates strings. The firmware builds a cJSON tree per tool and prints
+ * it, so on the device the uncached path is slower than shown.
+ */
+
+#define ROUNDS 2000
+#define TOOL_COUNT 60
+
+class BenchmarkTool {
+public:
+    BenchmarkTool(const std::string& name, bool user_only) : name_(name), user_only_(user_only) {
+        description_ = "Description of " + name + ", as long as a typical tool description with usage notes";
+    }
+
+    const std::string& name() const { return name_; }
+    bool user_only() const { return user_only_; }
+    std::string to_json() const {
+        std::string json = "{\"name\":\"" + name_ + "\",\"description\":\"" + description_ + "\",";
+        json += "\"inputSchema\":{\"type\":\"object\",\"properties\":{\"value\":{\"type\":\"integer\",\"minimum\":0,\"maximum\":100}},";
+        json += "\"required\":[\"value\"]}";
+        if (user_only_) {
+            json += ",\"annotations\":{\"audience\":[\"user\"]}";
+        }
+        return json + "}";
+    }
+
+private:
+    std::string name_;
+    bool user_only_;
+    std::string description_;
+};
+
+// The tools/list handler before McpToolIndex
+static std::string LegacyToolsList(const std::vector<BenchmarkTool*>& tools, const std::string& cursor, bool list_user_only_tools, std::string& next_cursor) {
+    std::string json = "{\"tools\":[";
+    bool found_cursor = cursor.empty();
+    next_cursor.clear();
+    for (auto it = tools.begin(); it != tools.end(); ++it) {
+        if (!found_cursor) {
+            if ((*it)->name() != cursor) {
+                continue;
+            }
+            found_cursor = true;
+        }
+        if (!list_user_only_tools && (*it)->user_only()) {
+            continue;
+        }
+        std::string tool_json = (*it)->to_json() + ",";
+        if (json.length() + tool_json.length() + 30 > MCP_TOOLS_LIST_MAX_PAYLOAD_SIZE) {
+            next_cursor = (*it)->name();
+            break;
+        }
+        json += tool_json;
+    }
+    if (json.back() == ',') {
+        json.pop_back();
+    }
+    if (next_cursor.empty()) {
+        json += "]}";
+    } else {
+        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+    }
+    return json;
+}
+
+int main() {
+    std::vector<BenchmarkTool*> tools;
+    McpToolIndex<BenchmarkTool> index;
+    for (int i = 0; i < TOOL_COUNT; i++) {
+        // About a third of the firmware's tools are user only
+        auto tool = new BenchmarkTool("self.tool_" + std::to_string(i), i % 3 == 2);
+        tools.push_back(tool);
+        index.Add(new BenchmarkTool(tool->name(), tool->user_only()));
+    }
+
+    // The cursors of each page, taken from the legacy walk
+    std::vector<std::string> cursors[2];
+    std::vector<std::string> legacy_pages[2];
+    BenchmarkScope legacy_list;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int user = 0; user < 2; user++) {
+            std::string cursor, next_cursor;
+            do {
+                auto page = LegacyToolsList(tools, cursor, user == 1, next_cursor);
+                if (round == 0) {
+                    cursors[user].push_back(cursor);
+                    legacy_pages[user].push_back(std::move(page));
+                }
+                cursor = next_cursor;
+            } while (!cursor.empty());
+        }
+    }
+    legacy_list.Stop();
+
+    // The first walk fills the page cache
+    int mismatches = 0;
+    std::string page, error;
+    for (int user = 0; user < 2; user++) {
+        for (size_t i = 0; i < cursors[user].size(); i++) {
+            if (!index.GetPage(cursors[user][i], user == 1, page, error) || page != legacy_pages[user][i]) {
+                mismatches++;
+            }
+        }
+    }
+    BenchmarkScope list;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int user = 0; user < 2; user++) {
+            for (auto& cursor : cursors[user]) {
+                index.GetPage(cursor, user == 1, page, error);
+            }
+        }
+    }
+    list.Stop();
+
+    // tools/call dispatch, every tool name looked up once per round
+    int found = 0;
+    BenchmarkScope legacy_call;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (auto tool : tools) {
+            auto& name = tool->name();
+            auto it = std::find_if(tools.begin(), tools.end(), [&name](const BenchmarkTool* t) { return t->name() == name; });
+            found += it != tools.end();
+        }
+    }
+    legacy_call.Stop();
+    BenchmarkScope call;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (auto tool : tools) {
+            found += index.Find(tool->name()) != nullptr;
+        }
+    }
+    call.Stop();
+
+    int pages = cursors[0].size() + cursors[1].size();
+    int lists = ROUNDS * pages;
+    int lookups = ROUNDS * TOOL_COUNT;
+    printf("%d tools, %d pages, %d mismatches, %d of %d lookups found\n", TOOL_COUNT, pages, mismatches, found, 2 * lookups);
+    printf("  tools/list legacy:  %7.0f ns/page, %5.1f allocations/page\n",
+        (double)legacy_list.elapsed_ns / lists, (double)legacy_list.allocations / lists);
+    printf("  tools/list cached:  %7.0f ns/page, %5.1f allocations/page\n",
+        (double)list.elapsed_ns / lists, (double)list.allocations / lists);
+    printf("  tools/call find_if: %7.0f ns/lookup\n", (double)legacy_call.elapsed_ns / lookups);
+    printf("  tools/call index:   %7.0f ns/lookup\n", (double)call.elapsed_ns / lookups);
+
+    for (auto tool : tools) {
+        delete tool;
+    }
+    return mismatches == 0 ? 0 : 1;
+}
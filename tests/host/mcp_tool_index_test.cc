@@ -0,0 +1,129 @@
+#include "host_test.h"
+#include "mcp_tool_index.h"
+
+#include <atomic>
+#include <thread>
+
+class FakeTool {
+public:
+    FakeTool(const std::string& name, bool user_only = false, size_t description_size = 40)
+        : name_(name), user_only_(user_only), description_(description_size, 'd') {}
+
+    const std::string& name() const { return name_; }
+    bool user_only() const { return user_only_; }
+    std::string to_json() const {
+        return "{\"name\":\"" + name_ + "\",\"description\":\"" + description_ + "\"}";
+    }
+
+private:
+    std::string name_;
+    bool user_only_;
+    std::string description_;
+};
+
+// Walks the nextCursor chain and returns the tool names in listed order
+static std::vector<std::string> ListAll(McpToolIndex<FakeTool>& index, bool user_only, int& pages) {
+    std::vector<std::string> names;
+    std::string cursor, page, error;
+    pages = 0;
+    do {
+        CHECK(index.GetPage(cursor, user_only, page, error));
+        pages++;
+        for (size_t at = page.find("\"name\":\""); at != std::string::npos; at = page.find("\"name\":\"", at + 1)) {
+            size_t start = at + 8;
+            names.push_back(page.substr(start, page.find('"', start) - start));
+        }
+        size_t next = page.find("\"nextCursor\":\"");
+        cursor = next == std::string::npos ? "" : page.substr(next + 14, page.find('"', next + 14) - next - 14);
+    } while (!cursor.empty());
+    return names;
+}
+
+static void TestIndexAndPages() {
+    McpToolIndex<FakeTool> index;
+    CHECK(index.Add(new FakeTool("a")));
+    CHECK(index.Add(new FakeTool("b", true)));
+    auto duplicate = new FakeTool("a");
+    CHECK(!index.Add(duplicate));
+    delete duplicate;
+    CHECK(index.size() == 2);
+    CHECK(index.Find("b") != nullptr && index.Find("b")->user_only());
+    CHECK(index.Find("c") == nullptr);
+
+    // Tools added later move to the front, as AddCommonTools does
+    size_t count = index.size();
+    CHECK(index.Add(new FakeTool("common")));
+    index.MoveToFront(count);
+    int pages = 0;
+    CHECK((ListAll(index, true, pages) == std::vector<std::string>{"common", "a", "b"}));
+    CHECK((ListAll(index, false, pages) == std::vector<std::string>{"common", "a"}));
+
+    // A cached page is dropped when a tool is added
+    CHECK(index.Add(new FakeTool("late")));
+    CHECK((ListAll(index, false, pages) == std::vector<std::string>{"common", "a", "late"}));
+
+    std::string page, error;
+    CHECK(!index.GetPage("missing", false, page, error));
+    CHECK(error == "Invalid cursor: missing");
+}
+
+static void TestPaging() {
+    McpToolIndex<FakeTool> index;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 100; i++) {
+        std::string name = "tool_" + std::to_string(i);
+        index.Add(new FakeTool(name, i % 5 == 0, 300));
+        if (i % 5 != 0) {
+            expected.push_back(name);
+        }
+    }
+    int pages = 0;
+    CHECK(ListAll(index, false, pages) == expected);
+    CHECK(pages > 1);
+    std::string page, error;
+    for (int i = 0; i < 3; i++) {
+        CHECK(index.GetPage("", true, page, error));
+        CHECK(page.size() <= MCP_TOOLS_LIST_MAX_PAYLOAD_SIZE);
+    }
+
+    // A tool that does not fit in a page on its own is an error
+    McpToolIndex<FakeTool> oversized;
+    oversized.Add(new FakeTool("huge", false, MCP_TOOLS_LIST_MAX_PAYLOAD_SIZE));
+    CHECK(!oversized.GetPage("", false, page, error));
+}
+
+// Tools are added while tools/list and tools/call are served from other tasks (run under TSan)
+static void TestConcurrentAccess() {
+    McpToolIndex<FakeTool> index;
+    index.Add(new FakeTool("first"));
+    std::atomic<bool> done = false;
+
+    std::thread adder([&]() {
+        for (int i = 0; i < 2000; i++) {
+            index.Add(new FakeTool("tool_" + std::to_string(i)));
+        }
+        done = true;
+    });
+    auto reader = [&](bool user_only) {
+        std::string page, error;
+        while (!done) {
+            CHECK(index.Find("first") != nullptr);
+            CHECK(index.GetPage("", user_only, page, error));
+            CHECK(page.find("\"first\"") != std::string::npos);
+        }
+    };
+    std::thread lister(reader, false);
+    std::thread caller(reader, true);
+    adder.join();
+    lister.join();
+    caller.join();
+    CHECK(index.size() == 2001);
+    CHECK(index.Find("tool_1999") != nullptr);
+}
+
+int main() {
+    TestIndexAndPages();
+    TestPaging();
+    TestConcurrentAccess();
+    return 0;
+}
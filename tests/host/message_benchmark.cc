@@ -0,0 +1,92 @@
+#include "host_benchmark.h"
+#include "server_message.h"
+
+#include <cJSON.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Parses a recorded trace of server text frames with cJSON, as the protocols did for every frame,
+ * and with ServerMessageParser falling back to cJSON for the frames it does not take, as they do
+ * now. Prints the time and heap allocations per message. cJSON allocations are counted through
+ * cJSON_InitHooks, which is safe here because nothing else in the process uses cJSON.
+ */
+
+#define ROUNDS 20000
+
+// Frames recorded from a conversation, in arrival order
+static const char* const kMessageTrace[] = {
+    R"({"type":"stt","text":"kể cho tôi nghe một câu chuyện ngắn","session_id":"3f1c2a7e"})",
+    R"({"type":"llm","text":"😊","emotion":"happy","session_id":"3f1c2a7e"})",
+    R"({"type":"tts","state":"start","sample_rate":24000,"session_id":"3f1c2a7e"})",
+    R"({"type":"tts","state":"sentence_start","text":"Ngày xửa ngày xưa, có một chú robot nhỏ tên là Otto.","session_id":"3f1c2a7e"})",
+    R"({"type":"tts","state":"sentence_end","text":"Ngày xửa ngày xưa, có một chú robot nhỏ tên là Otto.","session_id":"3f1c2a7e"})",
+    R"({"type":"tts","state":"sentence_start","text":"Otto rất thích nhảy múa \"mỗi khi\" nghe thấy nhạc.","session_id":"3f1c2a7e"})",
+    R"({"type":"tts","state":"sentence_end","text":"Otto rất thích nhảy múa \"mỗi khi\" nghe thấy nhạc.","session_id":"3f1c2a7e"})",
+    R"({"type":"tts","state":"sentence_start","text":"Một hôm, Otto gặp một chú mèo.","session_id":"3f1c2a7e"})",
+    R"({"type":"tts","state":"sentence_end","text":"Một hôm, Otto gặp một chú mèo.","session_id":"3f1c2a7e"})",
+    R"({"type":"tts","state":"stop","session_id":"3f1c2a7e"})",
+    R"({"session_id":"3f1c2a7e","type":"mcp","payload":{"jsonrpc":"2.0","method":"tools/call","params":{"name":"self.get_device_status","arguments":{}},"id":7}})",
+};
+
+static void* CountingMalloc(size_t size) {
+    g_allocation_count++;
+    g_allocation_bytes += size;
+    return malloc(size);
+}
+
+int main() {
+    const int count = sizeof(kMessageTrace) / sizeof(kMessageTrace[0]);
+    size_t lengths[count];
+    for (int i = 0; i < count; i++) {
+        lengths[i] = strlen(kMessageTrace[i]);
+    }
+    cJSON_Hooks hooks = { CountingMalloc, free };
+    cJSON_InitHooks(&hooks);
+
+    BenchmarkScope cjson;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < count; i++) {
+            auto root = cJSON_Parse(kMessageTrace[i]);
+            auto type = cJSON_GetObjectItem(root, "type");
+            auto state = cJSON_GetObjectItem(root, "state");
+            auto text = cJSON_GetObjectItem(root, "text");
+            if (!cJSON_IsString(type) || (state != nullptr && !cJSON_IsString(state)) || (text != nullptr && !cJSON_IsString(text))) {
+                fprintf(stderr, "cJSON failed on message %d\n", i);
+                return 1;
+            }
+            cJSON_Delete(root);
+        }
+    }
+    cjson.Stop();
+
+    // The parser's text buffer grows on the first message and keeps its capacity after that
+    ServerMessageParser parser;
+    ServerMessage warmup;
+    parser.Parse(kMessageTrace[3], lengths[3], warmup);
+
+    int fast = 0;
+    BenchmarkScope fast_path;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < count; i++) {
+            ServerMessage message;
+            if (parser.Parse(kMessageTrace[i], lengths[i], message)) {
+                fast++;
+                continue;
+            }
+            auto root = cJSON_Parse(kMessageTrace[i]);
+            cJSON_Delete(root);
+        }
+    }
+    fast_path.Stop();
+    cJSON_InitHooks(nullptr);
+
+    int messages = ROUNDS * count;
+    printf("%d messages, %d taken by the fast path\n", messages, fast);
+    printf("  cJSON:     %6.0f ns/message, %5.1f allocations/message, %6.0f bytes/message\n",
+        (double)cjson.elapsed_ns / messages, (double)cjson.allocations / messages, (double)cjson.bytes / messages);
+    printf("  fast path: %6.0f ns/message, %5.1f allocations/message, %6.0f bytes/message\n",
+        (double)fast_path.elapsed_ns / messages, (double)fast_path.allocations / messages, (double)fast_path.bytes / messages);
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "host_test.h"
+#include "audio_packet_pool.h"
+
+#include <set>
+#include <vector>
+
+static void TestObjectPool() {
+    ObjectPool<std::vector<int>, 4> pool;
+    CHECK(pool.capacity() == 4);
+
+    // Released objects come back with their capacity
+    auto first = pool.Acquire();
+    CHECK(pool.Owns(first));
+    first->resize(100);
+    auto data = first->data();
+    CHECK(pool.Release(first));
+    auto again = pool.Acquire();
+    CHECK(again == first);
+    CHECK(again->data() == data && again->capacity() >= 100);
+    CHECK(pool.Release(again));
+
+    // Past the capacity objects come from the heap, are counted and not taken back
+    std::vector<std::vector<int>*> objects;
+    for (int i = 0; i < 5; i++) {
+        objects.push_back(pool.Acquire());
+    }
+    CHECK(pool.heap_allocations() == 1);
+    CHECK(pool.high_water() == 4);
+    CHECK(!pool.Owns(objects[4]));
+    CHECK(!pool.Release(objects[4]));
+    delete objects[4];
+    for (int i = 0; i < 4; i++) {
+        CHECK(pool.Release(objects[i]));
+    }
+    CHECK(pool.acquired() == 7);
+}
+
+static void TestAudioStreamPacket() {
+    auto& pool = GetPacketPool();
+    uint32_t heap_allocations = pool.heap_allocations();
+
+    // Destroying delete returns the packet to the pool, Create() resets it but keeps the payload buffer
+    AudioStreamPacket* address;
+    const uint8_t* payload;
+    {
+        auto packet = AudioStreamPacket::Create();
+        CHECK(pool.Owns(packet.get()));
+        packet->sequence = 7;
+        packet->timestamp = 1234;
+        packet->payload.assign(200, 0x55);
+        address = packet.get();
+        payload = packet->payload.data();
+    }
+    auto packet = AudioStreamPacket::Create();
+    CHECK(packet.get() == address);
+    CHECK(packet->sequence == 0 && packet->timestamp == 0);
+    CHECK(packet->payload.empty() && packet->payload.capacity() >= 200);
+    CHECK(packet->payload.data() == payload);
+    packet.reset();
+
+    // Drain the pool, the next packet falls back to the heap and is freed when deleted
+    std::vector<std::unique_ptr<AudioStreamPacket>> packets;
+    std::set<AudioStreamPacket*> addresses;
+    for (size_t i = 0; i < pool.capacity(); i++) {
+        packets.push_back(AudioStreamPacket::Create());
+        CHECK(pool.Owns(packets.back().get()));
+        addresses.insert(packets.back().get());
+    }
+    CHECK(addresses.size() == pool.capacity());
+    CHECK(pool.heap_allocations() == heap_allocations);
+    auto extra = AudioStreamPacket::Create();
+    CHECK(!pool.Owns(extra.get()));
+    CHECK(pool.heap_allocations() == heap_allocations + 1);
+    extra.reset();
+
+    // Every pooled packet goes back, so the pool serves a full set again without the heap
+    packets.clear();
+    for (size_t i = 0; i < pool.capacity(); i++) {
+        packets.push_back(AudioStreamPacket::Create());
+        CHECK(addresses.count(packets.back().get()) == 1);
+    }
+    CHECK(pool.heap_allocations() == heap_allocations + 1);
+    CHECK(pool.high_water() == pool.capacity());
+}
+
+int main() {
+    TestObjectPool();
+    TestAudioStreamPacket();
+    printf("object_pool_test passed\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "host_benchmark.h"
+#include "host_test.h"
+#include "audio/pcm_kernels.h"
+
+#include <cstring>
+#include <vector>
+
+/*
+ * Stereo capture conversion of ReadAudioData without the resampler: split mic and reference,
+ * then interleave them again. The legacy path is the code before the scratch buffers, four
+ * vectors per read and scalar loops; the resampler is replaced by a copy in both.
+ *
+ * On the host the kernels take their scalar fallback, so this shows what the scratch buffers
+ * save. The PIE blocks only run on ESP32-S3, where PrintDebugStatistics() logs the (de)interleave
+ * cycles per frame apart from the resampling.
+ */
+
+#define INPUT_FRAMES 1440   // 60 ms at 24 kHz
+#define ROUNDS 20000
+
+static void LegacyConvert(std::vector<int16_t>& data) {
+    auto mic_channel = std::vector<int16_t>(data.size() / 2);
+    auto reference_channel = std::vector<int16_t>(data.size() / 2);
+    for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
+        mic_channel[i] = data[j];
+        reference_channel[i] = data[j + 1];
+    }
+    auto resampled_mic = std::vector<int16_t>(mic_channel.size());
+    auto resampled_reference = std::vector<int16_t>(reference_channel.size());
+    memcpy(resampled_mic.data(), mic_channel.data(), mic_channel.size() * sizeof(int16_t));
+    memcpy(resampled_reference.data(), reference_channel.data(), reference_channel.size() * sizeof(int16_t));
+    data.resize(resampled_mic.size() + resampled_reference.size());
+    for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
+        data[j] = resampled_mic[i];
+        data[j + 1] = resampled_reference[i];
+    }
+}
+
+struct Scratch {
+    std::vector<int16_t> mic;
+    std::vector<int16_t> reference;
+    std::vector<int16_t> resampled_mic;
+    std::vector<int16_t> resampled_reference;
+};
+
+static void Convert(std::vector<int16_t>& data, Scratch& scratch) {
+    size_t frames = data.size() / 2;
+    size_t lead = PcmAlignmentLead(data.data());
+    int16_t* mic = AlignPcmScratch(scratch.mic, frames, lead);
+    int16_t* reference = AlignPcmScratch(scratch.reference, frames, lead);
+    DeinterleaveStereo(data.data(), mic, reference, frames);
+    int16_t* resampled_mic = AlignPcmScratch(scratch.resampled_mic, frames, lead);
+    int16_t* resampled_reference = AlignPcmScratch(scratch.resampled_reference, frames, lead);
+    memcpy(resampled_mic, mic, frames * sizeof(int16_t));
+    memcpy(resampled_reference, reference, frames * sizeof(int16_t));
+    InterleaveStereo(resampled_mic, resampled_reference, data.data(), frames);
+}
+
+static void Fill(std::vector<int16_t>& data, int round) {
+    data.resize(INPUT_FRAMES * 2);
+    for (size_t i = 0; i < data.size(); i++) {
+        data[i] = (int16_t)(i * 7 + round);
+    }
+}
+
+int main() {
+    std::vector<int16_t> legacy, current, expected;
+    Scratch scratch;
+    Fill(legacy, 0);
+    Fill(current, 0);
+    expected = legacy;
+    LegacyConvert(legacy);
+    Convert(current, scratch);
+    CHECK(legacy == expected && current == expected);
+
+    int64_t fill_ns = 0;
+    BenchmarkScope legacy_scope;
+    for (int round = 0; round < ROUNDS; round++) {
+        int64_t start = BenchmarkNowNs();
+        Fill(legacy, round);
+        fill_ns += BenchmarkNowNs() - start;
+        LegacyConvert(legacy);
+    }
+    legacy_scope.Stop();
+    int64_t legacy_ns = legacy_scope.elapsed_ns - fill_ns;
+
+    fill_ns = 0;
+    BenchmarkScope current_scope;
+    for (int round = 0; round < ROUNDS; round++) {
+        int64_t start = BenchmarkNowNs();
+        Fill(current, round);
+        fill_ns += BenchmarkNowNs() - start;
+        Convert(current, scratch);
+    }
+    current_scope.Stop();
+    int64_t current_ns = current_scope.elapsed_ns - fill_ns;
+
+    printf("stereo input convert, %d frames of %d stereo samples\n", ROUNDS, INPUT_FRAMES);
+    printf("  legacy:  %6.0f ns/frame, %.1f allocations/frame, %zu bytes/frame\n",
+        (double)legacy_ns / ROUNDS, (double)legacy_scope.allocations / ROUNDS, legacy_scope.bytes / ROUNDS);
+    printf("  scratch: %6.0f ns/frame, %.1f allocations/frame, %zu bytes/frame\n",
+        (double)current_ns / ROUNDS, (double)current_scope.allocations / ROUNDS, current_scope.bytes / ROUNDS);
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include "host_test.h"
+#include "audio/spsc_ring.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * SpscRing with a real producer and consumer thread: every item arrives once and in order, and
+ * Clear() from a third thread only ever drops a prefix. Then the wakeups of three producer /
+ * consumer pairs are counted twice, once with the old shared deque mutex and notify_all(), once
+ * with a ring and a wakeup per queue like AudioService.
+ */
+
+#define STRESS_ITEMS 2000000
+#define WAKEUP_ITEMS 20000
+
+static std::atomic<int> g_live_items{0};
+
+struct Item {
+    explicit Item(uint32_t sequence) : sequence(sequence) { g_live_items++; }
+    ~Item() { g_live_items--; }
+    uint32_t sequence;
+};
+
+static void TestOrder() {
+    SpscRing<std::unique_ptr<Item>, 12> ring;
+    std::thread producer([&ring] {
+        for (uint32_t i = 0; i < STRESS_ITEMS; i++) {
+            auto item = std::make_unique<Item>(i);
+            while (!ring.Push(std::move(item))) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint32_t expected = 0;
+    std::unique_ptr<Item> item;
+    while (expected < STRESS_ITEMS) {
+        if (!ring.Pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        CHECK(item->sequence == expected);
+        expected++;
+    }
+    producer.join();
+    item.reset();
+    CHECK(ring.empty());
+    CHECK(g_live_items == 0);
+}
+
+static void TestClear() {
+    SpscRing<std::unique_ptr<Item>, 8> ring;
+    std::atomic<bool> done{false};
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < STRESS_ITEMS; i++) {
+            auto item = std::make_unique<Item>(i);
+            while (!ring.Push(std::move(item))) {
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    });
+    std::thread clearer([&] {
+        while (!done) {
+            ring.Clear();
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    });
+
+    // Cleared items are skipped, the rest must still come strictly in order
+    uint32_t received = 0;
+    int64_t last = -1;
+    std::unique_ptr<Item> item;
+    while (!done || !ring.empty()) {
+        if (!ring.Pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        CHECK((int64_t)item->sequence > last);
+        last = item->sequence;
+        received++;
+    }
+    producer.join();
+    clearer.join();
+    ring.ApplyPendingClear();
+    item.reset();
+    CHECK(received > 0 && received <= STRESS_ITEMS);
+    // Whatever was cleared has been destroyed, nothing is left in the slots
+    CHECK(g_live_items == 0);
+    printf("clear: %u of %u items received, %u cleared\n", received, STRESS_ITEMS, STRESS_ITEMS - received);
+}
+
+// Three pairs, like the encode, decode and playback queues
+#define PAIRS 3
+
+struct Wakeups {
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> wasted{0};    // Woken up with nothing to do for this thread
+
+    void Count(bool wasted_wakeup) {
+        total++;
+        if (wasted_wakeup) {
+            wasted++;
+        }
+    }
+};
+
+static void CountSharedWakeups(Wakeups& wakeups) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<int> queues[PAIRS];
+    std::vector<std::thread> threads;
+    for (int pair = 0; pair < PAIRS; pair++) {
+        threads.emplace_back([&, pair] {
+            for (int i = 0; i < WAKEUP_ITEMS; i++) {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (queues[pair].empty()) {
+                    cv.wait(lock);
+                    wakeups.Count(queues[pair].empty());
+                }
+                queues[pair].pop_front();
+                cv.notify_all();
+            }
+        });
+        threads.emplace_back([&, pair] {
+            for (int i = 0; i < WAKEUP_ITEMS; i++) {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (queues[pair].size() >= 8) {
+                    cv.wait(lock);
+                    wakeups.Count(queues[pair].size() >= 8);
+                }
+                queues[pair].push_back(i);
+                cv.notify_all();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+// The ring with one wakeup per direction and queue, as the event group bits of AudioService
+struct WakeupQueue {
+    SpscRing<int, 8> ring;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+static void CountQueueWakeups(Wakeups& wakeups) {
+    WakeupQueue queues[PAIRS];
+    std::vector<std::thread> threads;
+    for (int pair = 0; pair < PAIRS; pair++) {
+        auto& queue = queues[pair];
+        threads.emplace_back([&] {
+            int item;
+            for (int i = 0; i < WAKEUP_ITEMS; i++) {
+                while (!queue.ring.Pop(item)) {
+                    std::unique_lock<std::mutex> lock(queue.mutex);
+                    while (queue.ring.empty()) {
+                        queue.not_empty.wait(lock);
+                        wakeups.Count(queue.ring.empty());
+                    }
+                }
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.not_full.notify_one();
+            }
+        });
+        threads.emplace_back([&] {
+            for (int i = 0; i < WAKEUP_ITEMS; i++) {
+                int item = i;
+                while (!queue.ring.Push(std::move(item))) {
+                    std::unique_lock<std::mutex> lock(queue.mutex);
+                    while (queue.ring.full()) {
+                        queue.not_full.wait(lock);
+                        wakeups.Count(queue.ring.full());
+                    }
+                }
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.not_empty.notify_one();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+int main() {
+    TestOrder();
+    TestClear();
+
+    Wakeups shared, per_queue;
+    CountSharedWakeups(shared);
+    CountQueueWakeups(per_queue);
+    double items = PAIRS * WAKEUP_ITEMS;
+    printf("wakeups per item, %d queue pairs:\n", PAIRS);
+    printf("  shared mutex + notify_all: %.2f, %.2f of them with nothing to do\n", shared.total / items, shared.wasted / items);
+    printf("  ring + per queue wakeup:   %.2f, %.2f of them with nothing to do\n", per_queue.total / items, per_queue.wasted / items);
+
+    printf("spsc_ring_test passed\n");
+    return 0;
+}
@@ -0,0 +1,6 @@
+#ifndef HOST_STUB_BOARD_H
+#define HOST_STUB_BOARD_H
+
+// audio_codec.h includes the board header without using it, the host has no board
+
+#endif // HOST_STUB_BOARD_H
@@ -0,0 +1,8 @@
+#ifndef HOST_STUB_CJSON_H
+#define HOST_STUB_CJSON_H
+
+// Only declared, for headers that pass cJSON pointers around. Code that builds or parses JSON
+// is not compiled on the host.
+typedef struct cJSON cJSON;
+
+#endif // HOST_STUB_CJSON_H
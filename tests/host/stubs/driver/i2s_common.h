@@ -0,0 +1,17 @@
+#ifndef HOST_STUB_DRIVER_I2S_COMMON_H
+#define HOST_STUB_DRIVER_I2S_COMMON_H
+
+#include "esp_err.h"
+
+// Codecs on the host have no I2S channels, the handles stay nullptr
+typedef struct i2s_channel_obj_t* i2s_chan_handle_t;
+
+inline esp_err_t i2s_channel_enable(i2s_chan_handle_t handle) {
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_channel_disable(i2s_chan_handle_t handle) {
+    return ESP_OK;
+}
+
+#endif // HOST_STUB_DRIVER_I2S_COMMON_H
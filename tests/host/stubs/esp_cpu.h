@@ -0,0 +1,13 @@
+#ifndef HOST_STUB_ESP_CPU_H
+#define HOST_STUB_ESP_CPU_H
+
+#include <chrono>
+#include <cstdint>
+
+// Nanoseconds stand in for CPU cycles, so "cycles" counters read as ns on the host
+inline uint32_t esp_cpu_get_cycle_count() {
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // HOST_STUB_ESP_CPU_H
@@ -0,0 +1,12 @@
+#ifndef HOST_STUB_ESP_ERR_H
+#define HOST_STUB_ESP_ERR_H
+
+#include <cstdio>
+#include <cstdlib>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERROR_CHECK(x) do { if ((x) != ESP_OK) { fprintf(stderr, "%s failed\n", #x); abort(); } } while (0)
+
+#endif // HOST_STUB_ESP_ERR_H
@@ -0,0 +1,29 @@
+#ifndef HOST_STUB_ESP_HEAP_CAPS_H
+#define HOST_STUB_ESP_HEAP_CAPS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+// All capabilities map to the host heap, whose free size is not known
+inline void* heap_caps_malloc(size_t size, uint32_t caps) {
+    return malloc(size);
+}
+
+inline void heap_caps_free(void* pointer) {
+    free(pointer);
+}
+
+inline size_t heap_caps_get_free_size(uint32_t caps) {
+    return 0;
+}
+
+inline size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+    return 0;
+}
+
+#endif // HOST_STUB_ESP_HEAP_CAPS_H
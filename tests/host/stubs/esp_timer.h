@@ -0,0 +1,80 @@
+#ifndef HOST_STUB_ESP_TIMER_H
+#define HOST_STUB_ESP_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+
+#include "esp_err.h"
+
+inline int64_t esp_timer_get_time() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/*
+ * Timers never fire on their own, a test calls host_esp_timer_fire() once the armed expiry has
+ * passed, standing in for the esp_timer task.
+ */
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void* arg;
+    bool armed;
+    int64_t expiry_us;
+};
+typedef struct esp_timer* esp_timer_handle_t;
+
+// The timer created last, for tests of classes that keep their handle private
+inline esp_timer_handle_t host_last_esp_timer = nullptr;
+
+inline esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    *out_handle = new esp_timer{args->callback, args->arg, false, 0};
+    host_last_esp_timer = *out_handle;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    timer->armed = true;
+    timer->expiry_us = esp_timer_get_time() + (int64_t)timeout_us;
+    return ESP_OK;
+}
+
+// Periodic timers are armed like one-shot ones, a test fires them as often as it wants
+inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return esp_timer_start_once(timer, period_us);
+}
+
+inline esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    timer->armed = false;
+    return ESP_OK;
+}
+
+inline esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    delete timer;
+    return ESP_OK;
+}
+
+// Runs the callback if the timer is armed and its expiry has passed, returns whether it ran
+inline bool host_esp_timer_fire(esp_timer_handle_t timer) {
+    if (!timer->armed || esp_timer_get_time() < timer->expiry_us) {
+        return false;
+    }
+    timer->armed = false;
+    timer->callback(timer->arg);
+    return true;
+}
+
+#endif // HOST_STUB_ESP_TIMER_H
@@ -0,0 +1,21 @@
+#ifndef HOST_STUB_FREERTOS_H
+#define HOST_STUB_FREERTOS_H
+
+#include <cstdint>
+
+// One tick per millisecond, as CONFIG_FREERTOS_HZ=1000
+typedef uint32_t TickType_t;
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY ((TickType_t)0xffffffff)
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portNUM_PROCESSORS 2
+#define tskNO_AFFINITY 0x7fffffff
+
+#endif // HOST_STUB_FREERTOS_H
@@ -0,0 +1,101 @@
+#ifndef HOST_STUB_FREERTOS_EVENT_GROUPS_H
+#define HOST_STUB_FREERTOS_EVENT_GROUPS_H
+
+#include "freertos/FreeRTOS.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+
+/*
+ * Event groups with the FreeRTOS semantics the firmware relies on: setting bits releases every
+ * waiter whose condition they meet, and bits to clear on exit are cleared once all of them have
+ * been released, so two tasks waiting on the same bit both wake up.
+ */
+typedef uint32_t EventBits_t;
+
+struct HostEventGroup {
+    struct Waiter {
+        EventBits_t bits;
+        bool wait_for_all;
+        bool clear_on_exit;
+        bool released = false;
+        EventBits_t result = 0;
+    };
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+    std::list<Waiter*> waiters;
+
+    bool Met(const Waiter& waiter) const {
+        return waiter.wait_for_all ? (bits & waiter.bits) == waiter.bits : (bits & waiter.bits) != 0;
+    }
+};
+typedef HostEventGroup* EventGroupHandle_t;
+
+inline EventGroupHandle_t xEventGroupCreate() {
+    return new HostEventGroup();
+}
+
+inline void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+inline EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+inline EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+inline EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    EventBits_t clear = 0;
+    for (auto waiter : group->waiters) {
+        if (!waiter->released && group->Met(*waiter)) {
+            waiter->released = true;
+            waiter->result = group->bits;
+            if (waiter->clear_on_exit) {
+                clear |= waiter->bits;
+            }
+        }
+    }
+    group->bits &= ~clear;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+inline EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all, TickType_t timeout) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    HostEventGroup::Waiter waiter{bits, wait_for_all != pdFALSE, clear_on_exit != pdFALSE};
+    if (group->Met(waiter)) {
+        EventBits_t result = group->bits;
+        if (waiter.clear_on_exit) {
+            group->bits &= ~bits;
+        }
+        return result;
+    }
+    if (timeout == 0) {
+        return group->bits;
+    }
+    group->waiters.push_back(&waiter);
+    auto released = [&waiter]() { return waiter.released; };
+    if (timeout == portMAX_DELAY) {
+        group->cv.wait(lock, released);
+    } else {
+        group->cv.wait_for(lock, std::chrono::milliseconds(timeout), released);
+    }
+    group->waiters.remove(&waiter);
+    return waiter.released ? waiter.result : group->bits;
+}
+
+#endif // HOST_STUB_FREERTOS_EVENT_GROUPS_H
@@ -0,0 +1,56 @@
+#ifndef HOST_STUB_FREERTOS_TASK_H
+#define HOST_STUB_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Tasks are std::threads. Priorities, stack sizes and core affinity are ignored, vTaskDelete(NULL)
+ * at the end of a task function is a no-op and the thread ends when the function returns. Tests
+ * stop their tasks and then call host_join_tasks() before the objects they use go away.
+ */
+typedef void (*TaskFunction_t)(void* arg);
+typedef struct HostTask* TaskHandle_t;
+
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline std::mutex host_tasks_mutex;
+inline std::vector<std::thread> host_tasks;
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_size,
+    void* arg, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    std::lock_guard<std::mutex> lock(host_tasks_mutex);
+    host_tasks.emplace_back(function, arg);
+    if (handle != nullptr) {
+        // Only compared, never dereferenced
+        *handle = reinterpret_cast<TaskHandle_t>(host_tasks.size());
+    }
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_size,
+    void* arg, UBaseType_t priority, TaskHandle_t* handle) {
+    return xTaskCreatePinnedToCore(function, name, stack_size, arg, priority, handle, tskNO_AFFINITY);
+}
+
+inline void vTaskDelete(TaskHandle_t task) {
+}
+
+inline void host_join_tasks() {
+    std::vector<std::thread> tasks;
+    {
+        std::lock_guard<std::mutex> lock(host_tasks_mutex);
+        tasks.swap(host_tasks);
+    }
+    for (auto& task : tasks) {
+        task.join();
+    }
+}
+
+#endif // HOST_STUB_FREERTOS_TASK_H
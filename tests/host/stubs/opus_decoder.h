@@ -0,0 +1,59 @@
+#ifndef HOST_STUB_OPUS_DECODER_H
+#define HOST_STUB_OPUS_DECODER_H
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <opus.h>
+
+// The esp-opus-encoder component's decoder wrapper, on the host libopus
+class OpusDecoderWrapper {
+public:
+    OpusDecoderWrapper(int sample_rate, int channels, int duration_ms = 60)
+        : sample_rate_(sample_rate), duration_ms_(duration_ms) {
+        int error;
+        audio_dec_ = opus_decoder_create(sample_rate, channels, &error);
+        frame_size_ = sample_rate / 1000 * channels * duration_ms;
+    }
+
+    ~OpusDecoderWrapper() {
+        if (audio_dec_ != nullptr) {
+            opus_decoder_destroy(audio_dec_);
+        }
+    }
+
+    // An empty |opus| runs the packet loss concealment for one frame
+    bool Decode(std::vector<uint8_t>&& opus, std::vector<int16_t>& pcm) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (audio_dec_ == nullptr) {
+            return false;
+        }
+        pcm.resize(frame_size_);
+        int ret = opus_decode(audio_dec_, opus.empty() ? nullptr : opus.data(), opus.size(), pcm.data(), pcm.size(), 0);
+        if (ret < 0) {
+            return false;
+        }
+        pcm.resize(ret);
+        return true;
+    }
+
+    void ResetState() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (audio_dec_ != nullptr) {
+            opus_decoder_ctl(audio_dec_, OPUS_RESET_STATE);
+        }
+    }
+
+    int sample_rate() const { return sample_rate_; }
+    int duration_ms() const { return duration_ms_; }
+
+private:
+    std::mutex mutex_;
+    OpusDecoder* audio_dec_ = nullptr;
+    int frame_size_;
+    int sample_rate_;
+    int duration_ms_;
+};
+
+#endif // HOST_STUB_OPUS_DECODER_H
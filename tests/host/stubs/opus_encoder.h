@@ -0,0 +1,6 @@
+#ifndef HOST_STUB_OPUS_ENCODER_H
+#define HOST_STUB_OPUS_ENCODER_H
+
+// The firmware encodes with UplinkEncoder on libopus directly, the component's wrapper is only included
+
+#endif // HOST_STUB_OPUS_ENCODER_H
@@ -0,0 +1,41 @@
+#ifndef HOST_STUB_OPUS_RESAMPLER_H
+#define HOST_STUB_OPUS_RESAMPLER_H
+
+#include <cstdint>
+
+/*
+ * The component resamples with the SILK resampler, which libopus does not export. The host uses
+ * linear interpolation with the same interface, so timings of this stage are not the device's.
+ */
+class OpusResampler {
+public:
+    void Configure(int input_sample_rate, int output_sample_rate) {
+        input_sample_rate_ = input_sample_rate;
+        output_sample_rate_ = output_sample_rate;
+    }
+
+    void Process(const int16_t* input, int input_samples, int16_t* output) {
+        int output_samples = GetOutputSamples(input_samples);
+        for (int i = 0; i < output_samples; i++) {
+            int64_t position = (int64_t)i * input_sample_rate_ * 65536 / output_sample_rate_;
+            int index = (int)(position >> 16);
+            int fraction = (int)(position & 0xffff);
+            int32_t current = input[index];
+            int32_t next = index + 1 < input_samples ? input[index + 1] : current;
+            output[i] = (int16_t)(current + (((next - current) * fraction) >> 16));
+        }
+    }
+
+    int GetOutputSamples(int input_samples) const {
+        return (int64_t)input_samples * output_sample_rate_ / input_sample_rate_;
+    }
+
+    int input_sample_rate() const { return input_sample_rate_; }
+    int output_sample_rate() const { return output_sample_rate_; }
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+};
+
+#endif // HOST_STUB_OPUS_RESAMPLER_H
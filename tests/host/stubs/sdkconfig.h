@@ -0,0 +1,6 @@
+#ifndef HOST_STUB_SDKCONFIG_H
+#define HOST_STUB_SDKCONFIG_H
+
+// No CONFIG_IDF_TARGET_* is set on the host, so target specific code paths take their fallback
+
+#endif // HOST_STUB_SDKCONFIG_H
@@ -0,0 +1,22 @@
+#ifndef HOST_STUB_SETTINGS_H
+#define HOST_STUB_SETTINGS_H
+
+#include <cstdint>
+#include <string>
+
+// Nothing is persisted on the host, every read returns its default
+class Settings {
+public:
+    Settings(const std::string& ns, bool read_write = false) {}
+
+    std::string GetString(const std::string& key, const std::string& default_value = "") { return default_value; }
+    void SetString(const std::string& key, const std::string& value) {}
+    int32_t GetInt(const std::string& key, int32_t default_value = 0) { return default_value; }
+    void SetInt(const std::string& key, int32_t value) {}
+    bool GetBool(const std::string& key, bool default_value = false) { return default_value; }
+    void SetBool(const std::string& key, bool value) {}
+    void EraseKey(const std::string& key) {}
+    void EraseAll() {}
+};
+
+#endif // HOST_STUB_SETTINGS_H
@@ -0,0 +1,81 @@
+#include "host_test.h"
+#include "timer_service.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/*
+ * TimerService with the esp_timer stub fired by hand and a vector standing in for the main loop's
+ * queue: due callbacks run in deadline order, and Cancel() stops a callback until it actually
+ * runs, including after it was dispatched to the queue.
+ */
+
+static std::vector<SmallFunction> g_main_loop;
+
+static void RunMainLoop() {
+    auto tasks = std::move(g_main_loop);
+    g_main_loop.clear();
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+static void Wait(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static void TestOrder() {
+    TimerService timers([](SmallFunction&& callback) { g_main_loop.push_back(std::move(callback)); });
+    auto timer = host_last_esp_timer;
+    std::vector<int> ran;
+    CHECK(timers.Add(20, [&ran]() { ran.push_back(2); }) != 0);
+    CHECK(timers.Add(5, [&ran]() { ran.push_back(1); }) != 0);
+    CHECK(!host_esp_timer_fire(timer));
+
+    Wait(10);
+    CHECK(host_esp_timer_fire(timer));
+    RunMainLoop();
+    CHECK((ran == std::vector<int>{1}));
+
+    // Re-armed for the later one
+    Wait(15);
+    CHECK(host_esp_timer_fire(timer));
+    RunMainLoop();
+    CHECK((ran == std::vector<int>{1, 2}));
+    CHECK(!host_esp_timer_fire(timer));
+}
+
+static void TestCancel() {
+    TimerService timers([](SmallFunction&& callback) { g_main_loop.push_back(std::move(callback)); });
+    auto timer = host_last_esp_timer;
+    int ran = 0;
+
+    auto pending = timers.Add(5, [&ran]() { ran++; });
+    CHECK(timers.Cancel(pending));
+    CHECK(!timers.Cancel(pending));
+    CHECK(!timers.Cancel(0));
+
+    // Dispatched to the main loop but not run yet
+    auto queued = timers.Add(5, [&ran]() { ran++; });
+    Wait(10);
+    host_esp_timer_fire(timer);
+    CHECK(g_main_loop.size() == 1);
+    CHECK(timers.Cancel(queued));
+    RunMainLoop();
+    CHECK(ran == 0);
+
+    // Already ran
+    auto done = timers.Add(5, [&ran]() { ran++; });
+    Wait(10);
+    host_esp_timer_fire(timer);
+    RunMainLoop();
+    CHECK(ran == 1);
+    CHECK(!timers.Cancel(done));
+}
+
+int main() {
+    TestOrder();
+    TestCancel();
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "host_benchmark.h"
+#include "udp_audio_cipher.h"
+
+#include <arpa/inet.h>
+#include <cstdio>
+#include <cstring>
+
+/*
+ * Encrypts and decrypts opus sized packets through UdpAudioCipher, the way MqttProtocol does, and
+ * through the previous string based framing, which built a nonce string, a datagram string and a
+ * payload vector per packet. Prints the time and heap allocations per packet for each.
+ */
+
+#define PACKETS 200000
+#define PAYLOAD_SIZE 120
+
+int main() {
+    std::string key(16, '\x5a');
+    std::string nonce(UDP_AUDIO_HEADER_SIZE, '\0');
+    nonce[0] = 0x01;
+
+    std::vector<uint8_t> payload(PAYLOAD_SIZE);
+    for (int i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    /* Preallocated datagram path, the buffers grow on the first packet */
+    UdpAudioCipher cipher;
+    if (!cipher.SetKey(key, nonce)) {
+        fprintf(stderr, "SetKey failed\n");
+        return 1;
+    }
+    std::string datagram;
+    std::vector<uint8_t> decrypted;
+    cipher.Encrypt(payload.data(), payload.size(), 0, 0, datagram);
+    cipher.Decrypt((const uint8_t*)datagram.data(), datagram.size(), decrypted);
+
+    BenchmarkScope current;
+    for (int i = 0; i < PACKETS; i++) {
+        cipher.Encrypt(payload.data(), payload.size(), i * 60, i + 1, datagram);
+        cipher.Decrypt((const uint8_t*)datagram.data(), datagram.size(), decrypted);
+    }
+    current.Stop();
+    if (decrypted != payload) {
+        fprintf(stderr, "Decrypted payload does not match\n");
+        return 1;
+    }
+
+    /* Previous framing */
+    mbedtls_aes_context aes_ctx;
+    mbedtls_aes_init(&aes_ctx);
+    mbedtls_aes_setkey_enc(&aes_ctx, (const unsigned char*)key.c_str(), 128);
+    std::vector<uint8_t> plain;
+    BenchmarkScope legacy;
+    for (int i = 0; i < PACKETS; i++) {
+        std::string counter(nonce);
+        *(uint16_t*)&counter[2] = htons(payload.size());
+        *(uint32_t*)&counter[8] = htonl(i * 60);
+        *(uint32_t*)&counter[12] = htonl(i + 1);
+        std::string encrypted;
+        encrypted.resize(nonce.size() + payload.size());
+        memcpy(encrypted.data(), counter.data(), counter.size());
+        size_t nc_off = 0;
+        uint8_t stream_block[16] = {0};
+        mbedtls_aes_crypt_ctr(&aes_ctx, payload.size(), &nc_off, (uint8_t*)counter.data(), stream_block,
+            payload.data(), (uint8_t*)&encrypted[nonce.size()]);
+
+        plain = std::vector<uint8_t>(encrypted.size() - nonce.size());
+        memcpy(counter.data(), encrypted.data(), nonce.size());
+        nc_off = 0;
+        mbedtls_aes_crypt_ctr(&aes_ctx, plain.size(), &nc_off, (uint8_t*)counter.data(), stream_block,
+            (uint8_t*)&encrypted[nonce.size()], plain.data());
+    }
+    legacy.Stop();
+    mbedtls_aes_free(&aes_ctx);
+    if (plain != payload) {
+        fprintf(stderr, "String framing round trip does not match\n");
+        return 1;
+    }
+
+    printf("%d packets of %d bytes, encrypted and decrypted\n", PACKETS, PAYLOAD_SIZE);
+    printf("  string framing: %5.0f ns/packet, %.1f allocations/packet, %4.0f bytes/packet\n",
+        (double)legacy.elapsed_ns / PACKETS, (double)legacy.allocations / PACKETS, (double)legacy.bytes / PACKETS);
+    printf("  cipher:         %5.0f ns/packet, %.1f allocations/packet, %4.0f bytes/packet\n",
+        (double)current.elapsed_ns / PACKETS, (double)current.allocations / PACKETS, (double)current.bytes / PACKETS);
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "host_benchmark.h"
+#include "voice_commands.h"
+
+#include <cctype>
+#include <string>
+
+/*
+ * Matches a corpus of recorded transcripts against the built-in voice command table, once with
+ * the previous lowercase + std::string::find scan over every accented and unaccented phrase and
+ * once with a KeywordMatcher built from kVoiceCommandTable, as VoiceCommands::LoadDefaults() does.
+ * Prints the time per transcript and the transcripts on which the two disagree.
+ */
+
+#define ROUNDS 20000
+
+// Transcripts recorded from the STT server, commands and ordinary conversation mixed
+static const char* const kTranscripts[] = {
+    "Đi tới",
+    "Otto ơi đi tới đi",
+    "lùi lại một chút",
+    "Quẹo trái",
+    "re phai",
+    "Ngồi xuống nào",
+    "Nhảy cho mình xem với",
+    "Cúi chào mọi người đi",
+    "Xin chào, bạn tên là gì?",
+    "Bạn có khỏe không?",
+    "Hôm nay thời tiết thế nào?",
+    "Kể cho tôi nghe một câu chuyện ngắn về con mèo",
+    "Bạn biết bài hát nào về mùa xuân không?",
+    "Mở mã QR",
+    "Mở bảng điều khiển",
+    "Chúc mừng sinh nhật bạn",
+    "happy birthday Otto",
+    "Súng nè!",
+    "Bang bang",
+    "Tập thể dục thôi",
+    "Đi vệ sinh",
+    "Chuyển sang emoji mặc định",
+    "Mẹ mua cho mình cái bánh",
+    "Bánh này ngon quá",
+    "banh mi ngon qua",
+    "Một chín hai chấm một sáu tám",
+    "Tôi muốn nghe nhạc thiếu nhi",
+    "What is the weather like today?",
+    "Dạy mình đếm từ một đến mười bằng tiếng Anh nhé",
+};
+
+// The phrases the STT handler searched for before VoiceCommands, both forms spelled out
+static const struct {
+    VoiceCommand command;
+    const char* phrases[8];
+} kLegacyPhrases[] = {
+    { kVoiceCommandShoot, { "súng nè", "sung ne", "bắn", "ban", "bang bang", "bùm", "bum" } },
+    { kVoiceCommandShowQr, { "mở qr", "mo qr", "mở mã qr", "mo ma qr", "hiển thị qr", "hien thi qr", "mở mạng qr", "mo mang qr" } },
+    { kVoiceCommandPushup, { "chống đẩy", "chong day", "tập thể dục", "tap the duc", "hít đất", "hit dat" } },
+    { kVoiceCommandToilet, { "đi vệ sinh", "di ve sinh", "đi toilet", "di toilet" } },
+    { kVoiceCommandBirthday, { "chúc mừng sinh nhật", "chuc mung sinh nhat", "happy birthday", "sinh nhật vui vẻ", "sinh nhat vui ve" } },
+    { kVoiceCommandCongratulate, { "sinh nhật", "sinh nhat", "chúc mừng", "chuc mung" } },
+    { kVoiceCommandWalkForward, { "đi tới", "di toi", "tiến lên", "tien len" } },
+    { kVoiceCommandWalkBack, { "lùi lại", "lui lai", "đi lùi", "di lui" } },
+    { kVoiceCommandTurnLeft, { "quẹo trái", "queo trai", "rẽ trái", "re trai" } },
+    { kVoiceCommandTurnRight, { "quẹo phải", "queo phai", "rẽ phải", "re phai" } },
+    { kVoiceCommandSitDown, { "ngồi xuống", "ngoi xuong", "ngồi", "ngoi" } },
+    { kVoiceCommandDance, { "nhảy", "nhay", "múa", "mua" } },
+    { kVoiceCommandBow, { "cúi chào", "cui chao", "chào", "chao" } },
+    { kVoiceCommandShowIp, { "192168", "một chín hai", "mot chin hai", "ip address" } },
+    { kVoiceCommandOpenPanel, { "bảng điều khiển", "bang dieu khien", "mở trang điều khiển", "mo trang dieu khien", "mở web", "mo web" } },
+    { kVoiceCommandEmojiOtto, { "emoji chính", "emoji chinh" } },
+    { kVoiceCommandEmojiDefault, { "emoji mặc định", "emoji mac dinh" } },
+};
+
+static uint32_t LegacyMatch(const std::string& text) {
+    std::string lower = text;
+    for (auto& ch : lower) {
+        ch = (char)tolower((unsigned char)ch);
+    }
+    uint32_t result = 0;
+    for (auto& entry : kLegacyPhrases) {
+        for (auto phrase : entry.phrases) {
+            if (phrase != nullptr && lower.find(phrase) != std::string::npos) {
+                result |= 1u << entry.command;
+            }
+        }
+    }
+    return result;
+}
+
+static std::string CommandNames(uint32_t mask) {
+    std::string names;
+    for (int command = 0; command < kVoiceCommandCount; command++) {
+        if (mask & (1u << command)) {
+            names += names.empty() ? "" : ",";
+            names += kVoiceCommandTable[command].name;
+        }
+    }
+    return names.empty() ? "-" : names;
+}
+
+int main() {
+    const int count = sizeof(kTranscripts) / sizeof(kTranscripts[0]);
+    // The legacy handler copied the transcript into a std::string first
+    std::string transcripts[count];
+    for (int i = 0; i < count; i++) {
+        transcripts[i] = kTranscripts[i];
+    }
+
+    uint32_t legacy_results[count];
+    BenchmarkScope legacy;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < count; i++) {
+            legacy_results[i] = LegacyMatch(transcripts[i]);
+        }
+    }
+    legacy.Stop();
+
+    BenchmarkScope build;
+    KeywordMatcher matcher;
+    for (int command = 0; command < kVoiceCommandCount; command++) {
+        for (auto phrase : kVoiceCommandTable[command].phrases) {
+            if (phrase != nullptr) {
+                matcher.Add(phrase, command);
+            }
+        }
+    }
+    matcher.Build();
+    build.Stop();
+
+    uint32_t results[count];
+    BenchmarkScope current;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < count; i++) {
+            results[i] = matcher.Match(transcripts[i]);
+        }
+    }
+    current.Stop();
+
+    int matched = ROUNDS * count;
+    printf("%d transcripts\n", matched);
+    printf("  legacy scan: %6.0f ns/transcript, %.1f allocations/transcript\n",
+        (double)legacy.elapsed_ns / matched, (double)legacy.allocations / matched);
+    printf("  matcher:     %6.0f ns/transcript, %.1f allocations/transcript\n",
+        (double)current.elapsed_ns / matched, (double)current.allocations / matched);
+    printf("  matcher built in %lld us, %zu phrases, %zu states\n",
+        (long long)build.elapsed_ns / 1000, matcher.phrase_count(), matcher.state_count());
+
+    printf("differences:\n");
+    for (int i = 0; i < count; i++) {
+        if (legacy_results[i] != results[i]) {
+            printf("  %-50s legacy %-24s matcher %s\n", kTranscripts[i],
+                CommandNames(legacy_results[i]).c_str(), CommandNames(results[i]).c_str());
+        }
+    }
+    return 0;
+}